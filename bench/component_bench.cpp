@@ -0,0 +1,548 @@
+// Microbenchmarks of the siren DSP classes and of the whole AudioCallback.
+//
+// Every case processes BENCH_SAMPLES samples, in chunks of its block size
+// (block size 1 is the per-sample API), and keeps the best of BENCH_RUNS
+// runs. Results are printed as one JSON document so that runs can be
+// stored and compared over time.
+//
+// Host: make -C host component_bench, timed with std::chrono::steady_clock.
+// Seed: make -C bench, timed with the DWT cycle counter and printed over
+//       the USB serial port.
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef DUB_HOST
+#include <chrono>
+
+#include "sim_handlers.h"
+#else
+#include "engine.h"
+#endif
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_SAMPLES 48000 // One second of audio per run
+#define BENCH_RUNS 3
+
+static const int block_sizes[] = {1, 4, 48, 256};
+
+
+// Clock
+#ifdef DUB_HOST
+static const char* bench_platform = "host";
+static const char* bench_clock    = "steady_clock";
+
+static uint64_t ClockNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Host ticks are nanoseconds, no cycle count
+static double TicksToNs(uint64_t ticks)
+{
+    return (double)ticks;
+}
+
+static void Emit(const char* line)
+{
+    puts(line);
+}
+#else
+static const char* bench_platform = "seed";
+static const char* bench_clock    = "dwt_cyccnt";
+
+static void ClockInit()
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// 32 bit cycle count, runs stay well below its 8.9 s wrap at 480 MHz
+static uint64_t ClockNow()
+{
+    return DWT->CYCCNT;
+}
+
+static double TicksToNs(uint64_t ticks)
+{
+    return (double)(uint32_t)ticks * 1e9 / System::GetSysClkFreq();
+}
+
+static void Emit(const char* line)
+{
+    hw.PrintLine("%s", line);
+}
+#endif
+// Clock
+
+
+// Runner
+// Each result is held until the next one so that only the last line of the
+// array goes out without a trailing comma
+static char pending[320];
+
+static void FlushPending(bool last)
+{
+    if(pending[0] != '\0')
+    {
+        char line[330];
+        snprintf(line, sizeof(line), "    %s%s", pending, last ? "" : ",");
+        Emit(line);
+        pending[0] = '\0';
+    }
+}
+
+// body(n) processes the next n samples of the case
+template <typename Body>
+static void Run(const char* component,
+                const char* variant,
+                int         block_size,
+                Body        body)
+{
+    double best = 1e300;
+    for(int run = 0; run < BENCH_RUNS; run++)
+    {
+        uint64_t start = ClockNow();
+        for(int pos = 0; pos < BENCH_SAMPLES; pos += block_size)
+        {
+            body(block_size);
+        }
+        uint64_t ticks = ClockNow() - start;
+        best           = best < (double)ticks ? best : (double)ticks;
+    }
+
+    double ns_per_sample = TicksToNs((uint64_t)best) / BENCH_SAMPLES;
+    double rate          = 1e9 / ns_per_sample;
+
+    FlushPending(false);
+    int len = snprintf(pending,
+                       sizeof(pending),
+                       "{\"component\": \"%s\", \"variant\": \"%s\", "
+                       "\"block_size\": %d, \"ns_per_sample\": %.3f, ",
+                       component,
+                       variant,
+                       block_size,
+                       ns_per_sample);
+#ifndef DUB_HOST
+    len += snprintf(pending + len,
+                    sizeof(pending) - len,
+                    "\"cycles_per_sample\": %.1f, ",
+                    best / BENCH_SAMPLES);
+#endif
+    snprintf(pending + len,
+             sizeof(pending) - len,
+             "\"samples_per_sec\": %.0f, \"realtime_multiple\": %.2f}",
+             rate,
+             rate / BENCH_SAMPLE_RATE);
+}
+// Runner
+
+
+// Inputs
+static float signal[MAX_BLOCK_SIZE];      // Voice for the VCF and out amp
+static float envelope_in[MAX_BLOCK_SIZE]; // Decaying envelope
+static float lfo_in[MAX_BLOCK_SIZE];      // LFO from 0.0f to 1.0f
+static float cutoff_in[MAX_BLOCK_SIZE];   // Swept cutoff exponent
+static float work[MAX_BLOCK_SIZE];
+static float out_left[MAX_BLOCK_SIZE], out_right[MAX_BLOCK_SIZE];
+
+static void InitInputs()
+{
+    for(int i = 0; i < MAX_BLOCK_SIZE; i++)
+    {
+        float t        = (float)i / MAX_BLOCK_SIZE;
+        signal[i]      = (i % 64) < 32 ? 0.7f : -0.7f;
+        envelope_in[i] = 1.0f - t;
+        lfo_in[i]      = 0.5f + 0.5f * sinf(TWOPI_F * t);
+        cutoff_in[i]   = t;
+    }
+}
+
+static void Reset(int block_size)
+{
+    engine.Init(BENCH_SAMPLE_RATE, block_size, 1);
+}
+// Inputs
+
+
+// Components
+static void BenchEnvelope()
+{
+    DecayEnvelope& envelope = engine.envelope;
+    for(int bs : block_sizes)
+    {
+        Reset(bs);
+        envelope.ReleaseValue = 0.5f;
+        envelope.UpdateControls();
+        int pos = 0;
+        Run("DecayEnvelope", "gate 0.5 s on, 0.5 s off", bs, [&](int n) {
+            bool gate = (pos / (BENCH_SAMPLE_RATE / 2)) % 2 == 0;
+            pos += n;
+            if(n == 1)
+                envelope.Process(gate);
+            else
+                envelope.ProcessBlock(work, n, gate);
+        });
+    }
+}
+
+static void BenchSweep()
+{
+    static const struct
+    {
+        const char* name;
+        float       value;
+    } variants[] = {
+        {"sweep down", 0.9f}, {"sweep up", 0.1f}, {"dead zone", 0.5f}};
+    Sweep& sweep = engine.sweep;
+    Vcf&   vcf   = engine.vcf;
+
+    for(const auto& v : variants)
+    {
+        for(int bs : block_sizes)
+        {
+            Reset(bs);
+            float value = v.value;
+            Run("Sweep", v.name, bs, [&](int n) {
+                if(n == 1)
+                    sweep.UpdateCutoffExp(value, &vcf, envelope_in[0]);
+                else
+                    sweep.UpdateCutoffExpBlock(
+                        work, envelope_in, n, value, &vcf);
+            });
+        }
+    }
+}
+
+static void BenchLfo()
+{
+    Lfo&      lfo      = engine.lfo;
+    Triggers& triggers = engine.triggers;
+    for(int crossfade = 0; crossfade < 2; crossfade++)
+    {
+        for(int bs : block_sizes)
+        {
+            Reset(bs);
+            lfo.DepthValue              = 1.0f;
+            lfo.RateValue               = 0.8f;
+            triggers.IsBankSelectActive = crossfade;
+            triggers.LastIndex          = 0;
+            lfo.UpdateControls();
+
+            // A new trigger every 50 ms keeps the 100 ms crossfade running
+            int pos = 0;
+            Run("Lfo",
+                crossfade ? "bank B, crossfading" : "bank A, steady",
+                bs,
+                [&](int n) {
+                    if(crossfade)
+                    {
+                        triggers.LastIndex
+                            = (pos / (BENCH_SAMPLE_RATE / 20)) % NUM_TRIGGERS;
+                    }
+                    pos += n;
+                    if(n == 1)
+                        lfo.ProcessAll(triggers);
+                    else
+                        lfo.ProcessBlock(work, n, triggers);
+                });
+        }
+    }
+}
+
+static void BenchVco()
+{
+    Vco& vco = engine.vco;
+    for(int fm = 0; fm < 2; fm++)
+    {
+        for(int bs : block_sizes)
+        {
+            Reset(bs);
+            vco.TuneValue = 0.7f;
+            vco.UpdateControls();
+            float depth   = fm ? 1.0f : 0.0f;
+            float carrier = VcoExpToFreq(0.7f);
+            Run("Vco",
+                fm ? "FM depth 1, folding" : "FM depth 0",
+                bs,
+                [&](int n) {
+                    if(n == 1)
+                    {
+                        float lfo_bipolar = (lfo_in[0] - 0.5f) * 2.0f;
+                        vco.SetFreq(
+                            vco.CalculateFMFreq(carrier, lfo_bipolar, depth));
+                        vco.Process();
+                    }
+                    else
+                    {
+                        vco.CarrierBlock(work, n);
+                        vco.CalculateFMFreqBlock(work, lfo_in, n, depth);
+                        vco.ProcessBlock(work, n);
+                    }
+                });
+        }
+    }
+}
+
+static void BenchVcf()
+{
+    Vcf& vcf = engine.vcf;
+    for(int swept = 0; swept < 2; swept++)
+    {
+        for(int bs : block_sizes)
+        {
+            Reset(bs);
+            vcf.SetExponent(0.7f); // About 2 kHz
+            int pos = 0;
+            Run("Vcf",
+                swept ? "cutoff swept per sample" : "fixed cutoff",
+                bs,
+                [&](int n) {
+                    if(n == 1)
+                    {
+                        int i = pos++ % MAX_BLOCK_SIZE;
+                        if(swept)
+                            vcf.SetExponent(cutoff_in[i]);
+                        vcf.Process(signal[i]);
+                    }
+                    else
+                    {
+                        memcpy(work, signal, n * sizeof(float));
+                        if(swept)
+                            vcf.ProcessBlock(work, cutoff_in, n);
+                        else
+                            vcf.ProcessBlock(work, n);
+                    }
+                });
+        }
+    }
+}
+
+static void BenchOutAmp()
+{
+    OutAmp& out_amp = engine.out_amp;
+    for(int moving = 0; moving < 2; moving++)
+    {
+        for(int bs : block_sizes)
+        {
+            Reset(bs);
+            out_amp.VolumeValue = 0.8f;
+            int calls           = 0;
+            Run("OutAmp",
+                moving ? "volume moving" : "steady volume",
+                bs,
+                [&](int n) {
+                    if(moving)
+                    {
+                        out_amp.VolumeValue = (calls++ & 1) ? 0.8f : 0.7f;
+                    }
+                    if(n == 1)
+                    {
+                        out_amp.Process(signal[0]);
+                    }
+                    else
+                    {
+                        memcpy(work, signal, n * sizeof(float));
+                        out_amp.ProcessBlock(work, n);
+                    }
+                });
+        }
+    }
+}
+
+static void BenchTapeDelay()
+{
+    TapeDelay& delay = engine.delay;
+    for(int moving = 0; moving < 2; moving++)
+    {
+        for(int bs : block_sizes)
+        {
+            Reset(bs);
+            int pos   = 0;
+            int calls = 0;
+            Run("TapeDelay",
+                moving ? "time modulated" : "steady time",
+                bs,
+                [&](int n) {
+                    if(moving)
+                    {
+                        delay.TimeValue = (calls++ & 1) ? 0.375f : 0.25f;
+                    }
+                    if(n == 1)
+                    {
+                        int i = pos++ % MAX_BLOCK_SIZE;
+                        delay.Process(signal[i], out_left[i], out_right[i]);
+                    }
+                    else
+                    {
+                        delay.ProcessBlock(signal, out_left, out_right, n);
+                    }
+                });
+        }
+    }
+}
+
+static void BenchFdnReverb()
+{
+    FdnReverb& reverb = engine.reverb;
+    for(int moving = 0; moving < 2; moving++)
+    {
+        for(int bs : block_sizes)
+        {
+            Reset(bs);
+            int pos   = 0;
+            int calls = 0;
+            Run("FdnReverb",
+                moving ? "decay moving" : "steady decay",
+                bs,
+                [&](int n) {
+                    if(moving)
+                    {
+                        reverb.DecayValue = (calls++ & 1) ? 2.5f : 2.4f;
+                    }
+                    if(n == 1)
+                    {
+                        int i = pos++ % MAX_BLOCK_SIZE;
+                        reverb.Process(out_left[i], out_right[i]);
+                    }
+                    else
+                    {
+                        memcpy(out_left, signal, n * sizeof(float));
+                        memcpy(out_right, signal, n * sizeof(float));
+                        reverb.ProcessBlock(out_left, out_right, n);
+                    }
+                });
+        }
+    }
+}
+// Components
+
+
+// AudioCallback
+struct Scenario
+{
+    const char* name;
+    float       knobs[NUM_ADC_CHANNELS]; // Indexed by AdcChannel
+    bool        bankB;
+    bool        sweepToTune;
+    int         retrigger; // Samples between trigger changes, 0 = never
+    bool        hold;      // Keep the trigger held, else tap it
+};
+
+static const Scenario scenarios[] = {
+    {"idle", {0.8f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f}, 0, 0, 0, 0},
+    {"trigger held", {0.8f, 0.5f, 0.5f, 0.5f, 0.5f, 0.4f}, 0, 0, 0, 1},
+    {"release sweep", {0.8f, 0.7f, 0.6f, 0.5f, 0.9f, 0.6f}, 0, 0, 24000, 0},
+    {"crossfade + sweep to tune",
+     {0.8f, 0.5f, 1.0f, 0.7f, 0.0f, 0.8f},
+     1,
+     1,
+     2400,
+     1},
+};
+
+static void Publish(const Scenario& sc, int trigger, bool held, bool rising)
+{
+    ControlFrame frame;
+    frame.timestamp = engine.SampleCount();
+    memcpy(frame.knobs, sc.knobs, sizeof(frame.knobs));
+    frame.held        = held ? 1u << trigger : 0;
+    frame.rising      = rising ? 1u << trigger : 0;
+    frame.falling     = !held && !rising ? 1u << trigger : 0;
+    frame.lastIndex   = trigger;
+    frame.bankSelect  = sc.bankB;
+    frame.sweepToTune = sc.sweepToTune;
+    engine.control_queue.Push(frame);
+}
+
+static void BenchAudioCallback()
+{
+    float* out[2] = {out_left, out_right};
+    for(const Scenario& sc : scenarios)
+    {
+        for(int bs : block_sizes)
+        {
+            if(bs == 1)
+            {
+                continue;
+            }
+            Reset(bs);
+            Publish(sc, 0, sc.hold, sc.hold);
+
+            int pos = 0, next = sc.retrigger, trigger = 0;
+            Run("AudioCallback", sc.name, bs, [&](int n) {
+                if(sc.retrigger > 0 && pos >= next)
+                {
+                    // Held: move to the next trigger. Tapped: press now,
+                    // the release goes out with the next block.
+                    trigger = sc.hold ? (trigger + 1) % NUM_TRIGGERS : 0;
+                    Publish(sc, trigger, true, true);
+                    next += sc.retrigger;
+                }
+                else if(!sc.hold && engine.triggers.Pressed())
+                {
+                    Publish(sc, trigger, false, false);
+                }
+                pos += n;
+                AudioCallback(nullptr, out, n);
+            });
+        }
+    }
+}
+// AudioCallback
+
+
+static void RunAll()
+{
+    char line[128];
+    Emit("{");
+    snprintf(line, sizeof(line), "  \"platform\": \"%s\",", bench_platform);
+    Emit(line);
+    snprintf(line, sizeof(line), "  \"clock\": \"%s\",", bench_clock);
+    Emit(line);
+    snprintf(line, sizeof(line), "  \"sample_rate\": %d,", BENCH_SAMPLE_RATE);
+    Emit(line);
+    snprintf(line,
+             sizeof(line),
+             "  \"budget_ns_per_sample\": %.1f,",
+             1e9 / BENCH_SAMPLE_RATE);
+    Emit(line);
+    Emit("  \"results\": [");
+
+    InitInputs();
+    BenchEnvelope();
+    BenchSweep();
+    BenchLfo();
+    BenchVco();
+    BenchVcf();
+    BenchOutAmp();
+    BenchTapeDelay();
+    BenchFdnReverb();
+    BenchAudioCallback();
+
+    FlushPending(true);
+    Emit("  ]");
+    Emit("}");
+}
+
+#ifdef DUB_HOST
+int main()
+{
+    SimFlushDenormals();
+    RunAll();
+    return 0;
+}
+#else
+int main(void)
+{
+    hw.Init();
+    hw.StartLog(true); // Waits for the serial monitor
+    ClockInit();
+    RunAll();
+    while(1) {}
+}
+#endif
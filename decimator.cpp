@@ -0,0 +1,105 @@
+#include <cmath>
+
+#include "decimator.h"
+#include "placement.h"
+
+static const double pi = 3.14159265358979323846;
+
+static double IntPow(double x, int n)
+{
+    double r = 1.0;
+    for(int i = 0; i < n; i++)
+    {
+        r *= x;
+    }
+    return r;
+}
+
+// Theta function sums of the elliptic design, they converge in a few terms
+static double AccNum(double q, int order, int c)
+{
+    double acc = 0.0, term;
+    int    i = 0, sign = 1;
+    do
+    {
+        term = IntPow(q, i * (i + 1)) * sin((i * 2 + 1) * c * pi / order)
+               * sign;
+        acc += term;
+        sign = -sign;
+        i++;
+    } while(fabs(term) > 1e-100);
+    return acc;
+}
+
+static double AccDen(double q, int order, int c)
+{
+    double acc = 0.0, term;
+    int    i = 1, sign = -1;
+    do
+    {
+        term = IntPow(q, i * i) * cos(i * 2 * c * pi / order) * sign;
+        acc += term;
+        sign = -sign;
+        i++;
+    } while(fabs(term) > 1e-100);
+    return acc;
+}
+
+void HalfbandDecimator::Init(int num_coefs, double transition)
+{
+    if(num_coefs > HALFBAND_MAX_COEFS)
+    {
+        num_coefs = HALFBAND_MAX_COEFS;
+    }
+    this->num_coefs = num_coefs;
+
+    // Elliptic modulus and nome from the transition band
+    double k  = tan((1.0 - transition * 2.0) * pi / 4.0);
+    k         = k * k;
+    double kk = pow(1.0 - k * k, 0.25);
+    double e  = 0.5 * (1.0 - kk) / (1.0 + kk);
+    double e4 = e * e * e * e;
+    double q  = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+    int order = num_coefs * 2 + 1;
+    for(int i = 0; i < num_coefs; i++)
+    {
+        int    c   = i + 1;
+        double num = AccNum(q, order, c) * pow(q, 0.25);
+        double den = AccDen(q, order, c) + 0.5;
+        double ww  = num / den;
+        double wws = ww * ww;
+        double x   = sqrt((1.0 - wws * k) * (1.0 - wws / k)) / (1.0 + wws);
+        this->coefs[i] = (float)((1.0 - x) / (1.0 + x));
+    }
+    this->Reset();
+}
+
+void HalfbandDecimator::Reset()
+{
+    for(int i = 0; i < HALFBAND_MAX_COEFS; i++)
+    {
+        this->x[i] = 0.0f;
+        this->y[i] = 0.0f;
+    }
+}
+
+DUB_ITCM void
+HalfbandDecimator::Process(const float* in, float* out, size_t n)
+{
+    for(size_t s = 0; s < n; s++)
+    {
+        // Even coefficients filter the newer sample, odd ones the older,
+        // the offset between the branches is the half-band delay
+        float branch[2] = {in[2 * s + 1], in[2 * s]};
+        for(int i = 0; i < this->num_coefs; i++)
+        {
+            float& v   = branch[i & 1];
+            float  y   = (v - this->y[i]) * this->coefs[i] + this->x[i];
+            this->x[i] = v;
+            this->y[i] = y;
+            v          = y;
+        }
+        out[s] = 0.5f * (branch[0] + branch[1]);
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+// Polyphase IIR half-band decimator.
+//
+// The lowpass is the sum of two allpass branches, each a chain of first
+// order allpass sections running at the output rate, so the filter costs
+// one multiply per coefficient per output sample. Coefficients come from
+// the elliptic half-band design (as in Laurent de Soras' HIIR), computed
+// once at Init for a given number of coefficients and transition band.
+
+#define HALFBAND_MAX_COEFS 12
+
+class HalfbandDecimator
+{
+  public:
+    HalfbandDecimator() { this->num_coefs = 0; }
+
+    // transition is the width of the transition band as a fraction of the
+    // input sample rate, centred on a quarter of it
+    void Init(int num_coefs, double transition);
+    void Reset();
+
+    // Reads 2 * n samples from in and writes n samples to out, which may
+    // point to the same buffer as in
+    void Process(const float* in, float* out, size_t n);
+
+  private:
+    float coefs[HALFBAND_MAX_COEFS];
+    float x[HALFBAND_MAX_COEFS];
+    float y[HALFBAND_MAX_COEFS];
+    int   num_coefs;
+};
@@ -1,6 +1,8 @@
-#include "daisy_seed.h"
+#include <chrono>
+
 #include "daisysp.h"
 #include "dub.h"
+#include "engine.h"
 
 /* ADCs and pin numbers (in Daisy Seed)
 
@@ -26,24 +28,22 @@ using namespace daisy;
 using namespace daisysp;
 
 // Daisy setup components
-KnobHandlerDaisy*   knob_handler   = new KnobHandlerDaisy();
-ButtonHandlerDaisy* button_handler = new ButtonHandlerDaisy();
-int                 SAMPLE_RATE = 0, BLOCK_SIZE = 0;
-float               output, adsr_vcf, adsr_output, vco_output, vco_modulation;
-volatile bool       shouldApplyToggles = false;
-std::pair<float, float> lfo_output     = std::make_pair(0, 0);
-
-// Dub Siren components
-DecayEnvelope* envelope;
-Sweep*         sweep;
-Triggers*      triggers;
-Lfo*           lfo;
-Vco*           vco;
-Vcf*           vcf;
-OutAmp*        out_amp;
-GPIO           led_sweep;
-GPIO           led_bank;
-Led            led_lfo;
+#ifndef DUB_HOST
+DaisySeed    hw;
+SirenEngine  engine DUB_DTCM;
+CpuLoadMeter cpu_load; // Audio callback load, printed when DEBUG is set
+ControlTask  control_task; // Control passes from TIM5, WFI in between
+float DSY_SDRAM_BSS delay_buffer[2 * DELAY_BUFFER_SIZE];
+float               reverb_buffer[REVERB_BUFFER_SIZE]; // .bss is AXI SRAM
+#if DUB_MIDI
+MidiUartTransport midi_trs; // TRS jack, UART on D13 (TX) and D14 (RX)
+MidiInput         midi_trs_input;
+#endif
+#if DUB_MIDI_USB
+MidiUsbTransport midi_usb; // USB port of the Seed
+MidiInput        midi_usb_input;
+#endif
+#endif
 
 
 //Initialize led1. We'll plug it into pin 28.
@@ -53,6 +53,55 @@ bool DEBUG = false;
 
 
 // KnobHandler functions
+// The output only moves when the smoothed reading leaves the dead band
+// around the last output, and snaps to the ends of the travel so that 0
+// and 1 are reachable
+bool KnobFilter::Process(float raw)
+{
+    bool first = !this->primed;
+    if(first)
+    {
+        this->smoothed = raw;
+        this->primed   = true;
+    }
+    else
+    {
+        this->smoothed += KNOB_SMOOTHING * (raw - this->smoothed);
+    }
+
+    // Within half the band of an end the knob is at that end. Leaving it
+    // takes the whole band, so the ends do not chatter either.
+    float target = this->smoothed;
+    if(target < KNOB_HYSTERESIS * 0.5f)
+    {
+        target = 0.0f;
+    }
+    else if(target > 1.0f - KNOB_HYSTERESIS * 0.5f)
+    {
+        target = 1.0f;
+    }
+    bool at_end = target == 0.0f || target == 1.0f;
+    if(!first
+       && (target == this->value
+           || (!at_end && fabsf(target - this->value) < KNOB_HYSTERESIS)))
+    {
+        return false;
+    }
+    this->value = target;
+    return true;
+}
+
+bool KnobHandler::Acquire(int channel, float raw)
+{
+    if(!this->filter[channel].Process(raw))
+    {
+        return false;
+    }
+    this->Values[channel] = this->filter[channel].Value();
+    return true;
+}
+
+#ifndef DUB_HOST
 void KnobHandlerDaisy::InitAll()
 {
     AdcChannelConfig my_adc_config[NUM_ADC_CHANNELS];
@@ -62,52 +111,92 @@ void KnobHandlerDaisy::InitAll()
     my_adc_config[TuneKnob].InitSingle(daisy::seed::A3);
     my_adc_config[SweepKnob].InitSingle(daisy::seed::A4);
     my_adc_config[RateKnob].InitSingle(daisy::seed::A5);
-    hw.adc.Init(my_adc_config, NUM_ADC_CHANNELS);
+    hw.adc.Init(my_adc_config, NUM_ADC_CHANNELS, KNOB_ADC_OVERSAMPLING);
     hw.adc.Start();
 }
 
 
 void KnobHandlerDaisy::UpdateAll()
 {
-    // VCO tune knobs
-    vco->TuneValue = fclamp(hw.adc.GetFloat(TuneKnob), 0.f, 1.f);
+    // The smoothing time is set in scans, timed by the control task
+    for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+    {
+        this->Acquire(i, hw.adc.GetFloat(i));
+    }
+}
+#endif // DUB_HOST
+// KnobHandler functions
 
-    // Decay Envelope knobs
-    envelope->ReleaseValue = fclamp(hw.adc.GetFloat(DecayKnob), 0.f, 1.f);
 
-    // Only update sweep value while a trigger is pressed
-    if(triggers->Pressed())
+// ButtonHandler functions
+void ButtonHandler::UpdateTrigger(int i, bool rising, bool falling, bool held)
+{
+    TriggerMask bit = (TriggerMask)1 << i;
+
+    // Atualiza estados
+    if(rising)
     {
-        sweep->ReleaseValue
-            = fmap(hw.adc.GetFloat(SweepKnob), 0.f, 1.f, Mapping::LINEAR);
+        this->TriggeredMask |= bit;
+        this->PressedMask |= bit;
+        this->ReleasedMask &= ~bit;
+        this->risingLatch |= bit;
+
+        // Remove se já estiver na pilha e adiciona no topo
+        this->pressStack.Push(i);
     }
+    else if(falling)
+    {
+        this->ReleasedMask |= bit;
+        this->PressedMask &= ~bit;
+        this->TriggeredMask &= ~bit;
+        this->fallingLatch |= bit;
 
-    // LFO depth (vibrato intensity 0-100%) and rate knobs
-    lfo->DepthValue = fclamp(hw.adc.GetFloat(DepthKnob), 0.f, 1.f);
-    lfo->RateValue  = fmap(
-        hw.adc.GetFloat(RateKnob), LFO_MIN_FREQ, LFO_MAX_FREQ, Mapping::EXP);
+        // Remove da pilha
+        this->pressStack.Remove(i);
+    }
+    else
+    {
+        this->PressedMask = held ? this->PressedMask | bit
+                                 : this->PressedMask & ~bit;
+        this->TriggeredMask &= ~bit;
+        this->ReleasedMask &= ~bit;
+    }
 
-    // OutAmp volume knob
-    out_amp->VolumeValue
-        = fmap(hw.adc.GetFloat(VolumeKnob), 0.f, 1.f, Mapping::EXP);
+    // Atualiza LastIndex
+    if(!this->pressStack.Empty())
+    {
+        this->LastIndex = this->pressStack.Top();
+    }
 }
-// KnobHandler functions
 
+void ButtonHandler::UpdateToggles(bool bankRising, bool sweepRising)
+{
+    if(bankRising)
+    {
+        this->bankSelectState = !this->bankSelectState;
+    }
 
-// ButtonHandler functions
+    if(sweepRising)
+    {
+        this->sweepToTuneState = !this->sweepToTuneState; // só o pendente
+    }
+}
+
+#ifndef DUB_HOST
 void ButtonHandlerDaisy::InitAll()
 {
-    this->triggers[0].Init(daisy::seed::D21, 50);
-    this->triggers[1].Init(daisy::seed::D22, 50);
-    this->triggers[2].Init(daisy::seed::D23, 50);
-    this->triggers[3].Init(daisy::seed::D24, 50);
-    this->bankSelect.Init(daisy::seed::D25, 50);
-    this->sweepToTune.Init(daisy::seed::D26, 50);
+    // Debounced once per control task tick
+    this->triggers[0].Init(daisy::seed::D21, CONTROL_TASK_RATE);
+    this->triggers[1].Init(daisy::seed::D22, CONTROL_TASK_RATE);
+    this->triggers[2].Init(daisy::seed::D23, CONTROL_TASK_RATE);
+    this->triggers[3].Init(daisy::seed::D24, CONTROL_TASK_RATE);
+    this->bankSelect.Init(daisy::seed::D25, CONTROL_TASK_RATE);
+    this->sweepToTune.Init(daisy::seed::D26, CONTROL_TASK_RATE);
 }
 
 void ButtonHandlerDaisy::DebounceAll()
 {
-    for(int i = 0; i < 4; i++)
+    for(int i = 0; i < NUM_TRIGGERS; i++)
     {
         this->triggers[i].Debounce();
     }
@@ -117,129 +206,273 @@ void ButtonHandlerDaisy::DebounceAll()
 
 void ButtonHandlerDaisy::UpdateAll()
 {
-    static std::vector<int> press_stack; // pilha de botões pressionados
+    for(int i = 0; i < NUM_TRIGGERS; i++)
+    {
+        this->UpdateTrigger(i,
+                            this->triggers[i].RisingEdge(),
+                            this->triggers[i].FallingEdge(),
+                            this->triggers[i].Pressed());
+    }
 
-    for(int i = 0; i < 4; i++)
+    // Update toggle buttons
+    this->UpdateToggles(this->bankSelect.RisingEdge(),
+                        this->sweepToTune.RisingEdge());
+}
+#endif // DUB_HOST
+// ButtonHandler functions
+
+
+// ControlTask functions
+#ifndef DUB_HOST
+void ControlTask::Init(int rate)
+{
+    TimerHandle::Config config;
+    config.periph     = TimerHandle::Config::Peripheral::TIM_5;
+    config.dir        = TimerHandle::Config::CounterDir::UP;
+    config.enable_irq = true;
+    this->timer.Init(config);
+    this->timer.SetPeriod(this->timer.GetFreq() / rate - 1);
+    this->timer.SetCallback(OnTimer, this);
+
+    this->window_start = System::GetTick();
+    this->timer.Start();
+}
+
+void ControlTask::OnTimer(void* context)
+{
+    static_cast<ControlTask*>(context)->ticks++;
+}
+
+uint32_t ControlTask::Wait()
+{
+    // Interrupts are masked around WFI: a pending one still wakes the
+    // core, but its handler runs once the wake up time is read, so handler
+    // time never counts as idle, and a tick that comes between the check
+    // and WFI wakes it at once instead of being slept through
+    __disable_irq();
+    if(this->ticks == this->handled)
     {
-        // Atualiza estados
-        if(this->triggers[i].RisingEdge())
-        {
-            this->triggersStates[i][0] = true;
-            this->triggersStates[i][1] = true;
-
-            // Remove se já estiver na pilha e adiciona no topo
-            press_stack.erase(
-                std::remove(press_stack.begin(), press_stack.end(), i),
-                press_stack.end());
-            press_stack.push_back(i);
-        }
-        else if(this->triggers[i].FallingEdge())
-        {
-            this->triggersStates[i][2] = true;
-            this->triggersStates[i][1] = false;
+        uint32_t start = System::GetTick();
+        __WFI();
+        this->idle_ticks += System::GetTick() - start;
+    }
+    __enable_irq();
 
-            // Remove da pilha
-            press_stack.erase(
-                std::remove(press_stack.begin(), press_stack.end(), i),
-                press_stack.end());
-        }
-        else
+    uint32_t ticks = this->ticks;
+    uint32_t due   = ticks - this->handled;
+    if(due > 1)
+    {
+        this->overruns += due - 1;
+    }
+    this->handled = ticks;
+    return due;
+}
+
+float ControlTask::IdleShare()
+{
+    uint32_t now     = System::GetTick();
+    uint32_t elapsed = now - this->window_start;
+    float    share   = elapsed ? (float)this->idle_ticks / elapsed : 0.0f;
+    this->window_start = now;
+    this->idle_ticks   = 0;
+    return share;
+}
+#endif // DUB_HOST
+// ControlTask functions
+
+
+// MidiInput functions
+void MidiInput::Receive(const uint8_t* data, size_t size, uint32_t now_us)
+{
+    MidiMessage msg;
+    for(size_t i = 0; i < size; i++)
+    {
+        if(this->parser.Parse(data[i], msg))
         {
-            this->triggersStates[i][1] = this->triggers[i].Pressed();
-            this->triggersStates[i][0] = false;
-            this->triggersStates[i][2] = false;
+            msg.time_us = now_us;
+            this->queue.Push(msg);
         }
     }
+}
+
+bool MidiInput::Pop(MidiMessage& msg)
+{
+    const MidiMessage* front = this->queue.Front();
+    if(front == nullptr)
+    {
+        return false;
+    }
+    msg = *front;
+    this->queue.PopFront();
+    return true;
+}
 
-    // Atualiza LastIndex
-    if(!press_stack.empty())
+int MidiInput::TriggerInput(const MidiMessage& msg)
+{
+    int type = msg.Type();
+    int note = msg.data[0] - MIDI_TRIGGER_NOTE;
+    if((MIDI_CHANNEL != 0 && msg.Channel() != MIDI_CHANNEL)
+       || (type != MIDI_NOTE_ON && type != MIDI_NOTE_OFF) || note < 0
+       || note >= NUM_TRIGGERS)
     {
-        this->LastIndex = press_stack.back();
+        return -1;
     }
+    return MIDI_TRIGGER_INPUT + note;
+}
 
-    // Update toggle buttons
-    if(this->bankSelect.RisingEdge())
+bool MidiInput::Apply(const MidiMessage& msg,
+                      KnobHandler&       knobs,
+                      ButtonHandler&     buttons)
+{
+    if(MIDI_CHANNEL != 0 && msg.Channel() != MIDI_CHANNEL)
     {
-        this->bankSelectState = !this->bankSelectState;
+        return false;
     }
 
-    if(this->sweepToTune.RisingEdge())
+    int input = TriggerInput(msg);
+    if(input >= 0)
     {
-        this->sweepToTuneState = !this->sweepToTuneState; // só o pendente
+        // Note on with velocity 0 is a note off
+        bool on = msg.Type() == MIDI_NOTE_ON && msg.data[1] > 0;
+        buttons.UpdateTrigger(input, on, !on, on);
+        return true;
     }
+    if(msg.Type() == MIDI_CONTROL_CHANGE)
+    {
+        for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+        {
+            if(msg.data[0] == midi_knob_cc[i])
+            {
+                knobs.Values[i] = msg.data[1] / 127.0f;
+                return true;
+            }
+        }
+        return false;
+    }
+    if(msg.Type() == MIDI_PROGRAM_CHANGE)
+    {
+        buttons.bankSelectState  = (msg.data[0] & 1) != 0;
+        buttons.sweepToTuneState = (msg.data[0] & 2) != 0;
+        return true;
+    }
+    return false;
 }
-
-// ButtonHandler functions
+// MidiInput functions
 
 
 // Init functions
-void InitComponents(int sample_rate, int block_size)
+#if DUB_PROFILER
+#ifdef DUB_HOST
+uint32_t ProfileTicks()
 {
-    triggers = new Triggers();
-    envelope = new DecayEnvelope(sample_rate, block_size);
-    sweep    = new Sweep(sample_rate, block_size);
-    lfo      = new Lfo(sample_rate);
-    vco      = new Vco(sample_rate);
-    vcf      = new Vcf(sample_rate);
-    out_amp  = new OutAmp();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
 }
+#else
+DUB_ITCM uint32_t ProfileTicks()
+{
+    return DWT->CYCCNT;
+}
+#endif
+
+void InitProfiler(Profiler& profiler, int sample_rate)
+{
+#ifdef DUB_HOST
+    profiler.Init(1000000000u, sample_rate, ProfileTicks);
+#else
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    profiler.Init(System::GetSysClkFreq(), sample_rate, ProfileTicks);
+#endif
+}
+#endif
+
 // Init functions
 
 
-// DecayEnvelope functions
-void DecayEnvelope::SetReleaseTime(float time)
+// ExpRamp functions
+DUB_ITCM void ExpRamp::Anchor(float exponent)
 {
-    this->envelope.SetTime(ADSR_SEG_RELEASE, time);
+    // The slope of the last sample continues the line
+    this->step = this->primed ? exponent - this->prev : 0.0f;
+    this->line = exponent;
+    this->freq = this->map(exponent);
+#if DUB_FAST_MATH
+    this->ratio = FastExp2(this->octaves * this->step);
+#else
+    this->ratio = exp2f(this->octaves * this->step);
+#endif
+    this->run    = SWEEP_RAMP_MAX_RUN;
+    this->primed = true;
 }
+// ExpRamp functions
 
-float DecayEnvelope::Process(bool gate)
+
+// DecayEnvelope functions
+void DecayEnvelope::SetSampleRate(int sample_rate)
 {
-    this->EnvelopeValue = this->envelope.Process(gate);
-    return this->EnvelopeValue;
+    this->envelope.Init(sample_rate, ADSR_TIME_SCALE);
+    this->envelope.SetTime(ADSR_SEG_ATTACK, ADSR_ATTACK_TIME);
+    this->envelope.SetTime(ADSR_SEG_DECAY, ADSR_DECAY_TIME);
+    this->envelope.SetTime(ADSR_SEG_RELEASE, ADSR_RELEASE_TIME);
+    this->envelope.SetSustainLevel(ADSR_SUSTAIN_LEVEL);
+    this->releaseWatch = ParameterWatch(); // Decay knob applied again
 }
 
+DUB_ITCM void DecayEnvelope::SetReleaseTime(float time)
+{
+    this->envelope.SetTime(ADSR_SEG_RELEASE, time);
+}
 
-// Triggers functions
-bool Triggers::Triggered()
+DUB_ITCM void DecayEnvelope::UpdateControls()
 {
-    for(int i = 0; i < 4; i++)
+    // Adsr coefficients only need recomputing when the decay knob moves
+    if(this->releaseWatch.Changed(this->ReleaseValue))
     {
-        if(button_handler->triggersStates[i][0])
-            return true;
+        this->SetReleaseTime(
+            ADSR_MIN_RELEASE_TIME
+            + (this->ReleaseValue
+               * (ADSR_RELEASE_TIME - ADSR_MIN_RELEASE_TIME)));
     }
-    return false;
 }
 
-bool Triggers::Pressed()
+DUB_ITCM float DecayEnvelope::Process(bool gate)
 {
-    for(int i = 0; i < 4; i++)
-    {
-        if(button_handler->triggersStates[i][1])
-            return true;
-    }
-    return false;
+    this->EnvelopeValue = this->envelope.Process(gate);
+    return this->EnvelopeValue;
 }
 
-bool Triggers::Released()
+DUB_ITCM void DecayEnvelope::ProcessBlock(float* buf, size_t n, bool gate)
 {
-    for(int i = 0; i < 4; i++)
+    for(size_t i = 0; i < n; i++)
     {
-        if(button_handler->triggersStates[i][2])
-            return true;
+        buf[i] = this->envelope.Process(gate);
+    }
+    if(n > 0)
+    {
+        this->EnvelopeValue = buf[n - 1];
     }
-    return false;
 }
 
-void Triggers::ClearTriggered()
+
+// Triggers functions
+DUB_ITCM void Triggers::Update(const ControlFrame& frame)
 {
-    for(int i = 0; i < 4; i++)
-    {
-        if(button_handler->triggersStates[i][0])
-        {
-            button_handler->triggersStates[i][0] = false;
-            break; // Only clear one trigger per call
-        }
-    }
+    this->triggered          = frame.rising;
+    this->pressed            = frame.held;
+    this->released           = frame.falling;
+    this->LastIndex          = frame.lastIndex;
+    this->pendingBankSelect  = frame.bankSelect;
+    this->pendingSweepToTune = frame.sweepToTune;
+}
+
+DUB_ITCM void Triggers::ApplyToggles()
+{
+    // Aplicar mudanças pendentes
+    this->IsBankSelectActive  = this->pendingBankSelect;
+    this->IsSweepToTuneActive = this->pendingSweepToTune;
 }
 
 // bool Triggers::IsBankSelectActive()
@@ -255,18 +488,28 @@ void Triggers::ClearTriggered()
     return button_handler->sweepToTuneState;
 } */
 
-void Sweep::SetReleaseTime(float time)
+void Sweep::SetSampleRate(int sample_rate)
+{
+    this->envelope.Init(sample_rate, ADSR_TIME_SCALE);
+    this->envelope.SetTime(ADSR_SEG_ATTACK, ADSR_ATTACK_TIME);
+    this->envelope.SetTime(ADSR_SEG_DECAY, ADSR_DECAY_TIME);
+    this->envelope.SetTime(ADSR_SEG_RELEASE, ADSR_RELEASE_TIME);
+    this->envelope.SetSustainLevel(ADSR_SUSTAIN_LEVEL);
+    this->pitch_ramp.Reset();
+}
+
+DUB_ITCM void Sweep::SetReleaseTime(float time)
 {
     this->envelope.SetTime(ADSR_SEG_RELEASE, time);
 }
 
-float Sweep::Process(bool gate)
+DUB_ITCM float Sweep::Process(bool gate)
 {
     this->EnvelopeValue = this->envelope.Process(gate);
     return this->EnvelopeValue;
 }
 
-float Sweep::CalculateFilterIntensity(float sweepValue)
+DUB_ITCM float Sweep::CalculateFilterIntensity(float sweepValue)
 {
     // Map sweepVal from [0,1] to [-1,1]
     float direction = 2.0f * (sweepValue - 0.5f);
@@ -282,12 +525,12 @@ float Sweep::CalculateFilterIntensity(float sweepValue)
     if(direction > threshold)
     {
         intensity
-            = 0.5f * powf((abs_dir - threshold) / (1.0f - threshold), 2.0f);
+            = 0.5f * FastSquare((abs_dir - threshold) / (1.0f - threshold));
     }
     else if(direction < -threshold)
     {
         intensity
-            = 2.f * powf((abs_dir - threshold) / (1.0f - threshold), 0.5f);
+            = 2.f * FastSqrt((abs_dir - threshold) / (1.0f - threshold));
         // intensity = 3.f;
     }
     // If sweep is in the threshold interval, maintain 0.
@@ -295,7 +538,7 @@ float Sweep::CalculateFilterIntensity(float sweepValue)
     return intensity;
 }
 
-float Sweep::CalculateVcoIntensity(float sweepValue)
+DUB_ITCM float Sweep::CalculateVcoIntensity(float sweepValue)
 {
     // Map sweepVal from [0,1] to [-1,1]
     float direction = 2.0f * (sweepValue - 0.5f);
@@ -308,19 +551,21 @@ float Sweep::CalculateVcoIntensity(float sweepValue)
     if(direction > threshold)
     {
         intensity
-            = 0.75f * powf((abs_dir - threshold) / (1.0f - threshold), 2.0f);
+            = 0.75f * FastSquare((abs_dir - threshold) / (1.0f - threshold));
     }
     else if(direction < -threshold)
     {
         intensity
-            = 0.75f * powf((abs_dir - threshold) / (1.0f - threshold), 2.0f);
+            = 0.75f * FastSquare((abs_dir - threshold) / (1.0f - threshold));
     }
     // If sweep is in the threshold interval, maintain 0.
 
     return intensity;
 }
 
-float Sweep::UpdateCutoffFreq(float sweepValue, Vcf* vcf, float adsrOutput)
+DUB_ITCM float Sweep::UpdateCutoffExp(float sweepValue,
+                                      Vcf*  vcf,
+                                      float adsrOutput)
 {
     float base_exp = vcf->CutoffExponent;
 
@@ -336,103 +581,198 @@ float Sweep::UpdateCutoffFreq(float sweepValue, Vcf* vcf, float adsrOutput)
     float end_exp = 0.5f - 0.5f * direction;
 
     // Blend start and end exponents modulated by ADSR and sweep intensity
-    float sweep_exp
-        = base_exp + (end_exp - base_exp) * (1.0f - adsrOutput) * intensity;
-
-    // Final exponential frequency
-    return VCF_MIN_FREQ * powf(VCF_MAX_FREQ / VCF_MIN_FREQ, sweep_exp);
+    return base_exp + (end_exp - base_exp) * (1.0f - adsrOutput) * intensity;
 }
 
-// --- Lfo functions ---
-void Lfo::UpdateWaveforms(int index, bool bankB)
+DUB_ITCM void Sweep::UpdateCutoffExpBlock(float*       buf,
+                                          const float* adsr,
+                                          size_t       n,
+                                          float        sweepValue,
+                                          Vcf*         vcf)
 {
-    if(bankB)
+    // Same curve as UpdateCutoffExp, with the per-block terms hoisted
+    float base_exp  = vcf->CutoffExponent;
+    float direction = 2.0f * (sweepValue - 0.5f);
+    float intensity = this->CalculateFilterIntensity(sweepValue);
+    float end_exp   = 0.5f - 0.5f * direction;
+
+    for(size_t i = 0; i < n; i++)
     {
-        switch(index)
-        {
-            case 0:
-                osc[0].SetWaveform(Oscillator::WAVE_SIN);
-                osc_harm[0].SetWaveform(Oscillator::WAVE_SIN);
-                break;
-            case 1:
-                osc[1].SetWaveform(Oscillator::WAVE_SQUARE);
-                osc_harm[1].SetWaveform(Oscillator::WAVE_SQUARE);
-                break;
-            case 2:
-                osc[2].SetWaveform(Oscillator::WAVE_SQUARE);
-                osc_harm[2].SetWaveform(Oscillator::WAVE_SAW);
-                break;
-            case 3:
-                osc[3].SetWaveform(Oscillator::WAVE_RAMP);
-                osc_harm[3].SetWaveform(Oscillator::WAVE_RAMP);
-                break;
-        }
+        buf[i] = base_exp + (end_exp - base_exp) * (1.0f - adsr[i]) * intensity;
     }
-    else
-    {
-        static constexpr int waves[4] = {Oscillator::WAVE_SIN,
-                                         Oscillator::WAVE_SQUARE,
-                                         Oscillator::WAVE_SAW,
-                                         Oscillator::WAVE_RAMP};
+}
 
-        osc[index].SetWaveform(waves[index]);
-    }
+DUB_ITCM float
+Sweep::UpdateVcoFreq(float sweepValue, float tuneValue, float adsrOutput)
+{
+    // Carrier frequency with the sweep-to-tune envelope applied
+    float direction = 2.0f * (sweepValue - 0.5f);
+    float intensity = this->CalculateVcoIntensity(sweepValue);
+    float end_exp   = 0.5f - 0.5f * direction;
+    float sweep_exp
+        = tuneValue + (end_exp - tuneValue) * (1.0f - adsrOutput) * intensity;
+    return this->pitch_ramp.Process(sweep_exp);
 }
 
-float Lfo::MixLfoSignals(int index, bool bankB)
+DUB_ITCM void Sweep::UpdateVcoFreqBlock(float*       buf,
+                                        const float* adsr,
+                                        size_t       n,
+                                        float        sweepValue,
+                                        float        tuneValue)
 {
-    float base = osc[index].Process();
-    float harm = osc_harm[index].Process();
+    // Carrier frequency with the sweep-to-tune envelope applied
+    float direction = 2.0f * (sweepValue - 0.5f);
+    float intensity = this->CalculateVcoIntensity(sweepValue);
+    float end_exp   = 0.5f - 0.5f * direction;
 
-    if(bankB)
+    for(size_t i = 0; i < n; i++)
     {
-        switch(index)
-        {
-            case 0: return 0.5f * (base + harm);        // sin + sin(3x)
-            case 1: return 0.5f * (base + harm);        // square + square(4x)
-            case 2: return 0.5f * (base + harm);        // square + saw(4x)
-            case 3: return 0.5f * (base + 0.5f * harm); // ramp + 0.5*ramp(2x)
-        }
+        float sweep_exp
+            = tuneValue + (end_exp - tuneValue) * (1.0f - adsr[i]) * intensity;
+        buf[i] = this->pitch_ramp.Process(sweep_exp);
     }
-
-    return base;
 }
 
-
-void Lfo::SetAmpAll(float amp)
+// --- Lfo functions ---
+// Per-lane weights of each shape of the base and harmonic oscillators,
+// then of each oscillator in the voice. A saw is a ramp of weight -1.
+struct LfoBank
 {
-    for(int i = 0; i < 4; i++)
+    float sine[4], square[4], ramp[4];
+    float harm_sine[4], harm_square[4], harm_ramp[4];
+    float base_gain[4], harm_gain[4];
+};
+
+// Bank A: sine, square, saw and ramp alone. Bank B mixes each with its
+// harmonic at half the level each: sin + sin(4x), square + square(8x),
+// square + saw(8x) and ramp + 0.5 * ramp(2x). The harmonics play at half
+// amplitude, so their gains are a quarter and an eighth.
+static const LfoBank lfo_banks[2] = {
+    {{1.0f, 0.0f, 0.0f, 0.0f},
+     {0.0f, 1.0f, 0.0f, 0.0f},
+     {0.0f, 0.0f, -1.0f, 1.0f},
+     {0.0f, 0.0f, 0.0f, 0.0f},
+     {0.0f, 0.0f, 0.0f, 0.0f},
+     {0.0f, 0.0f, 0.0f, 0.0f},
+     {1.0f, 1.0f, 1.0f, 1.0f},
+     {0.0f, 0.0f, 0.0f, 0.0f}},
+    {{1.0f, 0.0f, 0.0f, 0.0f},
+     {0.0f, 1.0f, 1.0f, 0.0f},
+     {0.0f, 0.0f, 0.0f, 1.0f},
+     {1.0f, 0.0f, 0.0f, 0.0f},
+     {0.0f, 1.0f, 0.0f, 0.0f},
+     {0.0f, 0.0f, -1.0f, 1.0f},
+     {0.5f, 0.5f, 0.5f, 0.5f},
+     {0.25f, 0.25f, 0.25f, 0.125f}},
+};
+
+static const float lfo_harm_ratios[4] = {4.0f, 8.0f, 8.0f, 2.0f};
+static const float lfo_lanes[4]       = {0.0f, 1.0f, 2.0f, 3.0f};
+
+// A bank and the selected voices as vectors, loaded once per call. The
+// scalar voices read the bank as it is.
+struct LfoWeights
+{
+#if DUB_SIMD == DUB_SIMD_SCALAR
+    LfoWeights(const LfoBank& bank, int, int)
     {
-        this->osc[i].SetAmp(amp);
+        this->bank      = &bank;
+        this->harmonics = bank.harm_gain[0] > 0.0f;
     }
-}
 
-void Lfo::SetFreqAll(float freq)
-{
-    static constexpr float harm_ratios[4] = {4.0f, 8.0f, 8.0f, 2.0f};
+    const LfoBank* bank;
+    bool           harmonics; // Any harmonic mixed in, bank B
+#else
+    LfoWeights(const LfoBank& bank, int currIndex, int prevIndex)
+    {
+        this->sine        = Vec4::Load(bank.sine);
+        this->square      = Vec4::Load(bank.square);
+        this->ramp        = Vec4::Load(bank.ramp);
+        this->harm_sine   = Vec4::Load(bank.harm_sine);
+        this->harm_square = Vec4::Load(bank.harm_square);
+        this->harm_ramp   = Vec4::Load(bank.harm_ramp);
+        this->base_gain   = Vec4::Load(bank.base_gain);
+        this->harm_gain   = Vec4::Load(bank.harm_gain);
+
+        Vec4 lanes = Vec4::Load(lfo_lanes);
+        this->curr      = lanes == Vec4::Splat((float)currIndex);
+        this->prev      = lanes == Vec4::Splat((float)prevIndex);
+        this->harm      = this->harm_gain > Vec4::Splat(0.0f);
+        this->harmonics = bank.harm_gain[0] > 0.0f;
+    }
 
-    for(int i = 0; i < 4; i++)
+    Vec4  sine, square, ramp, harm_sine, harm_square, harm_ramp;
+    Vec4  base_gain, harm_gain;
+    Mask4 curr, prev; // Lanes of the voices, current and fading out
+    Mask4 harm;       // Lanes with the harmonic mixed in
+    bool  harmonics;  // Any of them, bank B
+#endif
+};
+
+#if DUB_SIMD == DUB_SIMD_SCALAR
+// The shape of one oscillator alone, the one its weight selects. Same
+// value as LfoShape: the other terms are zero there.
+DUB_ITCM static inline float
+LfoVoiceShape(float p, float sine, float square, float ramp)
+{
+    if(sine != 0.0f)
     {
-        osc[i].SetFreq(freq);
-        osc_harm[i].SetFreq(freq * harm_ratios[i]);
+        return sine * FastSinTurns(p);
     }
+    if(square != 0.0f)
+    {
+        return square * (p < 0.5f ? 1.0f : -1.0f);
+    }
+    return ramp * (p * 2.0f - 1.0f);
 }
+#else
+// Every shape of the phases p, the one of each lane kept by its weight
+DUB_ITCM static inline Vec4 LfoShape(Vec4 p, Vec4 sine, Vec4 square, Vec4 ramp)
+{
+    const Vec4 one = Vec4::Splat(1.0f);
+    Vec4       sq  = Select(p < Vec4::Splat(0.5f), one, Vec4::Splat(-1.0f));
+    Vec4       rp  = p * Vec4::Splat(2.0f) - one;
+    return sine * FastSinTurns(p) + square * sq + ramp * rp;
+}
+#endif
 
+void Lfo::SetSampleRate(int sample_rate)
+{
+    this->sr_recip   = 1.0f / sample_rate;
+    this->phase      = Vec4::Splat(0.0f);
+    this->harm_phase = Vec4::Splat(0.0f);
+    this->SetFreqAll(100.0f); // Until the rate knob is applied
+    this->fadeRate  = 1.0f / (sample_rate * LFO_FADE_TIME);
+    this->rateWatch = ParameterWatch(); // Rate knob applied again
+}
 
-void Lfo::ResetPhaseAll()
+DUB_ITCM void Lfo::SetFreqAll(float freq)
 {
-    for(int i = 0; i < 4; i++)
+    this->inc      = Vec4::Splat(freq * this->sr_recip);
+    this->harm_inc = Vec4::Load(lfo_harm_ratios) * Vec4::Splat(freq)
+                     * Vec4::Splat(this->sr_recip);
+}
+
+DUB_ITCM void Lfo::UpdateControls()
+{
+    // Phase accumulators follow rate changes without clicks, so the new
+    // rate is applied as is instead of being smoothed
+    if(this->rateWatch.Changed(this->RateValue))
     {
-        this->osc[i].Reset(0.0f);
-        this->osc_harm[i].Reset(0.0f);
+        this->SetFreqAll(this->RateValue);
     }
 }
 
-std::pair<float, float> Lfo::ProcessAll()
+DUB_ITCM void Lfo::ResetPhaseAll()
 {
-    int index = button_handler->LastIndex;
-    // Use o banco atualmente ativo
-    bool bankB = button_handler->currentBankState;
+    this->phase      = Vec4::Splat(0.0f);
+    this->harm_phase = Vec4::Splat(0.0f);
+}
+
+DUB_ITCM void Lfo::SelectVoice(const Triggers& triggers)
+{
+    // Triggers past the panel buttons reuse the four LFO voices
+    int index = triggers.LastIndex % NUM_TRIGGERS;
 
     // Nova seleção → inicia crossfade
     if(index != currIndex)
@@ -441,23 +781,100 @@ std::pair<float, float> Lfo::ProcessAll()
         currIndex    = index;
         fadeProgress = 0.0f;
     }
+}
 
-    fadeProgress = fminf(fadeProgress + fadeRate, 1.0f);
-
-    float out = 0.0f;
+#if DUB_SIMD == DUB_SIMD_SCALAR
+// Without a vector unit only the voices heard are computed, one or two, in
+// lane order: the sum of the vector version with its zero terms left out
+template <bool Harmonics>
+DUB_ITCM inline float
+Lfo::Process(const LfoWeights& weights, Vec4& phase, Vec4& harm_phase)
+{
+    float progress = fadeProgress + fadeRate;
+    fadeProgress   = progress < 1.0f ? progress : 1.0f;
+    int prev       = fadeProgress < 1.0f ? prevIndex : -1;
 
-    if(currIndex >= 0)
+    const LfoBank& bank = *weights.bank;
+    float          out  = 0.0f;
+    for(int i = 0; i < 4; i++)
     {
-        UpdateWaveforms(currIndex, bankB);
-        out += MixLfoSignals(currIndex, bankB) * fadeProgress;
+        if(i != currIndex && i != prev)
+        {
+            continue;
+        }
+        float voice = i == currIndex ? fadeProgress : 1.0f - fadeProgress;
+        float p     = phase.v[i];
+        float base
+            = LfoVoiceShape(p, bank.sine[i], bank.square[i], bank.ramp[i]);
+        float mix  = bank.base_gain[i] * base;
+        p          = p + this->inc.v[i];
+        phase.v[i] = p > 1.0f ? p - 1.0f : p;
+        if(Harmonics && bank.harm_gain[i] > 0.0f)
+        {
+            float h    = harm_phase.v[i];
+            float harm = LfoVoiceShape(h,
+                                       bank.harm_sine[i],
+                                       bank.harm_square[i],
+                                       bank.harm_ramp[i]);
+            mix             = mix + bank.harm_gain[i] * harm;
+            h               = h + this->harm_inc.v[i];
+            harm_phase.v[i] = h > 1.0f ? h - 1.0f : h;
+        }
+        out = out + mix * voice;
     }
-
-    if(prevIndex >= 0 && fadeProgress < 1.0f)
+    return out;
+}
+#else
+template <bool Harmonics>
+DUB_ITCM inline float
+Lfo::Process(const LfoWeights& weights, Vec4& phase, Vec4& harm_phase)
+{
+    // fminf is a library call on x86 hosts
+    float progress = fadeProgress + fadeRate;
+    fadeProgress   = progress < 1.0f ? progress : 1.0f;
+
+    // Crossfade weight of each voice, the previous one until the fade ends
+    const Vec4 zero = Vec4::Splat(0.0f);
+    const Vec4 one  = Vec4::Splat(1.0f);
+    Vec4       fade = Vec4::Splat(fadeProgress);
+    Mask4      curr = weights.curr;
+    Mask4      prev = weights.prev & (fade < one);
+    Vec4 voice = Select(curr, fade, zero) + Select(prev, one - fade, zero);
+
+    // The lanes heard move on, the harmonics only where they are mixed in
+    Mask4 heard = curr | prev;
+    Vec4  base = LfoShape(phase, weights.sine, weights.square, weights.ramp);
+    Vec4  mix  = weights.base_gain * base;
+    Vec4  p    = phase + Select(heard, this->inc, zero);
+    phase      = Select(p > one, p - one, p);
+    if(Harmonics)
     {
-        UpdateWaveforms(prevIndex, bankB);
-        out += MixLfoSignals(prevIndex, bankB) * (1.0f - fadeProgress);
+        Vec4 harm = LfoShape(harm_phase,
+                             weights.harm_sine,
+                             weights.harm_square,
+                             weights.harm_ramp);
+        Mask4 moving = heard & weights.harm;
+        Vec4  h      = harm_phase + Select(moving, this->harm_inc, zero);
+        mix          = mix + weights.harm_gain * harm;
+        harm_phase   = Select(h > one, h - one, h);
     }
 
+    return Sum(mix * voice);
+}
+#endif
+
+DUB_ITCM std::pair<float, float> Lfo::ProcessAll(const Triggers& triggers)
+{
+    this->SelectVoice(triggers);
+    // Use o banco atualmente ativo
+    LfoWeights weights(lfo_banks[triggers.IsBankSelectActive],
+                       this->currIndex,
+                       this->prevIndex);
+    float out
+        = weights.harmonics
+              ? this->Process<true>(weights, this->phase, this->harm_phase)
+              : this->Process<false>(weights, this->phase, this->harm_phase);
+
     // Convert LFO output to modulation signal [0,1]
     // No longer scaling by DepthValue here - FM ratio handles this now
     float modsig = 0.5f + out;
@@ -465,21 +882,92 @@ std::pair<float, float> Lfo::ProcessAll()
     return std::make_pair(out, modsig);
 }
 
+DUB_ITCM void Lfo::ProcessBlock(float* buf, size_t n, const Triggers& triggers)
+{
+    // Writes the [0,1] modulation signal (ProcessAll().second) per sample.
+    // The voice and the bank only change between blocks.
+    this->SelectVoice(triggers);
+    LfoWeights weights(lfo_banks[triggers.IsBankSelectActive],
+                       this->currIndex,
+                       this->prevIndex);
+    Vec4 phase      = this->phase;
+    Vec4 harm_phase = this->harm_phase;
+    for(size_t i = 0; i < n; i++)
+    {
+        buf[i] = 0.5f
+                 + (weights.harmonics
+                        ? this->Process<true>(weights, phase, harm_phase)
+                        : this->Process<false>(weights, phase, harm_phase));
+    }
+    this->phase      = phase;
+    this->harm_phase = harm_phase;
+}
+
 // --- Lfo functions ---
 
 
 // Vco functions
-void Vco::SetFreq(float freq)
+void Vco::SetSampleRate(int sample_rate, int oversampling)
+{
+#if DUB_VCO_WAVETABLE
+    this->osc.Init(sample_rate * oversampling, VCO_WAVETABLE_SHAPE);
+    this->osc.SetAmp(VCO_WAVETABLE_AMP);
+#else
+    this->osc.Init(sample_rate * oversampling);
+    this->osc.SetWaveform(VCO_WAVEFORM);
+    this->osc.SetAmp(1.0f);
+#endif
+    this->osc.SetFreq(440.0f);
+    // Safe Nyquist limit for the frequency folding, of the output rate
+    this->nyquist_limit = sample_rate / 2.0f;
+}
+
+DUB_ITCM void Vco::SetFreq(float freq)
 {
     this->osc.SetFreq(freq);
 }
 
-float Vco::Process()
+DUB_ITCM void Vco::UpdateControls()
+{
+    // Carrier frequency from tune knob, only recalculated when it moves
+    bool primed = this->tuneWatch.Primed();
+    if(this->tuneWatch.Changed(this->TuneValue))
+    {
+        float carrier_freq = VcoExpToFreq(this->TuneValue);
+        if(DUB_PARAM_SMOOTHING && primed)
+        {
+            this->carrier.SetTarget(carrier_freq);
+        }
+        else
+        {
+            this->carrier.Reset(carrier_freq);
+        }
+    }
+}
+
+DUB_ITCM void Vco::CarrierBlock(float* buf, size_t n)
+{
+    this->carrier.Process(buf, n);
+}
+
+DUB_ITCM float Vco::Process()
 {
     return this->osc.Process();
 }
 
-float Vco::CalculateFMFreq(float carrier_freq, float lfo_bipolar, float depth)
+DUB_ITCM void Vco::ProcessBlock(float* buf, size_t n)
+{
+    // buf holds the frequency of each sample and is overwritten with audio
+    for(size_t i = 0; i < n; i++)
+    {
+        this->osc.SetFreq(buf[i]);
+        buf[i] = this->osc.Process();
+    }
+}
+
+DUB_ITCM float Vco::CalculateFMFreq(float carrier_freq,
+                                    float lfo_bipolar,
+                                    float depth)
 {
     // FM synthesis: M = C / R (Modulator freq = Carrier freq / Ratio)
     float modulator_freq = carrier_freq / this->fm_ratio;
@@ -507,18 +995,69 @@ float Vco::CalculateFMFreq(float carrier_freq, float lfo_bipolar, float depth)
 
     return freq;
 }
+
+DUB_ITCM void Vco::CalculateFMFreqBlock(float*       buf,
+                                        const float* lfo,
+                                        size_t       n,
+                                        float        depth)
+{
+    // buf holds the carrier frequencies, lfo the [0,1] modulation signal
+    for(size_t i = 0; i < n; i++)
+    {
+        float lfo_bipolar = (lfo[i] - 0.5f) * 2.0f;
+        buf[i]            = this->CalculateFMFreq(buf[i], lfo_bipolar, depth);
+    }
+}
 // Vco functions
 
 
 // Vcf functions
-void Vcf::SetFreq(float freq)
+void Vcf::SetSampleRate(int sample_rate, int oversampling)
+{
+    this->max_freq   = sample_rate / 4;
+    this->cutoffHeld = false;
+    this->sweepWatch = ParameterWatch();
+#if DUB_VCF_ZDF
+    // Same Q and soft limit as the Svf at VCF_RESONANCE and VCF_DRIVE:
+    // damping 2 * (1 - res^0.25), cubic drive min(drive / 10, 1) * res on
+    // each of its two passes per sample
+    float damping = 2.0f * (1.0f - powf(VCF_RESONANCE, 0.25f));
+    float drive   = 2.0f * fminf(VCF_DRIVE * 0.1f, 1.0f) * VCF_RESONANCE;
+    this->filter.Init(sample_rate * oversampling,
+                      VcfExpToFreq,
+                      this->max_freq,
+                      damping,
+                      drive);
+    this->filter.SetExponent(this->exponent);
+#else
+    this->filter.Init(sample_rate * oversampling);
+    this->filter.SetDrive(VCF_DRIVE);
+    this->filter.SetRes(VCF_RESONANCE);
+    this->cutoff_ramp.Reset();
+    this->SetFreq(VcfExpToFreq(this->exponent));
+#endif
+}
+
+#if !DUB_VCF_ZDF
+DUB_ITCM void Vcf::SetFreq(float freq)
 {
-    // Svf filter accepts frequency up to SAMPLE_RATE / 3
-    float limited_freq = fclamp(freq, VCF_MIN_FREQ, SAMPLE_RATE / 4);
+    // Svf filter accepts frequency up to a third of the sample rate
+    float limited_freq = fclamp(freq, VCF_MIN_FREQ, this->max_freq);
     this->filter.SetFreq(limited_freq);
 }
+#endif
 
-void Vcf::UpdateCutoffPressed(float sweepValue)
+DUB_ITCM void Vcf::SetExponent(float exponent)
+{
+    this->exponent = exponent;
+#if DUB_VCF_ZDF
+    this->filter.SetExponent(exponent);
+#else
+    this->SetFreq(this->cutoff_ramp.Process(exponent));
+#endif
+}
+
+DUB_ITCM void Vcf::UpdateCutoffPressed(float sweepValue)
 {
     // Map the sweep value to a piecewise linear interpolation
     // 0%  to 50%  -> 0%  to 75%
@@ -532,219 +1071,598 @@ void Vcf::UpdateCutoffPressed(float sweepValue)
         this->CutoffExponent = 0.75f + ((sweepValue - 0.5f) / 0.5f) * 0.25f;
     }
 
-    this->CutoffFreq
-        = VCF_MIN_FREQ
-          * powf(VCF_MAX_FREQ / VCF_MIN_FREQ, this->CutoffExponent);
-    this->SetFreq(this->CutoffFreq);
+#if DUB_VCF_ZDF
+    this->SetExponent(this->CutoffExponent);
+#else
+    // Exact mapping, the ramp only follows the sweeps
+    this->exponent = this->CutoffExponent;
+    this->SetFreq(VcfExpToFreq(this->CutoffExponent));
+#endif
 }
 
-float Vcf::Process(float in)
+DUB_ITCM void Vcf::UpdateCutoffPressedBlock(const Parameter& sweepValue)
 {
-    this->filter.Process(in);
-    return this->filter.Low(); // Return low-pass output
+    // While a trigger is held the cutoff only follows the sweep knob, so it
+    // is set again after a release sweep or when the knob moves
+    if(this->sweepWatch.Changed(sweepValue) || !this->cutoffHeld)
+    {
+        this->UpdateCutoffPressed(sweepValue);
+    }
+    this->cutoffHeld = true;
+}
+
+template <typename T>
+inline T Vcf::Tick(T in)
+{
+#if DUB_VCF_ZDF
+    return this->filter.Tick(in);
+#else
+    // The Svf is float only
+    this->filter.Process(Sample<T>::ToFloat(in));
+    return Sample<T>::FromFloat(this->filter.Low()); // Low-pass output
+#endif
+}
+
+DUB_ITCM float Vcf::Process(float in)
+{
+    return this->Tick(in);
+}
+
+template <typename T>
+DUB_ITCM void Vcf::ProcessBlock(T* buf, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        buf[i] = this->Tick(buf[i]);
+    }
+}
+
+template <typename T>
+DUB_ITCM void Vcf::ProcessBlock(T* buf, const float* cutoff, size_t n)
+{
+    // Cutoff exponent modulated per sample (sweep release)
+#if DUB_VCF_ZDF
+    // Only the coefficients of T follow the sweep
+    for(size_t i = 0; i < n; i++)
+    {
+        this->filter.SetExponent<T>(cutoff[i]);
+        buf[i] = this->Tick(buf[i]);
+    }
+    this->exponent = cutoff[n - 1];
+#else
+    for(size_t i = 0; i < n; i++)
+    {
+        this->SetExponent(cutoff[i]);
+        buf[i] = this->Tick(buf[i]);
+    }
+#endif
+    this->cutoffHeld = false;
+}
+
+template void Vcf::ProcessBlock<float>(float* buf, size_t n);
+template void Vcf::ProcessBlock<q31_t>(q31_t* buf, size_t n);
+template void Vcf::ProcessBlock<q15_t>(q15_t* buf, size_t n);
+template void
+Vcf::ProcessBlock<float>(float* buf, const float* cutoff, size_t n);
+template void
+Vcf::ProcessBlock<q31_t>(q31_t* buf, const float* cutoff, size_t n);
+template void
+Vcf::ProcessBlock<q15_t>(q15_t* buf, const float* cutoff, size_t n);
+
+DUB_ITCM void Vcf::ProcessBlock(float*       buf,
+                                const float* cutoff,
+                                size_t       n,
+                                int          oversampling)
+{
+    // Cutoff exponent modulated per sample (sweep release), held across
+    // the oversampled sub-samples: buf holds n * oversampling samples
+    for(size_t i = 0; i < n; i++)
+    {
+        this->SetExponent(cutoff[i]);
+        for(int j = 0; j < oversampling; j++)
+        {
+            *buf = this->Tick(*buf);
+            buf++;
+        }
+    }
+    this->cutoffHeld = false;
 }
 // Vcf functions
 
 
 // OutAmp functions
-void OutAmp::SetVolume(float volume)
+DUB_ITCM void OutAmp::SetVolume(float volume)
 {
     this->VolumeValue = volume;
 }
 
-float OutAmp::Process(float in)
+DUB_ITCM float OutAmp::Process(float in)
 {
     return in * this->VolumeValue;
 }
+
+template <typename T>
+DUB_ITCM void OutAmp::ProcessBlock(T* buf, size_t n)
+{
+    bool primed = this->volumeWatch.Primed();
+    if(this->volumeWatch.Changed(this->VolumeValue))
+    {
+        if(DUB_PARAM_SMOOTHING && primed)
+        {
+            this->volume.SetTarget(this->VolumeValue);
+        }
+        else
+        {
+            this->volume.Reset(this->VolumeValue);
+        }
+    }
+    this->volume.Apply(buf, n);
+}
+
+template void OutAmp::ProcessBlock<float>(float* buf, size_t n);
+template void OutAmp::ProcessBlock<q31_t>(q31_t* buf, size_t n);
+template void OutAmp::ProcessBlock<q15_t>(q15_t* buf, size_t n);
 // OutAmp functions
 
 
-// Debug functions
-void PrintKnobValues()
+// TapeDelay functions
+#define DELAY_MASK (DELAY_BUFFER_SIZE - 1)
+
+// 4-point cubic Hermite between x0 (t = 0) and x1 (t = 1)
+static inline float Hermite(float xm1, float x0, float x1, float x2, float t)
 {
-    // Raw input values
-    hw.Print("Volume: " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(VolumeKnob)));
-    hw.Print("   Decay:  " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(DecayKnob)));
-    hw.Print("   Depth:  " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(DepthKnob)));
-    hw.PrintLine("");
-    hw.Print("Tune:   " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(TuneKnob)));
-    hw.Print("   Sweep:  " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(SweepKnob)));
-    hw.Print("   Rate:   " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(RateKnob)));
-    hw.PrintLine("");
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    return ((c3 * t + c2) * t + c1) * t + x0;
+}
 
-    // Class attribute values
-    // hw.Print("Volume: " FLT_FMT3, FLT_VAR3(out_amp->VolumeValue));
-    // hw.Print("   Decay:  " FLT_FMT3, FLT_VAR3(envelope->ReleaseValue));
-    // hw.Print("   Depth:  " FLT_FMT3, FLT_VAR3(lfo->DepthValue));
-    // hw.PrintLine("");
-    // hw.Print("Tune:   " FLT_FMT3, FLT_VAR3(vco->TuneValue));
-    // hw.Print("   Sweep:  " FLT_FMT3, FLT_VAR3(sweep->SweepValue));
-    // hw.Print("   Rate:   " FLT_FMT3, FLT_VAR3(lfo->RateValue));
-    // hw.PrintLine("");
+void TapeDelay::Init(float* buffer)
+{
+    this->buffer = buffer;
+    this->write  = 0;
+    memset(buffer, 0, 2 * DELAY_BUFFER_SIZE * sizeof(float));
 }
 
-void PrintButtonStates()
+void TapeDelay::SetSampleRate(int sample_rate)
 {
-    for(int i = 0; i < 4; i++)
+    this->sample_rate = sample_rate;
+    this->wow_inc     = TWOPI_F * DELAY_WOW_RATE / sample_rate;
+    this->wow_depth   = DELAY_WOW_DEPTH * sample_rate;
+    this->min_delay
+        = fmaxf(DELAY_MIN_TIME * sample_rate, 2.0f + this->wow_depth);
+    this->max_delay = fminf(DELAY_MAX_TIME * sample_rate,
+                            DELAY_BUFFER_SIZE - 4 - this->wow_depth);
+
+    // One-pole coefficients of the glide and the feedback highpass
+    this->glide   = 1.0f - expf(-1.0f / (DELAY_GLIDE_TIME * sample_rate));
+    this->hp_coef = 1.0f - expf(-TWOPI_F * DELAY_LOW_CUT / sample_rate);
+    for(int c = 0; c < 2; c++)
     {
-        hw.Print("Trigger %d: %d %d %d | ",
-                 i + 1,
-                 button_handler->triggers[i].RisingEdge(),
-                 button_handler->triggers[i].Pressed(),
-                 button_handler->triggers[i].FallingEdge());
+        this->lp[c] = 0.0f;
+        this->hp[c] = 0.0f;
+    }
+
+    // Times in samples and the tone coefficient follow the new rate
+    this->timeWatch = ParameterWatch();
+    this->toneWatch = ParameterWatch();
+    this->UpdateControls();
+    this->delay = this->target; // No glide from an empty tape
+    if(this->buffer)
+    {
+        this->Init(this->buffer);
     }
-    hw.PrintLine("");
 }
 
-void PrintOutputs()
+DUB_ITCM void TapeDelay::UpdateControls()
 {
-    hw.PrintLine("ADSR: " FLT_FMT3 " | LFO: " FLT_FMT3 " " FLT_FMT3
-                 " | VCO: " FLT_FMT3,
-                 FLT_VAR3(adsr_output),
-                 FLT_VAR3(lfo_output.first),
-                 FLT_VAR3(lfo_output.first),
-                 FLT_VAR3(vco_output));
+    // A new time is reached through the glide, like a tape speed change
+    if(this->timeWatch.Changed(this->TimeValue))
+    {
+        this->target = fclamp(this->TimeValue * this->sample_rate,
+                              this->min_delay,
+                              this->max_delay);
+    }
+    if(this->toneWatch.Changed(this->ToneValue))
+    {
+        this->lp_coef
+            = 1.0f - expf(-TWOPI_F * this->ToneValue / this->sample_rate);
+    }
+    this->feedback  = fclamp(this->FeedbackValue, 0.0f, 1.0f);
+    this->mix       = this->MixValue;
+    this->ping_pong = fclamp(this->PingPongValue, 0.0f, 1.0f);
 }
-// Debug functions
 
+inline void TapeDelay::Tick(float in, float& left, float& right)
+{
+    // Tape speed: the delay glides to its target and wobbles with the wow
+    this->delay += this->glide * (this->target - this->delay);
+    this->wow_phase += this->wow_inc;
+    if(this->wow_phase >= TWOPI_F)
+    {
+        this->wow_phase -= TWOPI_F;
+    }
+    float d = this->delay + this->wow_depth * FastSin(this->wow_phase);
+
+    // Read head d samples behind the write head, between frames i0 and
+    // i0 + 1. i0 + 2 is still behind the write head since d > 2.
+    int32_t      whole = (int32_t)d;
+    float        t     = 1.0f - (d - whole);
+    uint32_t     i0    = this->write - whole - 1;
+    const float* f[4];
+    for(int k = 0; k < 4; k++)
+    {
+        f[k] = &this->buffer[2 * ((i0 + k - 1) & DELAY_MASK)];
+    }
+    float yl = Hermite(f[0][0], f[1][0], f[2][0], f[3][0], t);
+    float yr = Hermite(f[0][1], f[1][1], f[2][1], f[3][1], t);
+
+    // Feedback: darker and thinner at each repeat, saturating like tape
+    this->lp[0] += this->lp_coef * (yl - this->lp[0]);
+    this->lp[1] += this->lp_coef * (yr - this->lp[1]);
+    this->hp[0] += this->hp_coef * (this->lp[0] - this->hp[0]);
+    this->hp[1] += this->hp_coef * (this->lp[1] - this->hp[1]);
+    float fl = this->lp[0] - this->hp[0];
+    float fr = this->lp[1] - this->hp[1];
+
+    // Ping-pong: the input enters on the left and each repeat crosses over
+    float  p  = this->ping_pong;
+    float  xl = p * fr + (1.0f - p) * fl;
+    float  xr = p * fl + (1.0f - p) * fr;
+    float* w  = &this->buffer[2 * this->write];
+    w[0]      = in + SoftClip(this->feedback * xl);
+    w[1]      = (1.0f - p) * in + SoftClip(this->feedback * xr);
+    this->write = (this->write + 1) & DELAY_MASK;
+
+    left  = in + this->mix * yl;
+    right = in + this->mix * yr;
+}
 
-// Main functions
-void AudioCallback(AudioHandle::InputBuffer  in,
-                   AudioHandle::OutputBuffer out,
-                   size_t                    size)
+DUB_ITCM void TapeDelay::Process(float in, float& left, float& right)
+{
+    this->UpdateControls();
+    this->Tick(in, left, right);
+}
+
+// in may point to the same buffer as left. The read and write heads each
+// move through a contiguous run of the line, n frames per block.
+DUB_ITCM void
+TapeDelay::ProcessBlock(const float* in, float* left, float* right, size_t n)
 {
-    if(shouldApplyToggles)
+    this->UpdateControls();
+    for(size_t i = 0; i < n; i++)
     {
-        lfo->ResetPhaseAll();
+        this->Tick(in[i], left[i], right[i]);
+    }
+}
+// TapeDelay functions
 
-        button_handler->currentBankState  = button_handler->bankSelectState;
-        button_handler->sweepToTuneActive = button_handler->sweepToTuneState;
 
-        triggers->ClearTriggered();
-        shouldApplyToggles = false;
+// FdnReverb functions
+
+// Unnormalized Walsh-Hadamard transform in place. The butterflies between
+// the two halves come first, a fixed length loop the compiler vectorizes.
+template <int N>
+static inline void Hadamard(float* x)
+{
+    for(int j = 0; j < N / 2; j++)
+    {
+        float a      = x[j];
+        float b      = x[j + N / 2];
+        x[j]         = a + b;
+        x[j + N / 2] = a - b;
     }
+    Hadamard<N / 2>(x);
+    Hadamard<N / 2>(x + N / 2);
+}
 
-    for(size_t i = 0; i < size; i++)
+template <>
+inline void Hadamard<1>(float* x)
+{
+}
+
+void FdnReverb::Init(float* buffer)
+{
+    int offset = 0;
+    for(int k = 0; k < REVERB_LINES; k++)
     {
-        bool pressed = triggers->Pressed();
+        this->line[k] = buffer + offset;
+        this->pos[k]  = 0;
+        this->lp[k]   = 0.0f;
+        offset += this->length[k];
+    }
+    memset(buffer, 0, REVERB_BUFFER_SIZE * sizeof(float));
+}
 
-        // Use frozen sweep value after release
-        float sweepVal = sweep->ReleaseValue;
+void FdnReverb::SetSampleRate(int sample_rate)
+{
+    // Line lengths at 48 kHz: primes from 23 to 61 ms, a plate-like
+    // density. Scaled with the rate, within the buffer.
+#if REVERB_LINES == 8
+    static const int base[REVERB_LINES]
+        = {1117, 1361, 1597, 1889, 2129, 2389, 2621, 2909};
+#else
+    static const int base[REVERB_LINES] = {1559, 1933, 2399, 2909};
+#endif
+    int total = 0;
+    for(int k = 0; k < REVERB_LINES; k++)
+    {
+        total += base[k];
+    }
+    float scale
+        = fminf(sample_rate / 48000.0f, (float)REVERB_BUFFER_SIZE / total);
+    for(int k = 0; k < REVERB_LINES; k++)
+    {
+        this->length[k] = (int)(base[k] * scale);
+    }
+    this->sample_rate = sample_rate;
 
+    // Gains depend on the lengths, the damping on the rate
+    this->decayWatch = ParameterWatch();
+    this->dampWatch  = ParameterWatch();
+    this->UpdateControls();
+    if(this->line[0])
+    {
+        this->Init(this->line[0]); // The first line starts the buffer
+    }
+}
 
-        // Reset envelope and LFO on trigger
-        if(shouldApplyToggles)
+DUB_ITCM void FdnReverb::UpdateControls()
+{
+    if(this->decayWatch.Changed(this->DecayValue))
+    {
+        // -60 dB after DecayValue seconds whatever the line length. The
+        // 1 / sqrt(N) of the orthonormal Hadamard matrix is folded in.
+        float norm   = 1.0f / sqrtf((float)REVERB_LINES);
+        float rt60   = fmaxf(this->DecayValue, 0.1f) * this->sample_rate;
+        float energy = 0.0f;
+        for(int k = 0; k < REVERB_LINES; k++)
         {
-            lfo->ResetPhaseAll();
-
-            // Aplicar mudanças pendentes
-            button_handler->currentBankState = button_handler->bankSelectState;
-            button_handler->sweepToTuneActive
-                = button_handler->sweepToTuneState;
-            triggers->ClearTriggered();
-            shouldApplyToggles = false;
+            float g       = powf(10.0f, -3.0f * this->length[k] / rt60);
+            this->gain[k] = norm * g;
+            energy += g * g;
         }
 
-        // Set and process envelope
-        envelope->SetReleaseTime(
-            ADSR_MIN_RELEASE_TIME
-            + (envelope->ReleaseValue
-               * (ADSR_RELEASE_TIME - ADSR_MIN_RELEASE_TIME)));
-        adsr_output = envelope->Process(pressed);
+        // A longer decay stores more energy: the input is scaled so that
+        // the tail level follows MixValue rather than DecayValue
+        this->in_gain = sqrtf(1.0f - energy / REVERB_LINES);
+    }
+    if(this->dampWatch.Changed(this->DampValue))
+    {
+        this->damp_coef
+            = 1.0f - expf(-TWOPI_F * this->DampValue / this->sample_rate);
+    }
+
+    // Lines sum as uncorrelated signals on each side
+    this->mix = this->MixValue / sqrtf(REVERB_LINES / 2.0f);
+}
+
+DUB_ITCM void FdnReverb::Process(float& left, float& right)
+{
+    this->ProcessBlock(&left, &right, 1);
+}
 
-        // --- Filter frequency (VCF) logic ---
-        if(pressed)
+// The state is copied to locals for the block: the line writes could
+// alias the members and would force a reload of every one of them.
+DUB_ITCM void FdnReverb::ProcessBlock(float* left, float* right, size_t n)
+{
+    this->UpdateControls();
+
+    float* line[REVERB_LINES];
+    int    pos[REVERB_LINES];
+    float  gain[REVERB_LINES], lp[REVERB_LINES];
+    for(int k = 0; k < REVERB_LINES; k++)
+    {
+        line[k] = this->line[k];
+        pos[k]  = this->pos[k];
+        gain[k] = this->gain[k];
+        lp[k]   = this->lp[k];
+    }
+    float damp = this->damp_coef;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        float x[REVERB_LINES];
+        float wet_left  = 0.0f;
+        float wet_right = 0.0f;
+        for(int k = 0; k < REVERB_LINES; k++)
         {
-            vcf->UpdateCutoffPressed(sweepVal);
+            x[k] = line[k][pos[k]];
         }
-        else
+        for(int k = 0; k < REVERB_LINES; k += 2)
         {
-            vcf->CutoffFreq
-                = sweep->UpdateCutoffFreq(sweepVal, vcf, adsr_output);
-            vcf->SetFreq(vcf->CutoffFreq);
+            wet_left += x[k];
+            wet_right += x[k + 1];
         }
 
+        // Damping and decay
+        for(int k = 0; k < REVERB_LINES; k++)
+        {
+            lp[k] += damp * (x[k] - lp[k]);
+            x[k] = gain[k] * lp[k];
+        }
 
-        // Initial output from envelope
-        output = adsr_output;
-
-        // --- LFO processing ---
-        lfo->SetFreqAll(lfo->RateValue);
-        lfo->SetAmpAll(
-            1.0f); // LFO at full amplitude, FM ratio will scale deviation
-        lfo_output = lfo->ProcessAll();
+        Hadamard<REVERB_LINES>(x);
 
-        // --- VCO frequency and modulation with FM-inspired deviation ---
-        // Calculate base carrier frequency from tune knob
-        float carrier_freq
-            = VCO_MIN_FREQ * powf(VCO_MAX_FREQ / VCO_MIN_FREQ, vco->TuneValue);
+        float in[2] = {this->in_gain * left[i], this->in_gain * right[i]};
+        for(int k = 0; k < REVERB_LINES; k++)
+        {
+            line[k][pos[k]] = x[k] + in[k & 1];
+            if(++pos[k] == this->length[k])
+            {
+                pos[k] = 0;
+            }
+        }
 
-        // Convert LFO output from [0,1] to [-1,+1]
-        float lfo_bipolar = (lfo_output.second - 0.5f) * 2.0f;
+        left[i] += this->mix * wet_left;
+        right[i] += this->mix * wet_right;
+    }
 
-        // FM synthesis: depth controls intensity, ratio stored in VCO
-        float vco_freq
-            = vco->CalculateFMFreq(carrier_freq, lfo_bipolar, lfo->DepthValue);
+    for(int k = 0; k < REVERB_LINES; k++)
+    {
+        this->pos[k] = pos[k];
+        this->lp[k]  = lp[k];
+    }
+}
+// FdnReverb functions
 
-        // Optional sweep modulation mapped to VCO frequency
-        if(button_handler->sweepToTuneActive)
-        {
-            float direction = 2.0f * (sweepVal - 0.5f);
 
-            // Get VCO intensity using the dedicated method
-            float intensity = sweep->CalculateVcoIntensity(sweepVal);
+#ifndef DUB_HOST
+// Debug functions
+void PrintKnobValues()
+{
+    // Raw input values
+    hw.Print("Volume: " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(VolumeKnob)));
+    hw.Print("   Decay:  " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(DecayKnob)));
+    hw.Print("   Depth:  " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(DepthKnob)));
+    hw.PrintLine("");
+    hw.Print("Tune:   " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(TuneKnob)));
+    hw.Print("   Sweep:  " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(SweepKnob)));
+    hw.Print("   Rate:   " FLT_FMT3, FLT_VAR3(hw.adc.GetFloat(RateKnob)));
+    hw.PrintLine("");
 
-            float end_exp   = 0.5f - 0.5f * direction;
-            float sweep_exp = vco->TuneValue
-                              + (end_exp - vco->TuneValue)
-                                    * (1.0f - adsr_output) * intensity;
+    // Class attribute values
+    // hw.Print("Volume: " FLT_FMT3, FLT_VAR3(out_amp->VolumeValue));
+    // hw.Print("   Decay:  " FLT_FMT3, FLT_VAR3(envelope->ReleaseValue));
+    // hw.Print("   Depth:  " FLT_FMT3, FLT_VAR3(lfo->DepthValue));
+    // hw.PrintLine("");
+    // hw.Print("Tune:   " FLT_FMT3, FLT_VAR3(vco->TuneValue));
+    // hw.Print("   Sweep:  " FLT_FMT3, FLT_VAR3(sweep->SweepValue));
+    // hw.Print("   Rate:   " FLT_FMT3, FLT_VAR3(lfo->RateValue));
+    // hw.PrintLine("");
+}
 
-            // Recalculate carrier with sweep, then apply FM modulation
-            carrier_freq
-                = VCO_MIN_FREQ * powf(VCO_MAX_FREQ / VCO_MIN_FREQ, sweep_exp);
+void PrintButtonStates()
+{
+    for(int i = 0; i < NUM_TRIGGERS; i++)
+    {
+        hw.Print("Trigger %d: %d %d %d | ",
+                 i + 1,
+                 engine.buttons.triggers[i].RisingEdge(),
+                 engine.buttons.triggers[i].Pressed(),
+                 engine.buttons.triggers[i].FallingEdge());
+    }
+    hw.PrintLine("");
+}
 
-            // Recalculate with swept carrier frequency
-            vco_freq = vco->CalculateFMFreq(
-                carrier_freq, lfo_bipolar, lfo->DepthValue);
-        }
+void PrintOutputs()
+{
+    hw.PrintLine("ADSR: " FLT_FMT3 " | LFO: " FLT_FMT3 " " FLT_FMT3
+                 " | VCO: " FLT_FMT3,
+                 FLT_VAR3(engine.adsr_output),
+                 FLT_VAR3(engine.lfo_output.first),
+                 FLT_VAR3(engine.lfo_output.first),
+                 FLT_VAR3(engine.vco_output));
+}
 
+void PrintCpuLoad()
+{
+    hw.PrintLine("CPU load (%s, %d Hz, oversampling %dx, block %d): avg "
+                 FLT_FMT3 "%% max " FLT_FMT3 "%%",
+                 audio_modes[DUB_AUDIO_MODE].name,
+                 engine.sample_rate,
+                 engine.oversampling,
+                 engine.block_size,
+                 FLT_VAR3(cpu_load.GetAvgCpuLoad() * 100.0f),
+                 FLT_VAR3(cpu_load.GetMaxCpuLoad() * 100.0f));
+}
 
-        vco->SetFreq(vco_freq);
-        vco_output = vco->Process();
-        output *= vco_output;
+void PrintControlTask()
+{
+    hw.PrintLine("Control task (%d Hz): idle " FLT_FMT3 "%%, overruns %lu",
+                 CONTROL_TASK_RATE,
+                 FLT_VAR3(control_task.IdleShare() * 100.0f),
+                 control_task.Overruns());
+}
 
-        // -- LFO LED control ---
-        led_lfo.Set((lfo_output.first * 0.5f + 0.5f) * adsr_output);
+#if DUB_PROFILER
+void PrintProfile()
+{
+    static ProfileSnapshot snapshot;
+    if(!engine.profiler.Poll(snapshot) || snapshot.callbacks == 0)
+    {
+        return;
+    }
+    hw.PrintLine("Profile: %lu callbacks, budget %lu us, overruns %lu (%lu)",
+                 snapshot.callbacks,
+                 snapshot.budget / snapshot.ticks_per_us,
+                 snapshot.overruns,
+                 snapshot.total_overruns);
+    for(int i = 0; i < NUM_PROFILE_STAGES; i++)
+    {
+        const ProfileStats& st = snapshot.stages[i];
+        hw.PrintLine("  %-10s min %5lu avg %5lu max %5lu cycles",
+                     ProfileStageName(i),
+                     st.min,
+                     (uint32_t)(st.sum / snapshot.callbacks),
+                     st.max);
+    }
+}
+#endif
+// Debug functions
+#endif // DUB_HOST
 
-        led_lfo.Update();
 
-        // --- Apply VCF low-pass filter ---
-        output = vcf->Process(output);
+// Main functions
+#ifndef DUB_HOST
+DUB_ITCM void AudioCallback(AudioHandle::InputBuffer  in,
+                            AudioHandle::OutputBuffer out,
+                            size_t                    size)
+{
+    cpu_load.OnBlockStart();
+    engine.AudioCallback(in, out, size);
+    cpu_load.OnBlockEnd();
+}
 
-        // --- Apply output amplifier ---
-        output = out_amp->Process(output);
+#if DUB_MIDI || DUB_MIDI_USB
+// Receive interrupt of a MIDI transport, context is its MidiInput. The
+// timer is read here, so the time a message waits before the main loop
+// picks it up does not move it.
+static void MidiReceive(uint8_t* data, size_t size, void* context)
+{
+    static_cast<MidiInput*>(context)->Receive(data, size, System::GetUs());
+}
 
-        // --- Send to output buffer (stereo) ---
-        out[0][i] = output;
-        out[1][i] = output;
+static void PublishMidi(MidiInput& input)
+{
+    MidiMessage msg;
+    while(input.Pop(msg))
+    {
+        engine.PublishMidi(msg);
     }
 }
+#endif
 
+#ifndef DUB_NO_MAIN
 int main(void)
 {
     hw.Init();
-    hw.SetAudioBlockSize(4);
+    const AudioMode& mode = audio_modes[DUB_AUDIO_MODE];
+    hw.SetAudioBlockSize(mode.block_size);
+#if DUB_SAMPLE_RATE == 96000
+    hw.SetAudioSampleRate(SaiHandle::Config::SampleRate::SAI_96KHZ);
+#else
     hw.SetAudioSampleRate(SaiHandle::Config::SampleRate::SAI_48KHZ);
-    SAMPLE_RATE = hw.AudioSampleRate();
-    BLOCK_SIZE  = hw.AudioBlockSize();
-    led_sweep.Init(daisy::seed::D27, GPIO::Mode::OUTPUT);
-    led_bank.Init(daisy::seed::D28, GPIO::Mode::OUTPUT);
-    led_lfo.Init(daisy::seed::D29, false, SAMPLE_RATE);
-    knob_handler->InitAll();
-    button_handler->InitAll();
-    InitComponents(SAMPLE_RATE, BLOCK_SIZE);
-
-    if(DEBUG)
+#endif
+    engine.Init(hw.AudioSampleRate(),
+                hw.AudioBlockSize(),
+                DUB_OVERSAMPLING,
+                mode.control_interval);
+    engine.InitHardware();
+    cpu_load.Init(engine.sample_rate, engine.block_size);
+
+#if DUB_MIDI
+    MidiUartTransport::Config midi_trs_config;
+    midi_trs.Init(midi_trs_config);
+    midi_trs.StartRx(MidiReceive, &midi_trs_input);
+#endif
+#if DUB_MIDI_USB
+    MidiUsbTransport::Config midi_usb_config;
+    midi_usb.Init(midi_usb_config);
+    midi_usb.StartRx(MidiReceive, &midi_usb_input);
+#endif
+
+    if(DEBUG && !DUB_MIDI_USB) // The log needs the USB port
     {
         hw.StartLog(true);
         hw.PrintLine("Daisy Dub Siren");
@@ -752,22 +1670,39 @@ int main(void)
 
     hw.StartAudio(AudioCallback);
 
+    control_task.Init(CONTROL_TASK_RATE);
+    uint32_t print_ticks = 0;
     while(1)
     {
-        knob_handler->UpdateAll();
-        button_handler->DebounceAll();
-        button_handler->UpdateAll();
-        led_sweep.Write(button_handler->sweepToTuneState);
-        led_bank.Write(button_handler->bankSelectState);
-
-        if(triggers->Triggered())
+        uint32_t due = control_task.Wait();
+
+        // Every wake up may be a receive interrupt: the messages go out
+        // at once, their timestamps were taken on arrival
+#if DUB_MIDI
+        PublishMidi(midi_trs_input);
+#endif
+#if DUB_MIDI_USB
+        PublishMidi(midi_usb_input);
+#endif
+        if(due == 0)
         {
-            shouldApplyToggles = true;
+            continue; // Audio or another interrupt, no control tick
         }
 
-        if(DEBUG)
+        engine.ScanControls();
+        engine.PublishControls(engine.ControlTimestamp());
+
+        print_ticks += due;
+        if(DEBUG && print_ticks >= CONTROL_TASK_RATE)
         {
-            System::Delay(10);
+            print_ticks = 0;
+            PrintCpuLoad();
+            PrintControlTask();
+#if DUB_PROFILER
+            PrintProfile();
+#endif
         }
     }
 }
+#endif // DUB_NO_MAIN
+#endif // DUB_HOST
@@ -1,7 +1,21 @@
 #pragma once
 
+#ifdef DUB_HOST
+#include "daisy_host.h"
+#else
 #include "daisy_seed.h"
+#endif
 #include "daisysp.h"
+#include "fastmath.h"
+#include "fixed.h"
+#include "decimator.h"
+#include "midi.h"
+#include "placement.h"
+#include "profiler.h"
+#include "simd.h"
+#include "spsc_queue.h"
+#include "wavetable.h"
+#include "zdf_filter.h"
 
 using namespace daisy;
 using namespace daisysp;
@@ -10,26 +24,210 @@ using namespace daisysp;
 #define VCO_WAVEFORM Oscillator::WAVE_POLYBLEP_SQUARE
 #define VCO_MIN_FREQ 32.703f // Corresponds to a midi C1
 #define VCO_MAX_FREQ 1046.5f // Corresponds to a midi C6
+#define VCO_OCTAVES 5.0000055f // log2(VCO_MAX_FREQ / VCO_MIN_FREQ)
+
+// VCO engine
+// 0 = DaisySP Oscillator, PolyBLEP band limiting (VCO_WAVEFORM)
+// 1 = mip-mapped wavetables, fixed cost per sample (VCO_WAVETABLE_SHAPE)
+#ifndef DUB_VCO_WAVETABLE
+#define DUB_VCO_WAVETABLE 0
+#endif
+#define VCO_WAVETABLE_SHAPE WAVETABLE_SQUARE
+#define VCO_WAVETABLE_AMP 0.707f // Level of the PolyBLEP square
 
 #define ADSR_ATTACK_TIME 0.3f
 #define ADSR_DECAY_TIME 0.1f
 #define ADSR_SUSTAIN_LEVEL 1.f
 #define ADSR_RELEASE_TIME 15.f
 #define ADSR_MIN_RELEASE_TIME 0.1f
+// The envelopes were tuned with Adsr::Init(sample_rate, 4), the Seed block
+// size, while Process runs every sample: every ADSR time above plays 4x
+// faster than written. The factor is fixed so the sound does not follow
+// the block size of the audio mode.
+#define ADSR_TIME_SCALE 4
 
-#define LFO_0_WAVEFORM Oscillator::WAVE_SIN
-#define LFO_1_WAVEFORM Oscillator::WAVE_SQUARE
-#define LFO_2_WAVEFORM Oscillator::WAVE_SAW
-#define LFO_3_WAVEFORM Oscillator::WAVE_RAMP
 #define LFO_MIN_FREQ 0.0f
 #define LFO_MAX_FREQ 20.0f
 #define LFO_FM_INDEX 1.0f
+#define LFO_FADE_TIME 0.1f // Crossfade between the LFOs of two triggers
 
 #define VCF_FILTER OnePole::FILTER_MODE_LOW_PASS
 #define VCF_MIN_FREQ 15.0f
 #define VCF_MAX_FREQ 15000.0f
+#define VCF_OCTAVES 9.9657843f // log2(VCF_MAX_FREQ / VCF_MIN_FREQ)
+#define VCF_RESONANCE 0.95f    // Svf::SetRes
+#define VCF_DRIVE 100.0f       // Svf::SetDrive
+
+// VCF engine
+// 0 = DaisySP Svf, coefficients from sinf and powf at every cutoff change
+// 1 = ZdfSvf (zdf_filter.h), coefficients from a table of the exponent
+#ifndef DUB_VCF_ZDF
+#define DUB_VCF_ZDF 1
+#endif
+
+// Tape delay after the out amp: mono in, stereo ping-pong echo out
+// 0 = dry mono output on both channels
+#ifndef DUB_DELAY
+#define DUB_DELAY 1
+#endif
+#define DELAY_BUFFER_SIZE 524288 // Frames, a power of two (5.4 s at 96 kHz)
+#define DELAY_MIN_TIME 0.01f
+#define DELAY_MAX_TIME 4.0f     // Less at rates where the buffer is shorter
+#define DELAY_TIME 0.375f       // Dotted eighth at 120 BPM
+#define DELAY_FEEDBACK 0.55f    // Gain of each repeat
+#define DELAY_MIX 0.35f         // Echo level added to the dry signal
+#define DELAY_PING_PONG 1.0f    // 0 = echoes on both sides, 1 = alternating
+#define DELAY_TONE 2500.0f      // Feedback lowpass, darker at each repeat
+#define DELAY_LOW_CUT 100.0f    // Feedback highpass, no low end build-up
+#define DELAY_GLIDE_TIME 0.1f   // Time changes bend the pitch like tape
+#define DELAY_WOW_RATE 0.6f     // Tape speed wobble
+#define DELAY_WOW_DEPTH 0.0008f // Seconds of delay modulation
+
+// Feedback delay network reverb after the tape delay, stereo in and out
+// 0 = no reverb
+#ifndef DUB_REVERB
+#define DUB_REVERB 1
+#endif
+#ifndef REVERB_LINES
+#define REVERB_LINES 8 // 4 or 8 delay lines
+#endif
+#define REVERB_BUFFER_SIZE 36864 // Floats shared by the lines, 96 kHz max
+#define REVERB_DECAY 2.5f        // RT60 in seconds
+#define REVERB_DAMPING 4000.0f   // Hz, higher frequencies decay faster
+#define REVERB_MIX 0.1f          // Tail level added to the dry signal
+
+// Block processing
+// 1 = AudioCallback runs each stage as a loop over the whole block
+// 0 = legacy per-sample path (kept for reference and comparison)
+#ifndef DUB_BLOCK_PROCESSING
+#define DUB_BLOCK_PROCESSING 1
+#endif
+#define MAX_BLOCK_SIZE 256 // Larger callbacks are processed in chunks
+#define CONTROL_QUEUE_SIZE 64 // Control frames in flight to the callback
+
+// Audio operating mode of the Seed (audio_modes below)
+// DUB_MODE_LOW_LATENCY = small blocks, shortest trigger to sound latency
+// DUB_MODE_BALANCED    = medium blocks, room for the effects
+// DUB_MODE_HEAVY_FX    = large blocks, least callback overhead
+#define DUB_MODE_LOW_LATENCY 0
+#define DUB_MODE_BALANCED 1
+#define DUB_MODE_HEAVY_FX 2
+#define NUM_AUDIO_MODES 3
+#ifndef DUB_AUDIO_MODE
+#define DUB_AUDIO_MODE DUB_MODE_LOW_LATENCY
+#endif
+
+// Output sample rate of the Seed, 48000 or 96000. At 96 kHz the FM folding
+// and the resonant filter alias less, at twice the CPU cost.
+#ifndef DUB_SAMPLE_RATE
+#define DUB_SAMPLE_RATE 48000
+#endif
+
+// Control task (ControlTask): a hardware timer ticks CONTROL_TASK_RATE
+// times a second and the main loop runs one control pass per tick (knob
+// scan, button debounce, toggle LEDs, control frame), sleeping in WFI in
+// between. MIDI messages are published at every wake up.
+#define CONTROL_TASK_RATE 1000 // Hz
+
+// Knob acquisition: the ADC averages KNOB_ADC_OVERSAMPLING conversions in
+// hardware, the control task scans every KNOB_SCAN_PERIOD_US and each
+// channel goes through a one-pole smoother and a dead band (KnobFilter)
+#define KNOB_ADC_OVERSAMPLING AdcHandle::OVS_64
+#define KNOB_SCAN_PERIOD_US (1000000 / CONTROL_TASK_RATE) // One per tick
+#define KNOB_SMOOTHING 0.1f      // One-pole coefficient per scan, 10 ms
+#define KNOB_HYSTERESIS 0.004f   // Dead band, 1/250 of the travel
+
+// Triggers
+#define NUM_TRIGGERS 4  // Trigger buttons on the panel, one LFO voice each
+#define MAX_TRIGGERS 32 // Trigger inputs in total (expander, MIDI notes)
+
+// MIDI input (MidiInput): TRS MIDI on the UART of pins D13/D14, and with
+// DUB_MIDI_USB the USB port of the Seed, which then no longer carries the
+// DEBUG log
+#ifndef DUB_MIDI
+#define DUB_MIDI 1
+#endif
+#ifndef DUB_MIDI_USB
+#define DUB_MIDI_USB 0
+#endif
+#define MIDI_CHANNEL 0       // 1-16, 0 = omni
+#define MIDI_TRIGGER_NOTE 36 // C1, the note of trigger 1, the next 3 follow
+#define MIDI_TRIGGER_INPUT (MAX_TRIGGERS - NUM_TRIGGERS) // Input of C1
+#define MIDI_QUEUE_SIZE 64 // Messages in flight from the receive interrupt
+
+// Oversampling of the VCO, envelope VCA and VCF section (block path only)
+// 1 = off, 2 or 4 = that section runs at 2x or 4x the sample rate and a
+// half-band decimator (decimator.h) brings it back to the output rate
+#ifndef DUB_OVERSAMPLING
+#define DUB_OVERSAMPLING 1
+#endif
+#define MAX_OVERSAMPLING 4
+
+// Half-band stages, transition bands as a fraction of the stage input
+// rate. At 48 kHz both pass 0-20 kHz; the 2x to 1x stage rejects from
+// 28 kHz, the 4x to 2x stage from 76 kHz, each by about 95 dB.
+#define DECIMATOR_COEFS 6
+#define DECIMATOR_TRANSITION 0.0833
+#define DECIMATOR_4X_COEFS 3
+#define DECIMATOR_4X_TRANSITION 0.292
+#if DUB_OVERSAMPLING > 1 && !DUB_BLOCK_PROCESSING
+#error "DUB_OVERSAMPLING needs DUB_BLOCK_PROCESSING"
+#endif
+
+// 1 = exponential mappings use FastExp2 instead of powf (fastmath.h)
+#ifndef DUB_FAST_MATH
+#define DUB_FAST_MATH 1
+#endif
 
-DaisySeed hw;
+// 1 = knob driven gains and pitch ramp linearly across the block
+#ifndef DUB_PARAM_SMOOTHING
+#define DUB_PARAM_SMOOTHING 1
+#endif
+
+// 1 = sweep pitch trajectories, and cutoff ones with the Svf VCF engine,
+// follow ExpRamp, a multiply per sample, instead of the exponential
+// mapping of every sample
+#ifndef DUB_SWEEP_RAMP
+#define DUB_SWEEP_RAMP 1
+#endif
+#define SWEEP_RAMP_CENTS 0.5f      // Bend from the line that forces an anchor
+#define SWEEP_RAMP_MAX_RUN 256     // Samples between anchors at most
+#define SWEEP_RAMP_TOLERANCE 0.65f // Cents, guaranteed: bend plus drift
+
+// Sample format from the envelope VCA to the output (fixed.h):
+// DUB_SAMPLE_FLOAT, DUB_SAMPLE_Q31 or DUB_SAMPLE_Q15. The ZdfSvf VCF runs
+// in the format; the VCO and the oversampled section stay float, the fixed
+// point formats convert at their boundaries. Fixed point needs the block
+// path.
+#ifndef DUB_SAMPLE_FORMAT
+#define DUB_SAMPLE_FORMAT DUB_SAMPLE_FLOAT
+#endif
+#if DUB_SAMPLE_FORMAT == DUB_SAMPLE_Q31
+typedef q31_t sample_t;
+#elif DUB_SAMPLE_FORMAT == DUB_SAMPLE_Q15
+typedef q15_t sample_t;
+#else
+typedef float sample_t;
+#endif
+#if DUB_SAMPLE_FORMAT != DUB_SAMPLE_FLOAT && !DUB_BLOCK_PROCESSING
+#error "Fixed point DUB_SAMPLE_FORMAT needs DUB_BLOCK_PROCESSING"
+#endif
+
+// 1 = time every stage of the audio callback (profiler.h)
+#ifndef DUB_PROFILER
+#define DUB_PROFILER 0
+#endif
+
+#ifndef DUB_HOST
+extern DaisySeed hw;
+extern float     delay_buffer[2 * DELAY_BUFFER_SIZE]; // SDRAM, TapeDelay
+extern float     reverb_buffer[REVERB_BUFFER_SIZE];   // SRAM, FdnReverb
+#endif
+
+#if DUB_PROFILER
+// Starts the tick counter of the platform and sets up a profiler for it
+void InitProfiler(Profiler& profiler, int sample_rate);
+#endif
 
 // Daisy setup
 enum AdcChannel
@@ -43,80 +241,432 @@ enum AdcChannel
     NUM_ADC_CHANNELS
 };
 
+// Exponential mappings
+// Exponent from 0.0f to 1.0f to frequency, one octave per 1 / OCTAVES
+inline float VcoExpToFreq(float exponent)
+{
+#if DUB_FAST_MATH
+    return VCO_MIN_FREQ * FastExp2(exponent * VCO_OCTAVES);
+#else
+    return VCO_MIN_FREQ * powf(VCO_MAX_FREQ / VCO_MIN_FREQ, exponent);
+#endif
+}
+
+inline float VcfExpToFreq(float exponent)
+{
+#if DUB_FAST_MATH
+    return VCF_MIN_FREQ * FastExp2(exponent * VCF_OCTAVES);
+#else
+    return VCF_MIN_FREQ * powf(VCF_MAX_FREQ / VCF_MIN_FREQ, exponent);
+#endif
+}
+
+// Trajectory map(exponent) of a sweep, where map is one of the mappings
+// above. While the exponent moves along a straight line the frequency is
+// a geometric series, one multiply per sample. The mapping is evaluated
+// again (an anchor) when the exponent bends away from the line by more
+// than SWEEP_RAMP_CENTS, and every SWEEP_RAMP_MAX_RUN samples against
+// rounding drift: the result stays within SWEEP_RAMP_TOLERANCE of
+// map(exponent). It only depends on past samples, so the block and the
+// per-sample paths give the same output.
+class ExpRamp
+{
+  public:
+    typedef float (*ExpMap)(float exponent);
+
+    ExpRamp(ExpMap map, float octaves)
+    {
+        this->map       = map;
+        this->octaves   = octaves;
+        this->tolerance = SWEEP_RAMP_CENTS / (1200.0f * octaves);
+        this->line      = 0.0f;
+        this->step      = 0.0f;
+        this->prev      = 0.0f;
+        this->freq      = 0.0f;
+        this->ratio     = 1.0f;
+        this->Reset();
+    }
+
+    // The next sample anchors without a slope
+    void Reset()
+    {
+        this->run    = 0;
+        this->primed = false;
+    }
+
+    float Process(float exponent)
+    {
+#if DUB_SWEEP_RAMP
+        this->line += this->step;
+        this->freq *= this->ratio;
+        if(--this->run <= 0 || fabsf(exponent - this->line) > this->tolerance)
+        {
+            this->Anchor(exponent);
+        }
+        this->prev = exponent;
+        return this->freq;
+#else
+        return this->map(exponent);
+#endif
+    }
+
+  private:
+    void Anchor(float exponent);
+
+    ExpMap map;
+    float  octaves;
+    float  tolerance; // SWEEP_RAMP_CENTS as an exponent
+    float  line;      // Exponent the ramp is at
+    float  step;      // Exponent change per sample
+    float  prev;      // Exponent of the previous sample
+    float  freq;      // map(line)
+    float  ratio;     // Frequency change per sample, 2^(octaves * step)
+    int    run;       // Samples left before the next anchor
+    bool   primed;    // prev holds a sample since the last Reset
+};
+// Exponential mappings
+
+
+// Parameter
+// Knob value written by the main loop and read by the audio callback.
+// Every write that changes the value bumps the version, so consumers can
+// recompute coefficients once per change instead of once per sample.
+class Parameter
+{
+  public:
+    Parameter()
+    {
+        this->value   = 0.0f;
+        this->version = 0;
+    }
+
+    Parameter& operator=(float v)
+    {
+        if(v != this->value)
+        {
+            this->value = v;
+            this->version++;
+        }
+        return *this;
+    }
+
+    operator float() const { return this->value; }
+    uint32_t Version() const { return this->version; }
+
+  private:
+    float    value;
+    uint32_t version;
+};
+
+// Remembers the last Parameter version a consumer acted on
+class ParameterWatch
+{
+  public:
+    ParameterWatch() { this->seen = 0xffffffff; }
+
+    // True on the first call and whenever the parameter changed since
+    bool Changed(const Parameter& param)
+    {
+        if(param.Version() == this->seen)
+        {
+            return false;
+        }
+        this->seen = param.Version();
+        return true;
+    }
+
+    bool Primed() const { return this->seen != 0xffffffff; }
+
+  private:
+    uint32_t seen;
+};
+
+// Linear ramp from the previous control value to the new one over a block
+class LinearSmoother
+{
+  public:
+    LinearSmoother()
+    {
+        this->current = 0.0f;
+        this->target  = 0.0f;
+    }
+
+    void  Reset(float value) { this->current = this->target = value; }
+    void  SetTarget(float value) { this->target = value; }
+    float Value() const { return this->current; }
+
+    void Process(float* buf, size_t n)
+    {
+        float step = (this->target - this->current) / n;
+        for(size_t i = 0; i < n; i++)
+        {
+            buf[i] = this->current + step * (i + 1);
+        }
+        this->current = this->target;
+    }
+
+    // Multiplies buf by the ramp, for gains
+    template <typename T>
+    void Apply(T* buf, size_t n)
+    {
+        float step = (this->target - this->current) / n;
+        for(size_t i = 0; i < n; i++)
+        {
+            T gain = Sample<T>::Gain(this->current + step * (i + 1));
+            buf[i] = Sample<T>::Mul(buf[i], gain);
+        }
+        this->current = this->target;
+    }
+
+  private:
+    float current;
+    float target;
+};
+// Parameter
+
+
 // DecayEnvelope
 class DecayEnvelope
 {
   public:
-    DecayEnvelope(int sample_rate, int block_size)
+    DecayEnvelope(int sample_rate)
     {
-        this->envelope.Init(sample_rate, block_size);
-        this->envelope.SetTime(ADSR_SEG_ATTACK, ADSR_ATTACK_TIME);
-        this->envelope.SetTime(ADSR_SEG_DECAY, ADSR_DECAY_TIME);
-        this->envelope.SetTime(ADSR_SEG_RELEASE, ADSR_RELEASE_TIME);
-        this->envelope.SetSustainLevel(ADSR_SUSTAIN_LEVEL);
+        this->SetSampleRate(sample_rate);
+        this->ReleaseValue  = 0.0f;
+        this->EnvelopeValue = 0.0f;
     }
 
-    Adsr  envelope;
-    float ReleaseValue;  // Knob value from 0.0f to 1.0f
-    float EnvelopeValue; // Current envelope value from 0.0f to 1.0f
+    Adsr      envelope;
+    Parameter ReleaseValue;  // Knob value from 0.0f to 1.0f
+    float     EnvelopeValue; // Current envelope value from 0.0f to 1.0f
 
+    // Restarts the envelope with its times at the new rate
+    void  SetSampleRate(int sample_rate);
     void  SetReleaseTime(float time);
+    void  UpdateControls();
     float Process(bool gate);
+    void  ProcessBlock(float* buf, size_t n, bool gate);
+
+  private:
+    ParameterWatch releaseWatch;
 };
 // DecayEnvelope
 
 
+// Trigger state, bit i stands for trigger input i
+typedef uint32_t TriggerMask;
+
+// Last note priority stack of the held triggers. Fixed capacity, each
+// trigger is in the stack at most once, so it can never overflow.
+class TriggerStack
+{
+  public:
+    TriggerStack() { this->count = 0; }
+
+    // Moves the trigger to the top, whether it was already held or not
+    void Push(int index)
+    {
+        this->Remove(index);
+        this->slots[this->count++] = (int8_t)index;
+    }
+
+    void Remove(int index)
+    {
+        int j = 0;
+        for(int i = 0; i < this->count; i++)
+        {
+            if(this->slots[i] != index)
+            {
+                this->slots[j++] = this->slots[i];
+            }
+        }
+        this->count = j;
+    }
+
+    bool Empty() const { return this->count == 0; }
+    int  Top() const { return this->slots[this->count - 1]; }
+
+  private:
+    int8_t slots[MAX_TRIGGERS];
+    int    count;
+};
+
+
+// Audio modes
+// Block size of the callback and the matching control rate. Knob frames
+// are published and the control-rate coefficients recomputed at most
+// every control_interval samples; trigger edges stay sample accurate.
+// Larger blocks keep the control interval shorter than the block, so the
+// knobs do not step at the callback rate.
+struct AudioMode
+{
+    const char* name;
+    int         block_size;
+    int         control_interval;
+};
+
+static const AudioMode audio_modes[NUM_AUDIO_MODES] = {
+    {"low latency", 4, 4},
+    {"balanced", 32, 16},
+    {"heavy fx", 128, 32},
+};
+// Audio modes
+
+
+// Control frames
+// Complete snapshot of the controls, published by the main loop and applied
+// by the audio callback at the sample given by timestamp.
+struct ControlFrame
+{
+    uint32_t    timestamp; // Audio sample clock at which the frame applies
+    float       knobs[NUM_ADC_CHANNELS]; // KnobHandler::Values, 0.0f to 1.0f
+    TriggerMask held;    // Bit i set while trigger i is held
+    TriggerMask rising;  // Triggers pressed since the previous frame
+    TriggerMask falling; // Triggers released since the previous frame
+    int8_t      lastIndex;
+    bool        bankSelect;  // Pending toggle, applied on the next trigger
+    bool        sweepToTune; // Pending toggle, applied on the next trigger
+};
+
+// Sample clock advanced by the audio callback. The main loop reads it to
+// timestamp control frames; a sequence count makes the sample/time pair
+// consistent without the callback ever waiting.
+class AudioClock
+{
+  public:
+    AudioClock() { this->Reset(); }
+
+    void Reset()
+    {
+        this->sequence.store(0, std::memory_order_relaxed);
+        this->samples.store(0, std::memory_order_relaxed);
+        this->micros.store(0, std::memory_order_relaxed);
+    }
+
+    // Audio side, at the start of each callback
+    void Mark(uint32_t block_start, uint32_t now_us)
+    {
+        uint32_t seq = this->sequence.load(std::memory_order_relaxed);
+        this->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        this->samples.store(block_start, std::memory_order_relaxed);
+        this->micros.store(now_us, std::memory_order_relaxed);
+        this->sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Control side, retries if the callback interrupted the read
+    uint32_t Read(uint32_t& at_us) const
+    {
+        uint32_t seq, block_start;
+        do
+        {
+            seq         = this->sequence.load(std::memory_order_acquire);
+            block_start = this->samples.load(std::memory_order_relaxed);
+            at_us       = this->micros.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while((seq & 1)
+                || seq != this->sequence.load(std::memory_order_relaxed));
+        return block_start;
+    }
+
+  private:
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> samples;
+    std::atomic<uint32_t> micros;
+};
+// Control frames
+
+
 // Triggers
+// Audio side trigger and toggle state, updated from control frames.
+// Each query is a single mask test, whatever the number of triggers.
 class Triggers
 {
   public:
-    Triggers() {}
+    Triggers()
+    {
+        this->triggered           = 0;
+        this->pressed             = 0;
+        this->released            = 0;
+        this->LastIndex           = 0;
+        this->IsSweepToTuneActive = false;
+        this->pendingBankSelect   = false;
+        this->pendingSweepToTune  = false;
+    }
 
-    bool Triggered();
-    bool Pressed();
-    bool Released();
-    void ClearTriggered();
+    bool Triggered() const { return this->triggered != 0; }
+    bool Pressed() const { return this->pressed != 0; }
+    bool Released() const { return this->released != 0; }
+    bool Pressed(int index) const { return (this->pressed >> index) & 1; }
+    void Update(const ControlFrame& frame);
+    void ApplyToggles();
     bool IsBankSelectActive = false;
+    bool IsSweepToTuneActive;
+    int  LastIndex;
+
+  private:
+    TriggerMask triggered;
+    TriggerMask pressed;
+    TriggerMask released;
+    bool        pendingBankSelect;
+    bool        pendingSweepToTune;
 };
 // Triggers
 
 
 // Lfo
+struct LfoWeights; // Shapes and mix of the voices of a bank, dub.cpp
+
+// One voice per trigger, each a base oscillator and a harmonic one that
+// bank B mixes in. The eight oscillators are phase accumulators in two
+// 4-lane vectors (simd.h), lane i the voice of trigger i. Every lane
+// evaluates all the shapes and keeps its own through per-lane weights
+// (LfoWeights), and the bank mix and the crossfade between two voices are
+// weights too, so a sample has no branch on the shapes or the voices. As
+// with the oscillators of each voice before, only the lanes that are
+// heard advance their phase: the voices that fade in or out, and the
+// harmonics only in bank B. Without a vector unit (DUB_SIMD_SCALAR, the
+// Seed) only those lanes are computed, each with its own shape alone.
 class Lfo
 {
   public:
     Lfo(int sample_rate)
     {
-        for(int i = 0; i < 4; i++)
-        {
-            osc[i].Init(sample_rate);
-            osc[i].SetWaveform(Oscillator::WAVE_SIN);
-            osc_harm[i].Init(sample_rate);
-            osc_harm[i].SetWaveform(Oscillator::WAVE_SIN);
-        }
         this->prevIndex    = -1;
         this->currIndex    = -1;
-        this->fadeProgress = 1.0f;                        // 1.0 significa fim
-        this->fadeRate     = 1.0f / (sample_rate * 0.1f); // 100ms fade
+        this->fadeProgress = 1.0f; // 1.0 significa fim
+        this->DepthValue   = 0.0f;
+        this->RateValue    = 0.0f;
+        this->SetSampleRate(sample_rate);
     }
 
 
-    float                   DepthValue; // Vibrato intensity/amount (0-1)
-    float                   RateValue;
-    Oscillator              osc[4];
-    Oscillator              osc_harm[4];
-    float                   values[5][2]; // oscillator value and modsig value
+    Parameter               DepthValue; // Vibrato intensity/amount (0-1)
+    Parameter               RateValue;
     int                     prevIndex;
     int                     currIndex;
     float                   fadeProgress;
     float                   fadeRate;
-    void                    Init();
-    void                    UpdateWaveforms(int index, bool bankB);
-    float                   MixLfoSignals(int index, bool bankB);
-    void                    SetAmpAll(float amp);
+    void                    SetSampleRate(int sample_rate);
     void                    SetFreqAll(float freq);
     void                    ResetPhaseAll();
-    std::pair<float, float> ProcessAll();
+    void                    UpdateControls();
+    std::pair<float, float> ProcessAll(const Triggers& triggers);
+    void ProcessBlock(float* buf, size_t n, const Triggers& triggers);
+
+  private:
+    // Starts the crossfade when the trigger of the voice changed
+    void SelectVoice(const Triggers& triggers);
+    // Bipolar output of one sample, the crossfade moved on by a step. The
+    // phases are passed in, so that a block keeps them in registers.
+    // Without Harmonics (bank A) the harmonic lanes are left out.
+    template <bool Harmonics>
+    float Process(const LfoWeights& weights, Vec4& phase, Vec4& harm_phase);
+
+    Vec4           phase, harm_phase; // Turns, 0 to 1
+    Vec4           inc, harm_inc;     // Turns per sample
+    float          sr_recip;
+    ParameterWatch rateWatch;
 }; // Lfo
 
 
@@ -124,26 +674,38 @@ class Lfo
 class Vco
 {
   public:
-    Vco(int sample_rate)
+    // The oscillator runs at sample_rate * oversampling, the FM folding
+    // stays at the Nyquist limit of the output rate
+    Vco(int sample_rate, int oversampling)
     {
-        this->osc.Init(sample_rate);
-        this->osc.SetWaveform(VCO_WAVEFORM);
-        this->osc.SetAmp(1.0f);
-        this->osc.SetFreq(440.0f);
-        this->nyquist_limit
-            = sample_rate
-              / 2.0f;          // Safe Nyquist limit for the frequency folding
-        this->fm_ratio = 1.0f; // FM C:M ratio (smaller = wider modulation)
+        this->SetSampleRate(sample_rate, oversampling);
+        this->fm_ratio  = 1.0f; // FM C:M ratio (smaller = wider modulation)
+        this->TuneValue = 0.0f;
     }
 
+#if DUB_VCO_WAVETABLE
+    WavetableOscillator osc;
+#else
     Oscillator osc;
-    float      TuneValue;
+#endif
+    Parameter  TuneValue;
     float      nyquist_limit;
     float      fm_ratio;
 
+    // Restarts the oscillator, the FM folds at the new Nyquist limit
+    void  SetSampleRate(int sample_rate, int oversampling);
     void  SetFreq(float freq);
+    void  UpdateControls();
+    void  CarrierBlock(float* buf, size_t n);
     float Process();
+    void  ProcessBlock(float* buf, size_t n);
     float CalculateFMFreq(float carrier_freq, float lfo_bipolar, float depth);
+    void
+    CalculateFMFreqBlock(float* buf, const float* lfo, size_t n, float depth);
+
+  private:
+    ParameterWatch tuneWatch;
+    LinearSmoother carrier;
 };
 // Vco
 
@@ -152,22 +714,51 @@ class Vco
 class Vcf
 {
   public:
-    Vcf(int sample_rate)
+    Vcf(int sample_rate, int oversampling)
+#if !DUB_VCF_ZDF
+    : cutoff_ramp(VcfExpToFreq, VCF_OCTAVES)
+#endif
     {
-        this->filter.Init(sample_rate);
-        this->filter.SetDrive(100.0f);
-        this->filter.SetRes(0.95f);
-        this->CutoffFreq = VCF_MIN_FREQ;
+        this->CutoffExponent = 0.0f;
+        this->exponent       = 0.0f;
+        this->SetSampleRate(sample_rate, oversampling);
     }
 
+#if DUB_VCF_ZDF
+    ZdfSvf filter;
+#else
     Svf filter;
+#endif
     //OnePole filter;
-    float CutoffFreq;
-    float CutoffExponent;
+    float CutoffExponent; // Cutoff of the sweep knob, from 0.0f to 1.0f
 
-    void  SetFreq(float freq);
+    // Restarts the filter at the new rate, keeping the cutoff
+    void  SetSampleRate(int sample_rate, int oversampling);
+    // Cutoff at VcfExpToFreq(exponent), cheap enough for every sample: a
+    // table lookup (ZdfSvf) or a step of ExpRamp (Svf)
+    void  SetExponent(float exponent);
     void  UpdateCutoffPressed(float sweepValue);
+    void  UpdateCutoffPressedBlock(const Parameter& sweepValue);
     float Process(float in);
+    template <typename T>
+    void ProcessBlock(T* buf, size_t n);
+    template <typename T>
+    void ProcessBlock(T* buf, const float* cutoff, size_t n);
+    void
+    ProcessBlock(float* buf, const float* cutoff, size_t n, int oversampling);
+
+  private:
+    template <typename T>
+    T Tick(T in);
+#if !DUB_VCF_ZDF
+    void SetFreq(float freq);
+
+    ExpRamp cutoff_ramp; // Sweep cutoff, within SWEEP_RAMP_TOLERANCE
+#endif
+    ParameterWatch sweepWatch;
+    float          exponent;   // Cutoff in use
+    bool           cutoffHeld; // Cutoff is the knob value, not a sweep
+    int            max_freq;   // Highest cutoff, a quarter of the output rate
 };
 // Vcf
 
@@ -176,29 +767,46 @@ class Vcf
 class Sweep
 {
   public:
-    Sweep(int sample_rate, int block_size)
+    Sweep(int sample_rate) : pitch_ramp(VcoExpToFreq, VCO_OCTAVES)
     {
         this->SweepValue          = 0.0f;
         this->IsSweepToTuneActive = false;
-        this->envelope.Init(sample_rate, block_size);
-        this->envelope.SetTime(ADSR_SEG_ATTACK, ADSR_ATTACK_TIME);
-        this->envelope.SetTime(ADSR_SEG_DECAY, ADSR_DECAY_TIME);
-        this->envelope.SetTime(ADSR_SEG_RELEASE, ADSR_RELEASE_TIME);
-        this->envelope.SetSustainLevel(ADSR_SUSTAIN_LEVEL);
+        this->SetSampleRate(sample_rate);
+        this->ReleaseValue  = 0.5f; // Center of the dead zone, no sweep
+        this->EnvelopeValue = 0.0f;
     }
 
     float SweepValue; // Knob value from 0.0f to 1.0f
     bool  IsSweepToTuneActive;
 
-    Adsr  envelope;
-    float ReleaseValue;  // Knob value from 0.0f to 1.0f
-    float EnvelopeValue; // Current envelope value from 0.0f to 1.0f
+    Adsr      envelope;
+    Parameter ReleaseValue;  // Knob value from 0.0f to 1.0f
+    float     EnvelopeValue; // Current envelope value from 0.0f to 1.0f
 
+    // Restarts the envelope with its times at the new rate
+    void  SetSampleRate(int sample_rate);
     void  SetReleaseTime(float time);
     float Process(bool gate);
     float CalculateFilterIntensity(float sweepValue);
     float CalculateVcoIntensity(float sweepValue);
-    float UpdateCutoffFreq(float sweepValue, Vcf* vcf, float adsrOutput);
+    // Cutoff exponents of the sweep, for Vcf::SetExponent
+    float UpdateCutoffExp(float sweepValue, Vcf* vcf, float adsrOutput);
+    void  UpdateCutoffExpBlock(float*       buf,
+                               const float* adsr,
+                               size_t       n,
+                               float        sweepValue,
+                               Vcf*         vcf);
+    float UpdateVcoFreq(float sweepValue, float tuneValue, float adsrOutput);
+    void  UpdateVcoFreqBlock(float*       buf,
+                             const float* adsr,
+                             size_t       n,
+                             float        sweepValue,
+                             float        tuneValue);
+
+  private:
+    // Carrier trajectory, within SWEEP_RAMP_TOLERANCE of VcoExpToFreq of
+    // the sweep exponent
+    ExpRamp pitch_ramp;
 };
 // Sweep
 
@@ -209,84 +817,393 @@ class OutAmp
   public:
     OutAmp() { this->VolumeValue = 0.0f; }
 
-    float VolumeValue;
+    Parameter VolumeValue;
 
     void  SetVolume(float volume);
     float Process(float in);
+    template <typename T>
+    void ProcessBlock(T* buf, size_t n);
+
+  private:
+    ParameterWatch volumeWatch;
+    LinearSmoother volume;
 };
 // OutAmp
 
 
+// TapeDelay
+// Stereo tape echo on a ring buffer in external memory. Frames are stored
+// interleaved (left, right), so a cache line holds both channels and a
+// block reads and writes contiguous runs of the buffer: SDRAM is slow per
+// random access but fast in bursts through the D-cache.
+class TapeDelay
+{
+  public:
+    TapeDelay(int sample_rate)
+    {
+        this->buffer        = nullptr;
+        this->write         = 0;
+        this->wow_phase     = 0.0f;
+        this->TimeValue     = DELAY_TIME;
+        this->FeedbackValue = DELAY_FEEDBACK;
+        this->MixValue      = DELAY_MIX;
+        this->PingPongValue = DELAY_PING_PONG;
+        this->ToneValue     = DELAY_TONE;
+        this->SetSampleRate(sample_rate);
+    }
+
+    Parameter TimeValue;     // Seconds
+    Parameter FeedbackValue; // 0.0f to 1.0f
+    Parameter MixValue;      // 0.0f to 1.0f
+    Parameter PingPongValue; // 0.0f to 1.0f
+    Parameter ToneValue;     // Hz
+
+    // Attaches the line, 2 * DELAY_BUFFER_SIZE floats, and clears it.
+    // Needed before the first Process: the constructor runs before the
+    // external memory is up.
+    void Init(float* buffer);
+
+    // Times and filters at the new rate, the line is cleared
+    void SetSampleRate(int sample_rate);
+    void UpdateControls();
+    void Process(float in, float& left, float& right);
+    void ProcessBlock(const float* in, float* left, float* right, size_t n);
+
+  private:
+    void Tick(float in, float& left, float& right);
+
+    float*   buffer;
+    uint32_t write; // Frame written by the next sample
+    float    sample_rate;
+    float    delay;  // Samples, gliding to target
+    float    target; // Samples
+    float    min_delay, max_delay;
+    float    glide; // One-pole coefficient of the tape glide
+    float    wow_phase, wow_inc, wow_depth;
+    float    feedback, mix, ping_pong;
+    float    lp_coef, hp_coef;
+    float    lp[2], hp[2]; // Feedback filters, left and right
+
+    ParameterWatch timeWatch;
+    ParameterWatch toneWatch;
+};
+// TapeDelay
+
+
+// FdnReverb
+// Feedback delay network: REVERB_LINES delay lines of mutually prime
+// lengths, each damped by a one-pole lowpass and fed back through a
+// Hadamard matrix. The matrix is applied as a fast Walsh-Hadamard
+// transform, N log2 N additions instead of N * N multiplies, on arrays
+// the compiler can vectorize. Even lines take the left input and feed the
+// left output, odd lines the right.
+//
+// The lines are short and read at N scattered positions every sample, so
+// they live in AXI SRAM (REVERB_BUFFER_SIZE floats, 144 KB of the 512 KB)
+// rather than in SDRAM, where each read would miss the cache, or in DTCM,
+// which holds the engine.
+class FdnReverb
+{
+  public:
+    FdnReverb(int sample_rate)
+    {
+        for(int k = 0; k < REVERB_LINES; k++)
+        {
+            this->line[k] = nullptr;
+            this->pos[k]  = 0;
+            this->lp[k]   = 0.0f;
+        }
+        this->DecayValue = REVERB_DECAY;
+        this->DampValue  = REVERB_DAMPING;
+        this->MixValue   = REVERB_MIX;
+        this->SetSampleRate(sample_rate);
+    }
+
+    Parameter DecayValue; // RT60 in seconds
+    Parameter DampValue;  // Hz
+    Parameter MixValue;   // 0.0f to 1.0f
+
+    // Attaches the lines, REVERB_BUFFER_SIZE floats, and clears them
+    void Init(float* buffer);
+
+    // Line lengths and filters at the new rate, the lines are cleared
+    void SetSampleRate(int sample_rate);
+    void UpdateControls();
+
+    // Both in place, left and right in and out
+    void Process(float& left, float& right);
+    void ProcessBlock(float* left, float* right, size_t n);
+
+  private:
+    float* line[REVERB_LINES];
+    int    length[REVERB_LINES];
+    int    pos[REVERB_LINES]; // Oldest sample, overwritten on each tick
+    float  gain[REVERB_LINES]; // Decay per pass, with the matrix norm
+    float  lp[REVERB_LINES];   // Damping filter states
+    float  sample_rate;
+    float  in_gain; // Keeps the tail level independent of the decay
+    float  damp_coef;
+    float  mix;
+
+    ParameterWatch decayWatch;
+    ParameterWatch dampWatch;
+};
+// FdnReverb
+
+
+// Envelope VCA: out = in * env, entering the sample format of the chain
+template <typename T>
+inline void VcaBlock(T* out, const float* in, const float* env, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        out[i] = Sample<T>::Mul(Sample<T>::FromFloat(in[i]),
+                                Sample<T>::Gain(env[i]));
+    }
+}
+
 // Function declarations
-void InitComponents(int sample_rate, int block_size);
+// Runs the audio callback of the global engine (engine.h), the entry point
+// handed to libDaisy and used by the host tools
+void AudioCallback(AudioHandle::InputBuffer  in,
+                   AudioHandle::OutputBuffer out,
+                   size_t                    size);
 
+// Noise gate of one knob, a one-pole smoother and a dead band
+class KnobFilter
+{
+  public:
+    KnobFilter()
+    {
+        this->smoothed = 0.0f;
+        this->value    = 0.0f;
+        this->primed   = false;
+    }
+
+    // One ADC reading from 0.0f to 1.0f, true when the output moved
+    bool  Process(float raw);
+    float Value() const { return this->value; }
+
+  private:
+    float smoothed;
+    float value;
+    bool  primed; // The first reading is taken without smoothing
+};
+
+// Knob and button state shared by every backend. Backends add InitAll(),
+// UpdateAll() (and DebounceAll() for buttons), called through the hardware
+// policy of the engine (engine.h) without virtual dispatch.
 class KnobHandler
 {
   public:
-    virtual void InitAll();
-    virtual void UpdateAll();
+    KnobHandler()
+    {
+        for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+        {
+            this->Values[i] = 0.0f;
+        }
+    }
+
+    // Knob positions from 0.0f to 1.0f. They only change when a knob
+    // really moves, so every frame PublishControls sends for a knob, and
+    // every coefficient recomputed from it, follows a real change.
+    float Values[NUM_ADC_CHANNELS];
+
+    // Feeds one reading of a channel through its filter, true when
+    // Values[channel] changed
+    bool Acquire(int channel, float raw);
+
+  private:
+    KnobFilter filter[NUM_ADC_CHANNELS];
 };
 
+#ifndef DUB_HOST
 class KnobHandlerDaisy : public KnobHandler
 {
   public:
-    void InitAll() override;
-    void UpdateAll() override;
+    KnobHandlerDaisy() {}
+
+    void InitAll();
+    void UpdateAll(); // One scan, once per control task tick
 };
+#endif // DUB_HOST
 
 class ButtonHandler
 {
   public:
     ButtonHandler()
     {
-        for(int i = 0; i < 4; i++)
-        {
-            this->triggersStates[i][0] = false; // index 0 is Triggered
-            this->triggersStates[i][1] = false; // index 1 is Pressed
-            this->triggersStates[i][2] = false; // index 2 is Released
-        }
+        this->TriggeredMask    = 0;
+        this->PressedMask      = 0;
+        this->ReleasedMask     = 0;
         this->LastIndex        = 0;
         this->bankSelectState  = false;
         this->sweepToTuneState = false;
-        this->currentBankState = false; // Banco atualmente ativo
+        this->risingLatch      = 0;
+        this->fallingLatch     = 0;
     }
 
-    // There are 4 trigger buttons.
-    // Each one has 3 states (true of false): Triggered, Pressed, Released.
-    bool triggersStates[4][3];
-    bool bankSelectState;
-    bool currentBankState; // Banco atualmente ativo
-    bool sweepToTuneState;
-    bool sweepToTuneActive;
+    // Up to MAX_TRIGGERS trigger inputs, the first NUM_TRIGGERS are the
+    // panel buttons. Bit i of each mask is the state of trigger i.
+    TriggerMask TriggeredMask;
+    TriggerMask PressedMask;
+    TriggerMask ReleasedMask;
+    bool bankSelectState;  // Pending bank, applied by the next trigger
+    bool sweepToTuneState; // Pending sweep to tune, applied by the next trigger
     int  LastIndex;
 
-    virtual void InitAll();
-    virtual void DebounceAll();
-    virtual void UpdateAll();
+    // Edges seen since the last published control frame
+    TriggerMask risingLatch;
+    TriggerMask fallingLatch;
+
+    TriggerStack pressStack; // pilha de botões pressionados
+
+    // Shared edge handling, fed by the debounced switches of each backend
+    void UpdateTrigger(int i, bool rising, bool falling, bool held);
+    void UpdateToggles(bool bankRising, bool sweepRising);
+};
+
+// MidiInput
+// Control change number of each knob, indexed by AdcChannel: channel
+// volume, release time, vibrato depth, an undefined one for the tuning,
+// brightness and vibrato rate
+static const uint8_t midi_knob_cc[NUM_ADC_CHANNELS] = {7, 72, 77, 14, 74, 76};
+
+// One MIDI port. The receive interrupt hands its bytes to Receive, which
+// parses them and queues each message with its arrival time. The main
+// loop pops the messages and passes them to DubSirenEngine::PublishMidi
+// (engine.h), which applies them to the controls and publishes each for
+// the sample it arrived at. The mapping (MIDI_CHANNEL, or any channel):
+//
+//   note on / off   MIDI_TRIGGER_NOTE + k presses / releases trigger k + 1,
+//                   on its own input MIDI_TRIGGER_INPUT + k so that the
+//                   panel button and the note do not release each other
+//   control change  midi_knob_cc[knob] moves that knob to value / 127
+//   program change  bank B when bit 0 is set, sweep to tune when bit 1 is,
+//                   pending until the next trigger like the panel toggles
+class MidiInput
+{
+  public:
+    MidiInput() {}
+
+    // Receive interrupt side: the bytes received at now_us. Messages that
+    // find the queue full are dropped.
+    void Receive(const uint8_t* data, size_t size, uint32_t now_us);
+
+    // Main loop side: oldest message, false when there is none
+    bool Pop(MidiMessage& msg);
+
+    // Trigger input of a note message of the mapping, -1 for any other
+    static int TriggerInput(const MidiMessage& msg);
+
+    // Applies a message to the knob and button state, false when it is
+    // not part of the mapping
+    static bool
+    Apply(const MidiMessage& msg, KnobHandler& knobs, ButtonHandler& buttons);
+
+  private:
+    MidiParser                              parser;
+    SpscQueue<MidiMessage, MIDI_QUEUE_SIZE> queue;
 };
+// MidiInput
 
+#ifndef DUB_HOST
 class ButtonHandlerDaisy : public ButtonHandler
 {
   public:
-    ButtonHandlerDaisy()
+    ButtonHandlerDaisy() {}
+
+    Switch triggers[NUM_TRIGGERS];
+    Switch bankSelect;
+    Switch sweepToTune;
+
+    void InitAll();
+    void DebounceAll();
+    void UpdateAll();
+};
+
+// Hardware policy of the engine on the Seed: panel knobs and buttons, the
+// toggle LEDs and the LFO LED
+class DaisyHardware
+{
+  public:
+    typedef KnobHandlerDaisy   Knobs;
+    typedef ButtonHandlerDaisy Buttons;
+
+    void Init(int sample_rate)
     {
-        this->bankSelectState   = false; // já existe
-        this->currentBankState  = false; // já existe
-        this->sweepToTuneState  = false; // já existe (pendente)
-        this->sweepToTuneActive = false; // novo - estado real (ativo)
+        this->led_sweep.Init(daisy::seed::D27, GPIO::Mode::OUTPUT);
+        this->led_bank.Init(daisy::seed::D28, GPIO::Mode::OUTPUT);
+        this->led_lfo.Init(daisy::seed::D29, false, sample_rate);
     }
 
+    void SetLfoLed(float value)
+    {
+        this->led_lfo.Set(value);
+        this->led_lfo.Update();
+    }
 
-    Switch triggers[4];
-    Switch bankSelect;
-    Switch sweepToTune;
+    void SetToggleLeds(bool sweepToTune, bool bankSelect)
+    {
+        this->led_sweep.Write(sweepToTune);
+        this->led_bank.Write(bankSelect);
+    }
 
-    bool bankSelectState;
-    bool currentBankState;
-    bool sweepToTuneState;
-    bool sweepToTuneActive;
+    static uint32_t NowUs() { return System::GetUs(); }
 
-    void InitAll() override;
-    void DebounceAll() override;
-    void UpdateAll() override;
-};
\ No newline at end of file
+    // 4 MB in the SDRAM (2 * DELAY_BUFFER_SIZE floats), ready once hw.Init
+    // has started the controller
+    float* DelayBuffer() { return delay_buffer; }
+    float* ReverbBuffer() { return reverb_buffer; }
+
+  private:
+    Led  led_lfo;
+    GPIO led_sweep;
+    GPIO led_bank;
+};
+
+// ControlTask
+// Fixed rate control ticks from TIM5 and WFI sleep between them. The timer
+// interrupt only counts ticks; the control pass runs in the main loop, so
+// it stays the single producer of the control queue and the audio
+// interrupt, of higher priority, is never held up by it. Idle time is the
+// time spent in WFI, read on the system tick timer, which keeps counting
+// while the core sleeps.
+class ControlTask
+{
+  public:
+    ControlTask()
+    {
+        this->ticks        = 0;
+        this->handled      = 0;
+        this->overruns     = 0;
+        this->idle_ticks   = 0;
+        this->window_start = 0;
+    }
+
+    // Starts the timer at rate ticks per second
+    void Init(int rate);
+
+    // Sleeps until an interrupt, the timer or any other (audio, MIDI).
+    // Returns the control ticks due since the last call, 0 when another
+    // interrupt woke the core; more than 1 means a pass overran a tick.
+    uint32_t Wait();
+
+    // Share of the time spent in WFI since the last call, 0.0f to 1.0f
+    float IdleShare();
+
+    // Ticks skipped because a control pass overran, since Init
+    uint32_t Overruns() const { return this->overruns; }
+
+  private:
+    static void OnTimer(void* context);
+
+    TimerHandle       timer;
+    volatile uint32_t ticks; // Written by the timer interrupt only
+    uint32_t          handled;
+    uint32_t          overruns;
+    uint32_t          idle_ticks;   // System::GetTick ticks in WFI
+    uint32_t          window_start; // System::GetTick of the last IdleShare
+};
+// ControlTask
+#endif // DUB_HOST
\ No newline at end of file
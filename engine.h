@@ -0,0 +1,757 @@
+#pragma once
+
+#include "dub.h"
+
+// Dub siren engine: every component, the control channel and the scratch
+// buffers of one siren, owned by value.
+//
+// HardwarePolicy supplies the knob and button handlers and the outputs the
+// engine drives, resolved at compile time:
+//
+//   typedef ... Knobs;            // InitAll(), UpdateAll(), Values[]
+//   typedef ... Buttons;          // ButtonHandler with InitAll(),
+//                                 // DebounceAll(), UpdateAll()
+//   void Init(int sample_rate);   // Output pins, again on a rate change
+//   void SetLfoLed(float value);  // Once per sample, 0.0f to 1.0f
+//   void SetToggleLeds(bool sweepToTune, bool bankSelect);
+//   static uint32_t NowUs();      // Microsecond timer, 0 if there is none
+//   float* DelayBuffer();         // 2 * DELAY_BUFFER_SIZE floats
+//   float* ReverbBuffer();        // REVERB_BUFFER_SIZE floats
+//
+// DaisyHardware (dub.h) drives the Seed panel, SimHardware
+// (host/sim_handlers.h) the simulated controls of the host tools. Engines
+// share no mutable state, the profiler included, only the wavetable bank
+// they read once it is built, so a process can run several of them side by
+// side, on one thread or on several (host/batch_render.cpp).
+template <typename HardwarePolicy>
+class DubSirenEngine
+{
+  public:
+    typedef typename HardwarePolicy::Knobs   Knobs;
+    typedef typename HardwarePolicy::Buttons Buttons;
+
+    DubSirenEngine(int sample_rate  = 48000,
+                   int block_size   = 4,
+                   int oversampling = 1)
+    : envelope(sample_rate),
+      sweep(sample_rate),
+      lfo(sample_rate),
+      vco(sample_rate, oversampling),
+      vcf(sample_rate, oversampling),
+      delay(sample_rate),
+      reverb(sample_rate)
+    {
+        // The delay and reverb lines are attached by Init: on the Seed the
+        // engine is constructed before hw.Init has brought up the SDRAM
+        this->sample_rate  = sample_rate;
+        this->block_size   = block_size;
+        this->oversampling = oversampling;
+        this->SetControlInterval(0);
+        this->Reset();
+    }
+
+    // Recreates every component, clears the delay lines and empties the
+    // control channel. Needed once before the first callback, and by hosts
+    // and benchmarks that render several independent runs.
+    void Init(int sample_rate,
+              int block_size,
+              int oversampling,
+              int control_interval = 0);
+
+    // Recomputes every rate-dependent coefficient for a new output rate,
+    // 48000 or 96000 on the Seed, keeping the knob and button state. The
+    // delay and reverb lines are cleared and the control channel emptied.
+    // Call it with the audio stopped.
+    void SetSampleRate(int sample_rate);
+
+    // Samples between knob frames and control-rate updates (AudioMode),
+    // 0 = once per block
+    void SetControlInterval(int samples);
+
+    // Output pins, knobs and buttons of the hardware
+    void InitHardware();
+
+    // Main loop side: one pass of knob and button scanning
+    void ScanControls();
+
+    // Main loop side: sends the current knob and button state to the audio
+    // callback. Returns false if the queue was full, the state is then
+    // sent by a later call.
+    bool PublishControls(uint32_t timestamp);
+
+    // Main loop side: audio sample clock now, plus one block of latency so
+    // that the frame lands inside the next callback at a steady offset
+    uint32_t ControlTimestamp();
+
+    // Main loop side: the same for an event seen at event_us on the
+    // microsecond timer, e.g. the arrival of a MIDI message. Never earlier
+    // than the last published frame, so frames stay in order.
+    uint32_t ControlTimestamp(uint32_t event_us);
+
+    // Main loop side: applies a message of a MidiInput to the knob and
+    // button state and publishes it for the sample it arrived at, one
+    // block later (ControlTimestamp). Returns that sample.
+    uint32_t PublishMidi(const MidiMessage& msg);
+
+    // Audio side: samples rendered since Init
+    uint32_t SampleCount() const { return this->audio_samples; }
+
+    void AudioCallback(AudioHandle::InputBuffer  in,
+                       AudioHandle::OutputBuffer out,
+                       size_t                    size);
+    void AudioCallbackBlock(AudioHandle::InputBuffer  in,
+                            AudioHandle::OutputBuffer out,
+                            size_t                    size);
+    void AudioCallbackPerSample(AudioHandle::InputBuffer  in,
+                                AudioHandle::OutputBuffer out,
+                                size_t                    size);
+
+    // Dub Siren components
+    Triggers      triggers;
+    DecayEnvelope envelope;
+    Sweep         sweep;
+    Lfo           lfo;
+    Vco           vco;
+    Vcf           vcf;
+    OutAmp        out_amp;
+    TapeDelay     delay;
+    FdnReverb     reverb;
+
+    HardwarePolicy hardware;
+    Knobs          knobs;
+    Buttons        buttons;
+
+    // Main loop to audio callback channel
+    SpscQueue<ControlFrame, CONTROL_QUEUE_SIZE> control_queue;
+    AudioClock                                  audio_clock;
+
+    int sample_rate, block_size, oversampling, control_interval;
+
+    // Last values of the callback, for the debug prints
+    float                   output, adsr_output, vco_output;
+    std::pair<float, float> lfo_output;
+
+#if DUB_PROFILER
+    Profiler profiler; // Per-stage timing of the callbacks (profiler.h)
+#endif
+
+  private:
+    // Decimators, control channel, profiler and debug outputs back to
+    // their start
+    void Reset();
+
+    // Maps the knob values (0-1, indexed by AdcChannel) to the
+    // components. Runs in the audio callback when a frame is applied.
+    void     ApplyKnobValues(const float values[NUM_ADC_CHANNELS]);
+    void     ApplyControlFrame(const ControlFrame& frame);
+    void     ApplyDueFrames(uint32_t now);
+    uint32_t BeginCallback();
+    void     ProcessVoiceOversampled(size_t n, bool pressed);
+    void     ProcessChunk(float* out_left, float* out_right, size_t n);
+
+    uint32_t     audio_samples;
+    ControlFrame published_frame;
+    bool         published_any;
+
+    // Block processing scratch buffers, one per pipeline stage
+    float    adsr_block[MAX_BLOCK_SIZE];
+    float    cutoff_block[MAX_BLOCK_SIZE]; // Exponents, Vcf::SetExponent
+    float    lfo_block[MAX_BLOCK_SIZE];
+    float    voice_block[MAX_BLOCK_SIZE];
+    sample_t sample_block[MAX_BLOCK_SIZE]; // VCA to output, DUB_SAMPLE_FORMAT
+    float    os_block[MAX_BLOCK_SIZE * MAX_OVERSAMPLING];
+
+    // Oversampled section back to the output rate
+    HalfbandDecimator decimator;    // 2x to 1x
+    HalfbandDecimator decimator_4x; // 4x to 2x, ahead of decimator
+};
+
+
+// Init functions
+template <typename HardwarePolicy>
+void DubSirenEngine<HardwarePolicy>::Init(int sample_rate,
+                                          int block_size,
+                                          int oversampling,
+                                          int control_interval)
+{
+    this->sample_rate  = sample_rate;
+    this->block_size   = block_size;
+    this->oversampling = oversampling;
+    this->SetControlInterval(control_interval);
+
+    this->triggers = Triggers();
+    this->envelope = DecayEnvelope(sample_rate);
+    this->sweep    = Sweep(sample_rate);
+    this->lfo      = Lfo(sample_rate);
+    this->vco      = Vco(sample_rate, oversampling);
+    this->vcf      = Vcf(sample_rate, oversampling);
+    this->out_amp  = OutAmp();
+    this->delay    = TapeDelay(sample_rate);
+    this->delay.Init(this->hardware.DelayBuffer());
+    this->reverb = FdnReverb(sample_rate);
+    this->reverb.Init(this->hardware.ReverbBuffer());
+    this->Reset();
+}
+
+template <typename HardwarePolicy>
+void DubSirenEngine<HardwarePolicy>::SetSampleRate(int sample_rate)
+{
+    // Times stay in seconds and frequencies in hertz: only the per-sample
+    // coefficients change, so the siren sounds the same at both rates
+    this->sample_rate = sample_rate;
+    this->envelope.SetSampleRate(sample_rate);
+    this->sweep.SetSampleRate(sample_rate);
+    this->lfo.SetSampleRate(sample_rate);
+    this->vco.SetSampleRate(sample_rate, this->oversampling);
+    this->vcf.SetSampleRate(sample_rate, this->oversampling);
+    this->delay.SetSampleRate(sample_rate);
+    this->reverb.SetSampleRate(sample_rate);
+    this->hardware.Init(sample_rate); // LFO LED PWM, one step per sample
+    this->Reset();
+}
+
+template <typename HardwarePolicy>
+void DubSirenEngine<HardwarePolicy>::Reset()
+{
+    this->decimator.Init(DECIMATOR_COEFS, DECIMATOR_TRANSITION);
+    this->decimator_4x.Init(DECIMATOR_4X_COEFS, DECIMATOR_4X_TRANSITION);
+
+    this->control_queue.Reset();
+    this->audio_clock.Reset();
+    this->audio_samples = 0;
+    this->published_any = false;
+
+    this->output      = 0.0f;
+    this->adsr_output = 0.0f;
+    this->vco_output  = 0.0f;
+    this->lfo_output  = std::make_pair(0.0f, 0.0f);
+#if DUB_PROFILER
+    InitProfiler(this->profiler, this->sample_rate);
+#endif
+}
+
+template <typename HardwarePolicy>
+void DubSirenEngine<HardwarePolicy>::SetControlInterval(int samples)
+{
+    if(samples <= 0 || samples > this->block_size)
+    {
+        samples = this->block_size;
+    }
+    this->control_interval = samples < MAX_BLOCK_SIZE ? samples
+                                                      : MAX_BLOCK_SIZE;
+}
+
+template <typename HardwarePolicy>
+void DubSirenEngine<HardwarePolicy>::InitHardware()
+{
+    this->hardware.Init(this->sample_rate);
+    this->knobs.InitAll();
+    this->buttons.InitAll();
+}
+// Init functions
+
+
+// Control functions
+template <typename HardwarePolicy>
+void DubSirenEngine<HardwarePolicy>::ScanControls()
+{
+    this->knobs.UpdateAll();
+    this->buttons.DebounceAll();
+    this->buttons.UpdateAll();
+    this->hardware.SetToggleLeds(this->buttons.sweepToTuneState,
+                                 this->buttons.bankSelectState);
+}
+
+template <typename HardwarePolicy>
+bool DubSirenEngine<HardwarePolicy>::PublishControls(uint32_t timestamp)
+{
+    ControlFrame frame;
+    frame.timestamp = timestamp;
+    for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+    {
+        frame.knobs[i] = this->knobs.Values[i];
+    }
+    frame.held        = this->buttons.PressedMask;
+    frame.rising      = this->buttons.risingLatch;
+    frame.falling     = this->buttons.fallingLatch;
+    frame.lastIndex   = this->buttons.LastIndex;
+    frame.bankSelect  = this->buttons.bankSelectState;
+    frame.sweepToTune = this->buttons.sweepToTuneState;
+
+    // Button changes always go out. Knob-only changes (including ADC
+    // noise) go out at most once per control interval so the queue never
+    // floods.
+    const ControlFrame& last = this->published_frame;
+    bool buttons_changed = !this->published_any || frame.rising
+                           || frame.falling || frame.held != last.held
+                           || frame.lastIndex != last.lastIndex
+                           || frame.bankSelect != last.bankSelect
+                           || frame.sweepToTune != last.sweepToTune;
+    bool knobs_changed = false;
+    for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+    {
+        knobs_changed |= frame.knobs[i] != last.knobs[i];
+    }
+    if(!buttons_changed
+       && (!knobs_changed
+           || (int32_t)(timestamp - last.timestamp)
+                  < this->control_interval))
+    {
+        return true;
+    }
+
+    if(!this->control_queue.Push(frame))
+    {
+        return false; // Edges stay latched for the next attempt
+    }
+    this->published_frame      = frame;
+    this->published_any        = true;
+    this->buttons.risingLatch  = 0;
+    this->buttons.fallingLatch = 0;
+    return true;
+}
+
+template <typename HardwarePolicy>
+uint32_t DubSirenEngine<HardwarePolicy>::ControlTimestamp()
+{
+    return this->ControlTimestamp(HardwarePolicy::NowUs());
+}
+
+template <typename HardwarePolicy>
+uint32_t DubSirenEngine<HardwarePolicy>::ControlTimestamp(uint32_t event_us)
+{
+    // Without a microsecond timer the frame lands at the start of the
+    // next callback, one block after the last published clock. An event
+    // from before the last callback started lands that much earlier, at
+    // the start of the next callback at the latest.
+    uint32_t at_us;
+    uint32_t block_start = this->audio_clock.Read(at_us);
+    int32_t  elapsed_us  = (int32_t)(event_us - at_us);
+    int32_t  elapsed
+        = (int32_t)((int64_t)elapsed_us * this->sample_rate / 1000000);
+    if(elapsed >= this->block_size)
+    {
+        elapsed = this->block_size - 1; // Callback is late, keep the order
+    }
+    uint32_t timestamp = block_start + this->block_size + elapsed;
+    if(this->published_any
+       && (int32_t)(timestamp - this->published_frame.timestamp) < 0)
+    {
+        timestamp = this->published_frame.timestamp;
+    }
+    return timestamp;
+}
+
+template <typename HardwarePolicy>
+uint32_t DubSirenEngine<HardwarePolicy>::PublishMidi(const MidiMessage& msg)
+{
+    uint32_t timestamp = this->ControlTimestamp(msg.time_us);
+    if(MidiInput::Apply(msg, this->knobs, this->buttons))
+    {
+        this->PublishControls(timestamp);
+    }
+    return timestamp;
+}
+
+template <typename HardwarePolicy>
+DUB_ITCM void DubSirenEngine<HardwarePolicy>::ApplyKnobValues(
+    const float values[NUM_ADC_CHANNELS])
+{
+    // VCO tune knobs
+    this->vco.TuneValue = fclamp(values[TuneKnob], 0.f, 1.f);
+
+    // Decay Envelope knobs
+    this->envelope.ReleaseValue = fclamp(values[DecayKnob], 0.f, 1.f);
+
+    // Only update sweep value while a trigger is pressed
+    if(this->triggers.Pressed())
+    {
+        this->sweep.ReleaseValue
+            = fmap(values[SweepKnob], 0.f, 1.f, Mapping::LINEAR);
+    }
+
+    // LFO depth (vibrato intensity 0-100%) and rate knobs
+    this->lfo.DepthValue = fclamp(values[DepthKnob], 0.f, 1.f);
+    this->lfo.RateValue  = fmap(
+        values[RateKnob], LFO_MIN_FREQ, LFO_MAX_FREQ, Mapping::EXP);
+
+    // OutAmp volume knob
+    this->out_amp.VolumeValue
+        = fmap(values[VolumeKnob], 0.f, 1.f, Mapping::EXP);
+}
+
+template <typename HardwarePolicy>
+DUB_ITCM void DubSirenEngine<HardwarePolicy>::ApplyControlFrame(
+    const ControlFrame& frame)
+{
+    // Trigger state first, the sweep knob is only latched while pressed
+    this->triggers.Update(frame);
+    this->ApplyKnobValues(frame.knobs);
+
+    // Reset envelope and LFO on trigger
+    if(frame.rising)
+    {
+        this->lfo.ResetPhaseAll();
+        this->triggers.ApplyToggles();
+    }
+}
+
+// Applies every queued frame due at or before the given sample time
+template <typename HardwarePolicy>
+DUB_ITCM void DubSirenEngine<HardwarePolicy>::ApplyDueFrames(uint32_t now)
+{
+    const ControlFrame* frame;
+    while((frame = this->control_queue.Front()) != nullptr
+          && (int32_t)(frame->timestamp - now) <= 0)
+    {
+        this->ApplyControlFrame(*frame);
+        this->control_queue.PopFront();
+    }
+}
+
+// Publishes the sample clock for ControlTimestamp, returns the first
+// sample of this callback
+template <typename HardwarePolicy>
+DUB_ITCM uint32_t DubSirenEngine<HardwarePolicy>::BeginCallback()
+{
+    this->audio_clock.Mark(this->audio_samples, HardwarePolicy::NowUs());
+    return this->audio_samples;
+}
+// Control functions
+
+
+// Main functions
+template <typename HardwarePolicy>
+DUB_ITCM void DubSirenEngine<HardwarePolicy>::AudioCallbackPerSample(
+    AudioHandle::InputBuffer  in,
+    AudioHandle::OutputBuffer out,
+    size_t                    size)
+{
+    uint32_t block_start = this->BeginCallback();
+
+    for(size_t i = 0; i < size; i++)
+    {
+        // Control frames take effect at their exact sample
+        this->ApplyDueFrames(block_start + i);
+
+        bool pressed = this->triggers.Pressed();
+
+        // Use frozen sweep value after release
+        float sweepVal = this->sweep.ReleaseValue;
+
+        // Set and process envelope
+        this->envelope.SetReleaseTime(
+            ADSR_MIN_RELEASE_TIME
+            + (this->envelope.ReleaseValue
+               * (ADSR_RELEASE_TIME - ADSR_MIN_RELEASE_TIME)));
+        this->adsr_output = this->envelope.Process(pressed);
+
+        // --- Filter frequency (VCF) logic ---
+        if(pressed)
+        {
+            this->vcf.UpdateCutoffPressed(sweepVal);
+        }
+        else
+        {
+            this->vcf.SetExponent(this->sweep.UpdateCutoffExp(
+                sweepVal, &this->vcf, this->adsr_output));
+        }
+
+
+        // Initial output from envelope
+        this->output = this->adsr_output;
+
+        // --- LFO processing ---
+        this->lfo.UpdateControls();
+        this->lfo_output = this->lfo.ProcessAll(this->triggers);
+
+        // --- VCO frequency and modulation with FM-inspired deviation ---
+        // Calculate base carrier frequency from tune knob
+        float carrier_freq = VcoExpToFreq(this->vco.TuneValue);
+
+        // Convert LFO output from [0,1] to [-1,+1]
+        float lfo_bipolar = (this->lfo_output.second - 0.5f) * 2.0f;
+
+        // FM synthesis: depth controls intensity, ratio stored in VCO
+        float vco_freq = this->vco.CalculateFMFreq(
+            carrier_freq, lfo_bipolar, this->lfo.DepthValue);
+
+        // Optional sweep modulation mapped to VCO frequency
+        if(this->triggers.IsSweepToTuneActive)
+        {
+            // Recalculate carrier with sweep, then apply FM modulation
+            carrier_freq = this->sweep.UpdateVcoFreq(
+                sweepVal, this->vco.TuneValue, this->adsr_output);
+
+            // Recalculate with swept carrier frequency
+            vco_freq = this->vco.CalculateFMFreq(
+                carrier_freq, lfo_bipolar, this->lfo.DepthValue);
+        }
+
+
+        this->vco.SetFreq(vco_freq);
+        this->vco_output = this->vco.Process();
+        this->output *= this->vco_output;
+
+        // -- LFO LED control ---
+        this->hardware.SetLfoLed((this->lfo_output.first * 0.5f + 0.5f)
+                                 * this->adsr_output);
+
+        // --- Apply VCF low-pass filter ---
+        this->output = this->vcf.Process(this->output);
+
+        // --- Apply output amplifier ---
+        this->output = this->out_amp.Process(this->output);
+
+        // --- Tape delay, or send to output buffer (stereo) ---
+#if DUB_DELAY
+        this->delay.Process(this->output, out[0][i], out[1][i]);
+#else
+        out[0][i] = this->output;
+        out[1][i] = this->output;
+#endif
+#if DUB_REVERB
+        this->reverb.Process(out[0][i], out[1][i]);
+#endif
+    }
+
+    this->audio_samples = block_start + size;
+}
+
+// VCO, envelope VCA and VCF at oversampling times the sample rate. Pitch,
+// envelope and cutoff come in at the output rate and are held across the
+// sub-samples of each sample; sample_block receives the decimated voice.
+template <typename HardwarePolicy>
+DUB_ITCM void DubSirenEngine<HardwarePolicy>::ProcessVoiceOversampled(
+    size_t n, bool pressed)
+{
+    int    os = this->oversampling;
+    size_t m  = n * os;
+
+    // --- VCO block ---
+    for(size_t i = 0, k = 0; i < n; i++)
+    {
+        for(int j = 0; j < os; j++, k++)
+        {
+            this->os_block[k] = this->voice_block[i];
+        }
+    }
+    this->vco.ProcessBlock(this->os_block, m);
+    this->vco_output = this->os_block[m - 1];
+
+    // --- Envelope VCA ---
+    for(size_t i = 0, k = 0; i < n; i++)
+    {
+        for(int j = 0; j < os; j++, k++)
+        {
+            this->os_block[k] *= this->adsr_block[i];
+        }
+    }
+    PROFILE_LAP(STAGE_VCO);
+
+    // --- VCF block ---
+    if(pressed)
+    {
+        this->vcf.ProcessBlock(this->os_block, m);
+    }
+    else
+    {
+        this->vcf.ProcessBlock(this->os_block, this->cutoff_block, n, os);
+    }
+    PROFILE_LAP(STAGE_VCF);
+
+    // --- Decimation, 4x goes through both half-band stages ---
+    if(os == 4)
+    {
+        this->decimator_4x.Process(this->os_block, this->os_block, 2 * n);
+    }
+    this->decimator.Process(this->os_block, this->voice_block, n);
+    for(size_t i = 0; i < n; i++)
+    {
+        this->sample_block[i]
+            = Sample<sample_t>::FromFloat(this->voice_block[i]);
+    }
+    PROFILE_LAP(STAGE_DECIMATOR);
+}
+
+// Runs one chunk of at most control_interval samples through the
+// pipeline: envelope -> cutoff -> LFO -> pitch -> VCO -> VCF -> out amp
+// -> delay -> reverb
+template <typename HardwarePolicy>
+DUB_ITCM void DubSirenEngine<HardwarePolicy>::ProcessChunk(
+    float* out_left, float* out_right, size_t n)
+{
+    // Gate, sweep and knob values are sampled once per block
+    bool  pressed  = this->triggers.Pressed();
+    float sweepVal = this->sweep.ReleaseValue;
+
+    // --- Control rate: coefficients follow the knobs only on change ---
+    this->envelope.UpdateControls();
+    this->lfo.UpdateControls();
+    this->vco.UpdateControls();
+    PROFILE_LAP(STAGE_CONTROLS);
+
+    // --- Envelope block ---
+    this->envelope.ProcessBlock(this->adsr_block, n, pressed);
+    PROFILE_LAP(STAGE_ENVELOPE);
+
+    // --- Filter cutoff block ---
+    if(pressed)
+    {
+        this->vcf.UpdateCutoffPressedBlock(this->sweep.ReleaseValue);
+    }
+    else
+    {
+        this->sweep.UpdateCutoffExpBlock(
+            this->cutoff_block, this->adsr_block, n, sweepVal, &this->vcf);
+    }
+    PROFILE_LAP(STAGE_CUTOFF);
+
+    // --- LFO block ---
+    this->lfo.ProcessBlock(this->lfo_block, n, this->triggers);
+    PROFILE_LAP(STAGE_LFO);
+
+    // --- Pitch block ---
+    if(this->triggers.IsSweepToTuneActive)
+    {
+        this->sweep.UpdateVcoFreqBlock(this->voice_block,
+                                       this->adsr_block,
+                                       n,
+                                       sweepVal,
+                                       this->vco.TuneValue);
+    }
+    else
+    {
+        this->vco.CarrierBlock(this->voice_block, n);
+    }
+    this->vco.CalculateFMFreqBlock(
+        this->voice_block, this->lfo_block, n, this->lfo.DepthValue);
+    PROFILE_LAP(STAGE_PITCH);
+
+    if(this->oversampling > 1)
+    {
+        this->ProcessVoiceOversampled(n, pressed);
+    }
+    else
+    {
+        // --- VCO block ---
+        this->vco.ProcessBlock(this->voice_block, n);
+        this->vco_output = this->voice_block[n - 1];
+
+        // --- Envelope VCA ---
+        VcaBlock(this->sample_block, this->voice_block, this->adsr_block, n);
+        PROFILE_LAP(STAGE_VCO);
+
+        // --- VCF block ---
+        if(pressed)
+        {
+            this->vcf.ProcessBlock(this->sample_block, n);
+        }
+        else
+        {
+            this->vcf.ProcessBlock(this->sample_block, this->cutoff_block, n);
+        }
+        PROFILE_LAP(STAGE_VCF);
+    }
+
+    // --- LFO LED ---
+    for(size_t i = 0; i < n; i++)
+    {
+        float lfo_out = this->lfo_block[i] - 0.5f;
+        this->hardware.SetLfoLed((lfo_out * 0.5f + 0.5f)
+                                 * this->adsr_block[i]);
+    }
+    PROFILE_LAP(STAGE_LED);
+
+    // --- Out amp block ---
+    this->out_amp.ProcessBlock(this->sample_block, n);
+
+    // --- Send to output buffer (stereo) ---
+    for(size_t i = 0; i < n; i++)
+    {
+        out_left[i]  = Sample<sample_t>::ToFloat(this->sample_block[i]);
+        out_right[i] = out_left[i];
+    }
+
+    this->adsr_output       = this->adsr_block[n - 1];
+    this->lfo_output.second = this->lfo_block[n - 1];
+    this->lfo_output.first  = this->lfo_block[n - 1] - 0.5f;
+    this->output            = out_left[n - 1];
+    PROFILE_LAP(STAGE_OUT_AMP);
+
+    // --- Tape delay block, mono in on the left, stereo out ---
+#if DUB_DELAY
+    this->delay.ProcessBlock(out_left, out_left, out_right, n);
+    PROFILE_LAP(STAGE_DELAY);
+#endif
+
+    // --- Reverb block, in place on both channels ---
+#if DUB_REVERB
+    this->reverb.ProcessBlock(out_left, out_right, n);
+    PROFILE_LAP(STAGE_REVERB);
+#endif
+}
+
+template <typename HardwarePolicy>
+DUB_ITCM void DubSirenEngine<HardwarePolicy>::AudioCallbackBlock(
+    AudioHandle::InputBuffer  in,
+    AudioHandle::OutputBuffer out,
+    size_t                    size)
+{
+    uint32_t block_start = this->BeginCallback();
+    size_t   pos         = 0;
+
+    while(pos < size)
+    {
+        this->ApplyDueFrames(block_start + pos);
+        PROFILE_LAP(STAGE_CONTROLS);
+
+        // Run the pipeline up to the next control frame, so that trigger
+        // events land on their exact sample
+        size_t              end  = size;
+        const ControlFrame* next = this->control_queue.Front();
+        if(next != nullptr)
+        {
+            size_t offset = next->timestamp - block_start;
+            if(offset < end)
+            {
+                end = offset;
+            }
+        }
+
+        while(pos < end)
+        {
+            size_t n = end - pos;
+            if(n > (size_t)this->control_interval)
+            {
+                n = this->control_interval;
+            }
+            this->ProcessChunk(out[0] + pos, out[1] + pos, n);
+            pos += n;
+        }
+    }
+
+    this->audio_samples = block_start + size;
+}
+
+template <typename HardwarePolicy>
+DUB_ITCM void DubSirenEngine<HardwarePolicy>::AudioCallback(
+    AudioHandle::InputBuffer  in,
+    AudioHandle::OutputBuffer out,
+    size_t                    size)
+{
+    PROFILE_BEGIN(size);
+#if DUB_BLOCK_PROCESSING
+    this->AudioCallbackBlock(in, out, size);
+#else
+    this->AudioCallbackPerSample(in, out, size);
+#endif
+    PROFILE_END();
+}
+// Main functions
+
+
+#ifndef DUB_HOST
+typedef DubSirenEngine<DaisyHardware> SirenEngine;
+extern SirenEngine engine; // The siren on the Seed panel, dub.cpp
+#endif
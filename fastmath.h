@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Fast approximations of the libm functions used in the audio path.
+// Error bounds are measured by host/fastmath_check over the siren's ranges.
+
+// floorf without a libm call on targets lacking a rounding instruction
+inline int32_t FastFloor(float x)
+{
+    int32_t i = (int32_t)x;
+    return i - (x < (float)i);
+}
+
+// 2^x, relative error below 2e-7 (about 0.0003 cents)
+inline float FastExp2(float x)
+{
+    x = x < -126.0f ? -126.0f : (x > 126.0f ? 126.0f : x);
+
+    int32_t e = FastFloor(x);
+    float   f = x - (float)e;
+
+    // Minimax polynomial for 2^f on [0, 1)
+    float p = 1.0f
+              + f
+                    * (0.69315131f
+                       + f
+                             * (0.24016445f
+                                + f
+                                      * (0.05579991f
+                                         + f * (0.00901703f
+                                                + f * 0.00186713f))));
+
+    // Scale by 2^e through the exponent bits
+    int32_t bits;
+    memcpy(&bits, &p, sizeof(bits));
+    bits += e << 23;
+    memcpy(&p, &bits, sizeof(p));
+    return p;
+}
+
+// Exact replacements for powf(x, 2.0f) and powf(x, 0.5f)
+inline float FastSquare(float x)
+{
+    return x * x;
+}
+
+inline float FastSqrt(float x)
+{
+    return sqrtf(x); // Single vsqrt instruction on the Cortex-M7
+}
+
+// sin(x) for any x, absolute error below 4e-6
+inline float FastSin(float x)
+{
+    // Reduce to [-pi, pi], then fold to [-pi/2, pi/2]
+    x -= 6.28318531f * (float)FastFloor(x * 0.15915494f + 0.5f);
+    if(x > 1.57079633f)
+    {
+        x = 3.14159265f - x;
+    }
+    else if(x < -1.57079633f)
+    {
+        x = -3.14159265f - x;
+    }
+
+    float x2 = x * x;
+    return x
+           * (1.0f
+              + x2
+                    * (-1.66666667e-1f
+                       + x2
+                             * (8.33333333e-3f
+                                + x2 * (-1.98412698e-4f
+                                        + x2 * 2.75573192e-6f))));
+}
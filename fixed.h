@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#endif
+
+// Sample formats of the VCA to output section, VCF included, chosen with
+// DUB_SAMPLE_FORMAT in dub.h. The VCO, the envelopes and the oversampled
+// VCF stay in float.
+//
+// Signals keep one bit of headroom in fixed point: Q31 and Q15 hold
+// x / 2, so the oscillator overshoot and the filter resonance go past
+// full scale without clipping before the out amp brings them down. Gains
+// (envelope, volume) are plain 0 to 1 fractions. Every fixed point
+// operation saturates instead of wrapping.
+
+#define DUB_SAMPLE_FLOAT 0
+#define DUB_SAMPLE_Q31 1
+#define DUB_SAMPLE_Q15 2
+
+typedef int32_t q31_t;
+typedef int16_t q15_t;
+
+inline q31_t SatQ31(int64_t x)
+{
+    return x > INT32_MAX ? INT32_MAX : x < INT32_MIN ? INT32_MIN : (q31_t)x;
+}
+
+inline q15_t SatQ15(int32_t x)
+{
+#if defined(__ARM_FEATURE_DSP)
+    return (q15_t)__ssat(x, 16);
+#else
+    return x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : (q15_t)x;
+#endif
+}
+
+// Fractional products, only -1 * -1 can overflow
+inline q31_t MulQ31(q31_t a, q31_t b)
+{
+    return SatQ31(((int64_t)a * b) >> 31);
+}
+
+inline q15_t MulQ15(q15_t a, q15_t b)
+{
+    return SatQ15(((int32_t)a * b) >> 15);
+}
+
+// Per format conversions and arithmetic, so that the same block code
+// instantiates for float, Q31 and Q15
+template <typename T>
+struct Sample;
+
+template <>
+struct Sample<float>
+{
+    static const char* Name() { return "float"; }
+
+    static float FromFloat(float x) { return x; }
+    static float ToFloat(float x) { return x; }
+    static float Gain(float g) { return g; }
+    static float Mul(float x, float g) { return x * g; }
+
+    // Signed 24-bit codec word, rounded and clipped at full scale. Only
+    // host/fixed_bench compares the formats at the codec resolution: the
+    // audio callback hands floats to libDaisy, which does its own
+    // conversion.
+    static int32_t ToCodec24(float x)
+    {
+        x         = x > 1.0f ? 1.0f : x < -1.0f ? -1.0f : x;
+        int32_t w = (int32_t)lrintf(x * 8388608.0f);
+        return w > 8388607 ? 8388607 : w;
+    }
+};
+
+template <>
+struct Sample<q31_t>
+{
+    static const char* Name() { return "q31"; }
+
+    static q31_t FromFloat(float x)
+    {
+        if(x >= 2.0f)
+        {
+            return INT32_MAX;
+        }
+        return x < -2.0f ? INT32_MIN : (q31_t)(x * 1073741824.0f);
+    }
+
+    static float ToFloat(q31_t x) { return (float)x * (1.0f / 1073741824.0f); }
+
+    static q31_t Gain(float g)
+    {
+        if(g >= 1.0f)
+        {
+            return INT32_MAX;
+        }
+        return g < -1.0f ? INT32_MIN : (q31_t)(g * 2147483648.0f);
+    }
+
+    static q31_t Mul(q31_t x, q31_t g) { return MulQ31(x, g); }
+
+    // Rounds away the 7 bits below the codec resolution
+    static int32_t ToCodec24(q31_t x)
+    {
+        int32_t w = (int32_t)(((int64_t)x + 64) >> 7);
+        return w > 8388607 ? 8388607 : w < -8388608 ? -8388608 : w;
+    }
+};
+
+template <>
+struct Sample<q15_t>
+{
+    static const char* Name() { return "q15"; }
+
+    static q15_t FromFloat(float x)
+    {
+        if(x >= 2.0f)
+        {
+            return INT16_MAX;
+        }
+        return x < -2.0f ? INT16_MIN : (q15_t)(x * 16384.0f);
+    }
+
+    static float ToFloat(q15_t x) { return (float)x * (1.0f / 16384.0f); }
+
+    static q15_t Gain(float g)
+    {
+        if(g >= 1.0f)
+        {
+            return INT16_MAX;
+        }
+        return g < -1.0f ? INT16_MIN : (q15_t)(g * 32768.0f);
+    }
+
+    static q15_t Mul(q15_t x, q15_t g) { return MulQ15(x, g); }
+
+    static int32_t ToCodec24(q15_t x)
+    {
+        int32_t w = (int32_t)x * 512;
+        return w > 8388607 ? 8388607 : w < -8388608 ? -8388608 : w;
+    }
+};
@@ -0,0 +1,518 @@
+// Batch renderer: plays one trigger press through every patch of a grid of
+// knob positions, bank A/B and sweep to tune, spread over a work-stealing
+// thread pool (thread_pool.h) with one engine per worker, and reports the
+// peak, RMS and spectral centroid of each render.
+//
+// usage: batch_render [options] [out_dir]
+//   --knob NAME=LIST   positions of a knob, v1,v2,... or lo:hi:count. The
+//                      grid is every combination of the listed knobs, the
+//                      others stay at their default (volume 0.8, 0.5)
+//   --bank a|b|both    bank of the patches (default both)
+//   --sweep-to-tune off|on|both  (default both)
+//   --length S         render length of each patch (default 2.0 s)
+//   --hold S           time trigger 1 is held (default 1.0 s)
+//   -j THREADS         worker threads (default one per hardware thread)
+//   --csv FILE         write the summary to FILE instead of stdout
+//   --pcm16            write 16-bit PCM instead of 32-bit float
+//   --scaling          render the batch on 1, 2, 4... up to THREADS
+//                      threads, report the speedup over one thread and fail
+//                      unless every thread count renders the same audio
+//   -r RATE, -b SIZE, -o FACTOR  render settings, as in dub_host
+//
+// With out_dir every patch is also written to out_dir/patch_NNNNN.wav.
+// Without --knob the grid is tune 0.2/0.5/0.8, sweep 0.2/0.8 and rate
+// 0.2/0.8, 48 patches with both banks and both sweep to tune states.
+//
+// The spectral centroid is the magnitude weighted mean frequency of the
+// Hann-windowed spectra of the mono mix, averaged over the render.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sim_handlers.h"
+#include "spectrum.h"
+#include "thread_pool.h"
+#include "timeline.h"
+#include "wav_writer.h"
+
+#define FRAME_SIZE 2048
+#define FRAME_HOP 1024
+
+struct Settings
+{
+    int    sample_rate;
+    int    block_size;
+    int    oversampling;
+    double length; // Seconds
+    double hold;   // Seconds
+};
+
+struct Patch
+{
+    float knobs[NUM_ADC_CHANNELS]; // Indexed by AdcChannel
+    bool  bank;                    // false = bank A
+    bool  sweepToTune;
+};
+
+struct PatchStats
+{
+    float    peak;
+    double   rms;
+    double   centroid; // Hz
+    uint64_t hash;     // Of the samples, to compare thread counts
+    bool     written;  // WAV file written, or not asked for
+};
+
+static double SpectralCentroid(const std::vector<float>& left,
+                               const std::vector<float>& right,
+                               int                       sample_rate)
+{
+    std::vector<double>               magnitude(FRAME_SIZE / 2, 0.0);
+    std::vector<std::complex<double>> bins(FRAME_SIZE);
+    for(size_t pos = 0; pos + FRAME_SIZE <= left.size(); pos += FRAME_HOP)
+    {
+        for(int i = 0; i < FRAME_SIZE; i++)
+        {
+            double mono = 0.5 * ((double)left[pos + i] + right[pos + i]);
+            bins[i]     = mono * Hann(i, FRAME_SIZE);
+        }
+        Fft(bins);
+        for(int k = 0; k < FRAME_SIZE / 2; k++)
+        {
+            magnitude[k] += std::abs(bins[k]);
+        }
+    }
+
+    // DC left out, it says nothing about the brightness
+    double weighted = 0.0, total = 0.0;
+    for(int k = 1; k < FRAME_SIZE / 2; k++)
+    {
+        weighted += magnitude[k] * k * sample_rate / FRAME_SIZE;
+        total += magnitude[k];
+    }
+    return total > 0.0 ? weighted / total : 0.0;
+}
+
+static PatchStats Analyse(const std::vector<float>& left,
+                          const std::vector<float>& right,
+                          int                       sample_rate)
+{
+    PatchStats stats;
+    stats.peak    = 0.0f;
+    stats.hash    = 1469598103934665603ull; // FNV-1a
+    double energy = 0.0;
+    for(size_t i = 0; i < left.size(); i++)
+    {
+        float sample[2] = {left[i], right[i]};
+        for(float x : sample)
+        {
+            stats.peak = std::max(stats.peak, fabsf(x));
+            energy += (double)x * x;
+            uint32_t bits;
+            memcpy(&bits, &x, sizeof(bits));
+            stats.hash = (stats.hash ^ bits) * 1099511628211ull;
+        }
+    }
+    stats.rms      = left.empty() ? 0.0 : sqrt(energy / (2 * left.size()));
+    stats.centroid = SpectralCentroid(left, right, sample_rate);
+    return stats;
+}
+
+// One trigger press on a fresh engine, with the same main loop and
+// interrupt interleaving as dub_host: a control pass before each block,
+// the release published at its exact sample
+static void Render(SirenEngine&        siren,
+                   const Patch&        patch,
+                   const Settings&     settings,
+                   std::vector<float>& left,
+                   std::vector<float>& right)
+{
+    ResetSim(siren,
+             settings.sample_rate,
+             settings.block_size,
+             settings.oversampling);
+    siren.knobs.InitAll();
+    siren.buttons.InitAll();
+    for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+    {
+        siren.knobs.Values[i] = patch.knobs[i];
+    }
+    // Pending states, as the toggle buttons leave them, taken up by the
+    // press of the trigger
+    siren.buttons.bankSelectState  = patch.bank;
+    siren.buttons.sweepToTuneState = patch.sweepToTune;
+    siren.buttons.TriggerHeld[0]   = true;
+
+    size_t total   = (size_t)ceil(settings.length * settings.sample_rate);
+    size_t release = (size_t)llround(settings.hold * settings.sample_rate);
+    left.assign(total, 0.0f);
+    right.assign(total, 0.0f);
+    for(size_t pos = 0; pos < total; pos += settings.block_size)
+    {
+        size_t n = std::min((size_t)settings.block_size, total - pos);
+        siren.ScanControls();
+        siren.PublishControls(pos);
+        if(release >= pos && release < pos + n)
+        {
+            siren.buttons.TriggerHeld[0] = false;
+            siren.ScanControls();
+            siren.PublishControls(release);
+        }
+
+        SimHardware::now_us
+            = (uint32_t)llround(pos * 1e6 / settings.sample_rate);
+        float* out[2] = {&left[pos], &right[pos]};
+        siren.AudioCallback(nullptr, out, n);
+    }
+}
+
+// Renders every patch on the threads of the pool, returns the seconds
+// taken. Writes patch_NNNNN.wav files into out_dir unless it is empty.
+static double RenderBatch(ThreadPool&               pool,
+                          const std::vector<Patch>& patches,
+                          const Settings&           settings,
+                          const std::string&        out_dir,
+                          bool                      pcm16,
+                          std::vector<PatchStats>&  stats)
+{
+    std::vector<std::unique_ptr<SirenEngine>> engines(pool.Size());
+    for(std::unique_ptr<SirenEngine>& siren : engines)
+    {
+        siren.reset(new SirenEngine());
+    }
+    stats.assign(patches.size(), PatchStats());
+
+    auto start = std::chrono::steady_clock::now();
+    pool.Run(patches.size(), [&](size_t index, int worker) {
+        SimFlushDenormals(); // Per thread state
+        std::vector<float> left, right;
+        Render(*engines[worker], patches[index], settings, left, right);
+        stats[index]         = Analyse(left, right, settings.sample_rate);
+        stats[index].written = true;
+        if(!out_dir.empty())
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "/patch_%05zu.wav", index);
+            WavWriter wav;
+            if(!wav.Open(out_dir + name, settings.sample_rate, !pcm16))
+            {
+                stats[index].written = false;
+                return;
+            }
+            wav.Write(left.data(), right.data(), left.size());
+        }
+    });
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+static void WriteSummary(FILE*                          file,
+                         const std::vector<Patch>&      patches,
+                         const std::vector<PatchStats>& stats)
+{
+    fprintf(file, "patch");
+    for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+    {
+        fprintf(file, ",%s", knob_names[i]);
+    }
+    fprintf(file, ",bank,sweep_to_tune,peak,rms,centroid_hz\n");
+    for(size_t j = 0; j < patches.size(); j++)
+    {
+        fprintf(file, "%zu", j);
+        for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+        {
+            fprintf(file, ",%.4f", patches[j].knobs[i]);
+        }
+        fprintf(file,
+                ",%c,%d,%.6f,%.6f,%.1f\n",
+                patches[j].bank ? 'B' : 'A',
+                patches[j].sweepToTune ? 1 : 0,
+                stats[j].peak,
+                stats[j].rms,
+                stats[j].centroid);
+    }
+}
+
+// v1,v2,... or lo:hi:count
+static bool ParseValues(const std::string& list, std::vector<float>& values)
+{
+    values.clear();
+    float lo, hi;
+    int   count;
+    char  end;
+    if(sscanf(list.c_str(), "%f:%f:%d%c", &lo, &hi, &count, &end) == 3)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            values.push_back(count > 1 ? lo + (hi - lo) * i / (count - 1)
+                                       : lo);
+        }
+        return count > 0;
+    }
+    size_t start = 0;
+    while(start <= list.size())
+    {
+        size_t      comma = std::min(list.find(',', start), list.size());
+        std::string item  = list.substr(start, comma - start);
+        char*       stop;
+        float       value = strtof(item.c_str(), &stop);
+        if(item.empty() || *stop != '\0')
+        {
+            return false;
+        }
+        values.push_back(value);
+        start = comma + 1;
+    }
+    return true;
+}
+
+static bool ParseChoice(const std::string& s,
+                        const char*        off,
+                        const char*        on,
+                        std::vector<bool>& choices)
+{
+    choices.clear();
+    if(s == off || s == "both")
+        choices.push_back(false);
+    if(s == on || s == "both")
+        choices.push_back(true);
+    return !choices.empty();
+}
+
+static void Usage()
+{
+    fprintf(stderr,
+            "usage: batch_render [--knob name=list]... [--bank a|b|both] "
+            "[--sweep-to-tune off|on|both] [--length s] [--hold s] "
+            "[-j threads] [--csv file] [--pcm16] [--scaling] [-r rate] "
+            "[-b block] [-o factor] [out_dir]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    settings.sample_rate  = 48000;
+    settings.block_size   = 4;
+    settings.oversampling = 1;
+    settings.length       = 2.0;
+    settings.hold         = 1.0;
+
+    std::vector<float> grid[NUM_ADC_CHANNELS];
+    std::vector<bool>  banks = {false, true}, sweeps = {false, true};
+    int                threads = 0;
+    bool               pcm16 = false, scaling = false, custom = false;
+    std::string        out_dir, csv_path;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--knob" && i + 1 < argc)
+        {
+            std::string spec   = argv[++i];
+            size_t      equals = spec.find('=');
+            int         knob   = -1;
+            for(int k = 0; k < NUM_ADC_CHANNELS; k++)
+            {
+                knob = spec.compare(0, equals, knob_names[k]) == 0 ? k : knob;
+            }
+            if(equals == std::string::npos || knob < 0
+               || !ParseValues(spec.substr(equals + 1), grid[knob]))
+            {
+                Usage();
+            }
+            custom = true;
+        }
+        else if(arg == "--bank" && i + 1 < argc)
+        {
+            if(!ParseChoice(argv[++i], "a", "b", banks))
+                Usage();
+        }
+        else if(arg == "--sweep-to-tune" && i + 1 < argc)
+        {
+            if(!ParseChoice(argv[++i], "off", "on", sweeps))
+                Usage();
+        }
+        else if(arg == "--length" && i + 1 < argc)
+            settings.length = atof(argv[++i]);
+        else if(arg == "--hold" && i + 1 < argc)
+            settings.hold = atof(argv[++i]);
+        else if(arg == "-j" && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(arg == "--csv" && i + 1 < argc)
+            csv_path = argv[++i];
+        else if(arg == "--pcm16")
+            pcm16 = true;
+        else if(arg == "--scaling")
+            scaling = true;
+        else if(arg == "-r" && i + 1 < argc)
+            settings.sample_rate = atoi(argv[++i]);
+        else if(arg == "-b" && i + 1 < argc)
+            settings.block_size = atoi(argv[++i]);
+        else if(arg == "-o" && i + 1 < argc)
+            settings.oversampling = atoi(argv[++i]);
+        else if(arg[0] == '-')
+            Usage();
+        else if(out_dir.empty())
+            out_dir = arg;
+        else
+            Usage();
+    }
+    if(settings.sample_rate <= 0 || settings.block_size <= 0
+       || settings.block_size > MAX_BLOCK_SIZE || settings.length <= 0.0
+       || (settings.oversampling != 1 && settings.oversampling != 2
+           && settings.oversampling != 4))
+    {
+        Usage();
+    }
+
+    if(!custom)
+    {
+        grid[TuneKnob]  = {0.2f, 0.5f, 0.8f};
+        grid[SweepKnob] = {0.2f, 0.8f};
+        grid[RateKnob]  = {0.2f, 0.8f};
+    }
+    const float defaults[NUM_ADC_CHANNELS]
+        = {0.8f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f};
+    for(int k = 0; k < NUM_ADC_CHANNELS; k++)
+    {
+        if(grid[k].empty())
+        {
+            grid[k].push_back(defaults[k]);
+        }
+    }
+
+    // Every combination, the last knob varying fastest, then the bank and
+    // sweep to tune states of each
+    std::vector<Patch> patches(1);
+    for(int k = 0; k < NUM_ADC_CHANNELS; k++)
+    {
+        std::vector<Patch> expanded;
+        for(const Patch& patch : patches)
+        {
+            for(float value : grid[k])
+            {
+                expanded.push_back(patch);
+                expanded.back().knobs[k] = value;
+            }
+        }
+        patches.swap(expanded);
+    }
+    std::vector<Patch> expanded;
+    for(const Patch& patch : patches)
+    {
+        for(bool bank : banks)
+        {
+            for(bool sweep : sweeps)
+            {
+                expanded.push_back(patch);
+                expanded.back().bank        = bank;
+                expanded.back().sweepToTune = sweep;
+            }
+        }
+    }
+    patches.swap(expanded);
+
+    FILE* csv = stdout;
+    if(!csv_path.empty() && !(csv = fopen(csv_path.c_str(), "w")))
+    {
+        fprintf(stderr, "cannot write %s\n", csv_path.c_str());
+        return 1;
+    }
+
+    ThreadPool              pool(threads);
+    double                  audio = patches.size() * settings.length;
+    std::vector<PatchStats> stats;
+    int                     failed = 0;
+
+    if(scaling)
+    {
+        std::vector<int> counts;
+        for(int t = 1; t < pool.Size(); t *= 2)
+        {
+            counts.push_back(t);
+        }
+        counts.push_back(pool.Size());
+
+        fprintf(stderr,
+                "%8s %10s %10s %9s %11s\n",
+                "threads",
+                "seconds",
+                "patches/s",
+                "speedup",
+                "efficiency");
+        std::vector<PatchStats> first;
+        double                  one_thread = 0.0;
+        for(int t : counts)
+        {
+            ThreadPool part(t);
+            double     seconds = RenderBatch(
+                part, patches, settings, "", pcm16, stats);
+            if(t == 1)
+            {
+                one_thread = seconds;
+                first      = stats;
+            }
+            for(size_t j = 0; j < stats.size(); j++)
+            {
+                failed += stats[j].hash != first[j].hash ? 1 : 0;
+            }
+            fprintf(stderr,
+                    "%8d %10.3f %10.1f %8.2fx %10.0f%%\n",
+                    t,
+                    seconds,
+                    patches.size() / seconds,
+                    one_thread / seconds,
+                    100.0 * one_thread / seconds / t);
+        }
+        if(failed > 0)
+        {
+            fprintf(stderr,
+                    "%d renders differ between thread counts\n",
+                    failed);
+        }
+        else
+        {
+            fprintf(stderr, "same audio at every thread count\n");
+        }
+    }
+    else
+    {
+        double seconds
+            = RenderBatch(pool, patches, settings, out_dir, pcm16, stats);
+        for(size_t j = 0; j < stats.size(); j++)
+        {
+            if(!stats[j].written)
+            {
+                fprintf(stderr,
+                        "cannot write patch %zu into %s\n",
+                        j,
+                        out_dir.c_str());
+                failed++;
+            }
+        }
+        fprintf(stderr,
+                "rendered %zu patches, %.1f s of audio in %.2f s on %d "
+                "threads, real-time factor %.1fx\n",
+                patches.size(),
+                audio,
+                seconds,
+                pool.Size(),
+                audio / seconds);
+    }
+
+    WriteSummary(csv, patches, stats);
+    if(csv != stdout)
+    {
+        fclose(csv);
+    }
+    return failed > 0 ? 1 : 0;
+}
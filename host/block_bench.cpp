@@ -0,0 +1,142 @@
+// Checks the block pipeline of AudioCallback against the legacy per-sample
+// path and measures both at several block sizes.
+//
+// usage: block_bench [block_size ...]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "sim_handlers.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_SECONDS 4.0f
+#define BENCH_GATE_SECONDS 1.0f
+
+typedef void (*Callback)(AudioHandle::InputBuffer  in,
+                         AudioHandle::OutputBuffer out,
+                         size_t                    size);
+
+struct Scenario
+{
+    const char* name;
+    float       knobs[NUM_ADC_CHANNELS]; // Indexed by AdcChannel
+    int         trigger;
+    bool        bankB;
+    bool        sweepToTune;
+};
+
+static const Scenario scenarios[] = {
+    {"bank A, sweep down", {0.8f, 0.3f, 0.5f, 0.5f, 0.9f, 0.4f}, 0, 0, 0},
+    {"bank A, sweep up", {0.8f, 0.3f, 0.5f, 0.5f, 0.1f, 0.4f}, 1, 0, 0},
+    {"bank B, crossfade", {0.8f, 0.6f, 0.8f, 0.3f, 0.7f, 0.6f}, 2, 1, 0},
+    {"bank B, sweep to tune", {0.8f, 0.5f, 1.0f, 0.7f, 0.0f, 0.8f}, 3, 1, 1},
+};
+
+// Renders one scenario, calling the control tick once per block like the
+// hardware main loop would between two audio interrupts.
+static void Render(const Scenario&     sc,
+                   Callback            callback,
+                   size_t              block_size,
+                   std::vector<float>& result)
+{
+    size_t total = (size_t)(BENCH_SECONDS * BENCH_SAMPLE_RATE);
+    size_t gate  = (size_t)(BENCH_GATE_SECONDS * BENCH_SAMPLE_RATE);
+
+    ResetSim(BENCH_SAMPLE_RATE, block_size);
+    for(int k = 0; k < NUM_ADC_CHANNELS; k++)
+    {
+        sim_knobs.Values[k] = sc.knobs[k];
+    }
+
+    std::vector<float> left(block_size), right(block_size);
+    float*             out[2] = {left.data(), right.data()};
+    result.resize(total);
+
+    for(size_t pos = 0; pos < total; pos += block_size)
+    {
+        sim_buttons.TriggerHeld[sc.trigger] = pos < gate;
+        sim_buttons.BankSelectHeld          = sc.bankB && pos == 0;
+        sim_buttons.SweepToTuneHeld         = sc.sweepToTune && pos == 0;
+        SimControlTick(pos);
+
+        size_t n = std::min(block_size, total - pos);
+        callback(nullptr, out, n);
+        std::copy(left.begin(), left.begin() + n, result.begin() + pos);
+    }
+}
+
+static double TimeRender(const Scenario& sc, Callback callback, size_t bs)
+{
+    std::vector<float> result;
+    auto               start = std::chrono::steady_clock::now();
+    Render(sc, callback, bs, result);
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / result.size();
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<size_t> block_sizes;
+    for(int i = 1; i < argc; i++)
+    {
+        block_sizes.push_back((size_t)atoi(argv[i]));
+    }
+    if(block_sizes.empty())
+    {
+        block_sizes = {4, 16, 64, 256};
+    }
+
+    SimFlushDenormals();
+
+    int failures = 0;
+    printf("%-24s %6s %12s %12s %12s %8s\n",
+           "scenario",
+           "block",
+           "max diff",
+           "sample ns",
+           "block ns",
+           "speedup");
+
+    for(const Scenario& sc : scenarios)
+    {
+        for(size_t bs : block_sizes)
+        {
+            std::vector<float> ref, blk;
+            Render(sc, AudioCallbackPerSample, bs, ref);
+            Render(sc, AudioCallbackBlock, bs, blk);
+
+            float max_diff = 0.0f;
+            for(size_t i = 0; i < ref.size(); i++)
+            {
+                max_diff = std::max(max_diff, fabsf(ref[i] - blk[i]));
+            }
+            if(max_diff > 0.0f)
+            {
+                failures++;
+            }
+
+            double sample_ns = TimeRender(sc, AudioCallbackPerSample, bs);
+            double block_ns  = TimeRender(sc, AudioCallbackBlock, bs);
+            printf("%-24s %6zu %12.3g %12.2f %12.2f %7.2fx\n",
+                   sc.name,
+                   bs,
+                   max_diff,
+                   sample_ns,
+                   block_ns,
+                   sample_ns / block_ns);
+        }
+    }
+
+    printf("48 kHz budget: %.1f ns/sample\n", 1e9 / BENCH_SAMPLE_RATE);
+    if(failures)
+    {
+        printf("%d run(s) differ between per-sample and block paths\n",
+               failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+// Stress test for the main loop to audio callback channel.
+//
+// 1. Raw queue: a producer thread pushes numbered frames whose fields are
+//    all derived from the number, a consumer thread checks that every frame
+//    arrives complete, in order and exactly once.
+// 2. Engine: a control thread runs the simulated main loop with random
+//    knob and button activity while an audio thread runs AudioCallback.
+//    After both stop, the audio side must hold the last published state.
+//
+// usage: control_stress [seconds]
+// Build with CXXFLAGS="-O1 -g -fsanitize=thread" to also check for races.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+#include "sim_handlers.h"
+
+#define STRESS_SAMPLE_RATE 48000
+#define STRESS_BLOCK_SIZE 4
+
+static void FillFrame(ControlFrame& frame, uint32_t seq)
+{
+    frame.timestamp = seq;
+    for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+    {
+        frame.knobs[i] = (float)(seq * (i + 1) % 1000003);
+    }
+    frame.held        = seq & 0xf;
+    frame.rising      = (seq >> 4) & 0xf;
+    frame.falling     = (seq >> 8) & 0xf;
+    frame.lastIndex   = seq & 3;
+    frame.bankSelect  = (seq >> 2) & 1;
+    frame.sweepToTune = (seq >> 3) & 1;
+}
+
+static bool StressQueue(double seconds)
+{
+    static SpscQueue<ControlFrame, CONTROL_QUEUE_SIZE> queue;
+    std::atomic<bool>                                  done(false);
+    uint32_t                                           pushed = 0;
+    uint32_t                                           popped = 0;
+    uint32_t                                           errors = 0;
+
+    std::thread producer([&]() {
+        ControlFrame frame;
+        auto         stop = std::chrono::steady_clock::now()
+                    + std::chrono::duration<double>(seconds);
+        while(std::chrono::steady_clock::now() < stop)
+        {
+            FillFrame(frame, pushed);
+            if(queue.Push(frame))
+            {
+                pushed++;
+            }
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    std::thread consumer([&]() {
+        ControlFrame expected;
+        while(true)
+        {
+            const ControlFrame* frame = queue.Front();
+            if(frame == nullptr)
+            {
+                if(done.load(std::memory_order_acquire)
+                   && queue.Front() == nullptr)
+                {
+                    break;
+                }
+                continue;
+            }
+            FillFrame(expected, popped);
+            bool same = frame->timestamp == expected.timestamp
+                        && frame->held == expected.held
+                        && frame->rising == expected.rising
+                        && frame->falling == expected.falling
+                        && frame->lastIndex == expected.lastIndex
+                        && frame->bankSelect == expected.bankSelect
+                        && frame->sweepToTune == expected.sweepToTune;
+            for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+            {
+                same &= frame->knobs[i] == expected.knobs[i];
+            }
+            errors += !same;
+            queue.PopFront();
+            popped++;
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    printf("queue:  %u frames pushed, %u popped, %u torn or out of order\n",
+           pushed,
+           popped,
+           errors);
+    return errors == 0 && pushed == popped;
+}
+
+static bool StressEngine(double seconds)
+{
+    SimFlushDenormals();
+    ResetSim(STRESS_SAMPLE_RATE, STRESS_BLOCK_SIZE);
+
+    std::atomic<bool> done(false);
+    uint32_t          ticks     = 0;
+    uint32_t          callbacks = 0;
+    uint32_t          bad       = 0;
+
+    std::thread control([&]() {
+        std::mt19937                          rng(1234);
+        std::uniform_real_distribution<float> knob(0.0f, 1.0f);
+        auto stop = std::chrono::steady_clock::now()
+                    + std::chrono::duration<double>(seconds);
+        while(std::chrono::steady_clock::now() < stop)
+        {
+            uint32_t r = rng();
+            if((r & 0xff) == 0)
+            {
+                sim_knobs.Values[r % NUM_ADC_CHANNELS] = knob(rng);
+            }
+            if((r & 0xfff) == 1)
+            {
+                sim_buttons.TriggerHeld[(r >> 12) & 3]
+                    = !sim_buttons.TriggerHeld[(r >> 12) & 3];
+            }
+            if((r & 0xffff) == 2)
+            {
+                sim_buttons.BankSelectHeld = !sim_buttons.BankSelectHeld;
+            }
+            if((r & 0xffff) == 3)
+            {
+                sim_buttons.SweepToTuneHeld = !sim_buttons.SweepToTuneHeld;
+            }
+            SimControlTick(engine.ControlTimestamp());
+            ticks++;
+        }
+
+        // Final state: every knob set, make sure it gets through
+        for(int i = 0; i < NUM_ADC_CHANNELS; i++)
+        {
+            sim_knobs.Values[i] = 0.25f + 0.1f * i;
+        }
+        for(int i = 0; i < 4; i++)
+        {
+            sim_buttons.TriggerHeld[i] = i == 2;
+        }
+        engine.ScanControls();
+        while(!engine.PublishControls(engine.ControlTimestamp()))
+        {
+            std::this_thread::yield();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    std::thread audio([&]() {
+        float  left[STRESS_BLOCK_SIZE], right[STRESS_BLOCK_SIZE];
+        float* out[2] = {left, right};
+        while(!done.load(std::memory_order_acquire)
+              || engine.control_queue.Front() != nullptr)
+        {
+            AudioCallback(nullptr, out, STRESS_BLOCK_SIZE);
+            for(int i = 0; i < STRESS_BLOCK_SIZE; i++)
+            {
+                bad += !std::isfinite(left[i]) || fabsf(left[i]) > 4.0f;
+            }
+            callbacks++;
+        }
+    });
+
+    control.join();
+    audio.join();
+
+    // The audio side must now hold exactly the last published frame
+    bool consistent
+        = (float)engine.vco.TuneValue == 0.25f + 0.1f * TuneKnob
+          && (float)engine.envelope.ReleaseValue == 0.25f + 0.1f * DecayKnob
+          && (float)engine.lfo.DepthValue == 0.25f + 0.1f * DepthKnob
+          && engine.triggers.Pressed() && engine.triggers.LastIndex == 2;
+
+    printf("engine: %u control ticks, %u callbacks, %u bad samples, "
+           "final state %s\n",
+           ticks,
+           callbacks,
+           bad,
+           consistent ? "consistent" : "INCONSISTENT");
+    return bad == 0 && consistent;
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    bool   ok      = StressQueue(seconds);
+    ok &= StressEngine(seconds);
+    return ok ? 0 : 1;
+}
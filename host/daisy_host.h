@@ -0,0 +1,38 @@
+#pragma once
+
+// Minimal stand-ins for the libDaisy types that the shared siren code uses
+// when it is compiled for a host machine (DUB_HOST). Knobs and buttons are
+// not emulated here, they are simulated through KnobHandler/ButtonHandler.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace daisy
+{
+class AudioHandle
+{
+  public:
+    typedef const float* const* InputBuffer;
+    typedef float**             OutputBuffer;
+};
+
+// Software PWM led, only keeps the last brightness written
+class Led
+{
+  public:
+    void Init(int pin, bool invert, float samplerate = 1000.0f)
+    {
+        this->brightness = 0.0f;
+    }
+    void  Set(float val) { this->brightness = val; }
+    void  Update() {}
+    float Brightness() const { return this->brightness; }
+
+  private:
+    float brightness = 0.0f;
+};
+} // namespace daisy
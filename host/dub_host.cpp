@@ -0,0 +1,282 @@
+// Offline renderer: replays a control timeline through the simulated knobs
+// and buttons, renders AudioCallback to a WAV file and reports how fast the
+// render ran compared to real time.
+//
+// With -m the messages of a standard MIDI file also play the siren (the
+// mapping of MidiInput, dub.h). Each one takes the path it takes on the
+// Seed: its bytes reach MidiInput::Receive at the time they arrive on the
+// simulated microsecond timer, and the main loop pass before the next
+// callback publishes it with DubSirenEngine::PublishMidi. The note events
+// are reported with the latency from their arrival to the sample the
+// engine applies them at, and the jitter, the spread of that latency.
+//
+// usage: dub_host [options] script.txt [out.wav]
+//   -r RATE          sample rate (default 48000)
+//   -b SIZE          audio block size (default 4, as on the Seed)
+//   -p               use the legacy per-sample callback
+//   -o FACTOR        oversample the VCO to VCF section 1, 2 or 4 times
+//   -m FILE.mid      play a MIDI file, up to the end of the script
+//   --midi-polled    apply MIDI at the next callback instead, as a main
+//                    loop polling the port without timestamps would
+//   --max-jitter N   fail when the MIDI note jitter exceeds N samples
+//   --pcm16          write 16-bit PCM instead of 32-bit float
+//   --min-rtf X      fail when the real-time factor is below X
+//
+// Built with make PROFILER=1 it also prints the per-stage breakdown of the
+// block callback (profiler.h).
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "midi_file.h"
+#include "sim_handlers.h"
+#include "timeline.h"
+#include "wav_writer.h"
+
+typedef void (*Callback)(AudioHandle::InputBuffer  in,
+                         AudioHandle::OutputBuffer out,
+                         size_t                    size);
+
+#if DUB_PROFILER
+static void PrintStageProfile(const ProfileSnapshot& snapshot)
+{
+    if(snapshot.callbacks == 0)
+    {
+        return;
+    }
+    double total = (double)snapshot.callback.sum;
+    printf("profile: %u callbacks, budget %.1f us, overruns %u\n",
+           snapshot.callbacks,
+           snapshot.budget * 1e-3,
+           snapshot.total_overruns);
+    printf("  %-10s %10s %10s %10s %7s\n", "stage", "min ns", "avg ns",
+           "max ns", "share");
+    for(int i = 0; i < NUM_PROFILE_STAGES; i++)
+    {
+        const ProfileStats& st = snapshot.stages[i];
+        printf("  %-10s %10u %10.1f %10u %6.1f%%\n",
+               ProfileStageName(i),
+               st.min,
+               (double)st.sum / snapshot.callbacks,
+               st.max,
+               total > 0.0 ? 100.0 * st.sum / total : 0.0);
+    }
+}
+#endif
+
+static void Usage()
+{
+    fprintf(stderr,
+            "usage: dub_host [-r rate] [-b block] [-p] [-o factor] "
+            "[-m file.mid] [--midi-polled] [--max-jitter n] [--pcm16] "
+            "[--min-rtf x] script.txt [out.wav]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    int         sample_rate  = 48000;
+    int         block_size   = 4;
+    int         oversampling = 1;
+    bool        per_sample   = false;
+    bool        pcm16        = false;
+    bool        midi_polled  = false;
+    double      min_rtf      = 0.0;
+    double      max_jitter   = -1.0;
+    std::string script_path, wav_path, midi_path;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "-r" && i + 1 < argc)
+            sample_rate = atoi(argv[++i]);
+        else if(arg == "-b" && i + 1 < argc)
+            block_size = atoi(argv[++i]);
+        else if(arg == "-p")
+            per_sample = true;
+        else if(arg == "-o" && i + 1 < argc)
+            oversampling = atoi(argv[++i]);
+        else if(arg == "-m" && i + 1 < argc)
+            midi_path = argv[++i];
+        else if(arg == "--midi-polled")
+            midi_polled = true;
+        else if(arg == "--max-jitter" && i + 1 < argc)
+            max_jitter = atof(argv[++i]);
+        else if(arg == "--pcm16")
+            pcm16 = true;
+        else if(arg == "--min-rtf" && i + 1 < argc)
+            min_rtf = atof(argv[++i]);
+        else if(arg[0] == '-')
+            Usage();
+        else if(script_path.empty())
+            script_path = arg;
+        else if(wav_path.empty())
+            wav_path = arg;
+        else
+            Usage();
+    }
+    bool factor_ok = oversampling == 1
+                     || ((oversampling == 2 || oversampling == 4)
+                         && !per_sample);
+    if(script_path.empty() || sample_rate <= 0 || block_size <= 0
+       || !factor_ok)
+    {
+        Usage();
+    }
+
+    Timeline    timeline;
+    std::string error;
+    if(!timeline.Load(script_path, error))
+    {
+        fprintf(stderr, "%s: %s\n", script_path.c_str(), error.c_str());
+        return 1;
+    }
+
+    MidiFile midi;
+    if(!midi_path.empty() && !midi.Load(midi_path, error))
+    {
+        fprintf(stderr, "%s: %s\n", midi_path.c_str(), error.c_str());
+        return 1;
+    }
+
+    WavWriter wav;
+    if(!wav_path.empty() && !wav.Open(wav_path, sample_rate, !pcm16))
+    {
+        fprintf(stderr, "cannot write %s\n", wav_path.c_str());
+        return 1;
+    }
+
+    SimFlushDenormals();
+    ResetSim(sample_rate, block_size, oversampling);
+    sim_knobs.InitAll();
+    sim_buttons.InitAll();
+
+    Callback callback = per_sample ? AudioCallbackPerSample : AudioCallback;
+    size_t   total = (size_t)ceil(timeline.Duration() * sample_rate);
+    std::vector<float> left(block_size), right(block_size);
+    float*             out[2] = {left.data(), right.data()};
+    float              peak   = 0.0f;
+    double             audio_ns = 0.0;
+
+    MidiInput midi_input;
+    size_t    next_midi   = 0;
+    int       notes       = 0;
+    double    min_latency = INFINITY, max_latency = -INFINITY; // Samples
+
+    for(size_t pos = 0; pos < total; pos += block_size)
+    {
+        size_t n = std::min((size_t)block_size, total - pos);
+
+        // Main loop pass between two audio interrupts, then every scripted
+        // change inside this block at its exact sample
+        SimControlTick(pos);
+
+        // MIDI that arrived while the previous block played, received at
+        // its time on the microsecond timer
+        while(next_midi < midi.events.size()
+              && midi.events[next_midi].time * sample_rate < pos)
+        {
+            const MidiFileEvent& ev = midi.events[next_midi++];
+            midi_input.Receive(
+                ev.bytes, ev.size, (uint32_t)llround(ev.time * 1e6));
+        }
+        MidiMessage msg;
+        while(midi_input.Pop(msg))
+        {
+            uint32_t timestamp = pos;
+            if(midi_polled)
+            {
+                MidiInput::Apply(msg, sim_knobs, sim_buttons);
+                engine.PublishControls(timestamp);
+            }
+            else
+            {
+                timestamp = engine.PublishMidi(msg);
+            }
+            if(MidiInput::TriggerInput(msg) >= 0)
+            {
+                // A frame due before the callback applies at its start
+                double applied = std::max(timestamp, (uint32_t)pos);
+                double latency = applied - msg.time_us * 1e-6 * sample_rate;
+                min_latency    = std::min(min_latency, latency);
+                max_latency    = std::max(max_latency, latency);
+                notes++;
+            }
+        }
+
+        while(llround(timeline.NextTime() * sample_rate) < (long long)(pos + n))
+        {
+            double time = timeline.NextTime();
+            timeline.ApplyUntil(time);
+            SimControlTick((uint32_t)llround(time * sample_rate));
+        }
+
+        SimHardware::now_us = (uint32_t)llround(pos * 1e6 / sample_rate);
+        auto start          = std::chrono::steady_clock::now();
+        callback(nullptr, out, n);
+        auto stop = std::chrono::steady_clock::now();
+        audio_ns += std::chrono::duration<double, std::nano>(stop - start)
+                        .count();
+
+        for(size_t i = 0; i < n; i++)
+        {
+            peak = std::max(peak, fabsf(left[i]));
+        }
+        wav.Write(left.data(), right.data(), n);
+    }
+    wav.Close();
+
+    double seconds = (double)total / sample_rate;
+    double rtf     = audio_ns > 0.0 ? seconds * 1e9 / audio_ns : 0.0;
+    printf("rendered %.2f s at %d Hz, block %d, oversampling %dx "
+           "(%s path)\n",
+           seconds,
+           sample_rate,
+           block_size,
+           oversampling,
+           per_sample ? "per-sample" : "block");
+    printf("callback: %.1f ns/sample, real-time factor %.1fx\n",
+           total ? audio_ns / total : 0.0,
+           rtf);
+    printf("peak: %.4f (%.1f dBFS)\n", peak, 20.0f * log10f(peak + 1e-12f));
+#if DUB_PROFILER
+    PrintStageProfile(engine.profiler.Current());
+#endif
+
+    double jitter = notes ? max_latency - min_latency : 0.0;
+    if(!midi_path.empty())
+    {
+        printf("midi: %d note events (%s), latency %.2f-%.2f samples "
+               "(%.3f-%.3f ms), jitter %.2f samples\n",
+               notes,
+               midi_polled ? "polled" : "timestamped",
+               notes ? min_latency : 0.0,
+               notes ? max_latency : 0.0,
+               notes ? 1e3 * min_latency / sample_rate : 0.0,
+               notes ? 1e3 * max_latency / sample_rate : 0.0,
+               jitter);
+    }
+    if(max_jitter >= 0.0 && jitter > max_jitter)
+    {
+        fprintf(stderr,
+                "MIDI jitter %.2f samples is above the %.2f maximum\n",
+                jitter,
+                max_jitter);
+        return 1;
+    }
+
+    if(min_rtf > 0.0 && rtf < min_rtf)
+    {
+        fprintf(stderr,
+                "real-time factor %.1fx is below the %.1fx minimum\n",
+                rtf,
+                min_rtf);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+// Accuracy and speed report for fastmath.h.
+//
+// Accuracy is measured against double precision references over the
+// ranges the siren uses (full knob travel for the pitch and cutoff maps).
+// Exits with an error when a helper is outside its documented bound.
+//
+// usage: fastmath_check
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "dub.h"
+
+#define CHECK_STEPS 100000
+#define BENCH_SIZE 4096
+#define BENCH_ROUNDS 2000
+
+static int failures = 0;
+
+static void
+Report(const char* name, double error, double bound, const char* unit)
+{
+    bool ok = error <= bound;
+    printf("%-34s %12.3g %-6s (bound %.3g) %s\n",
+           name,
+           error,
+           unit,
+           bound,
+           ok ? "ok" : "FAIL");
+    if(!ok)
+    {
+        failures++;
+    }
+}
+
+static void CheckAccuracy()
+{
+    double vco_cents = 0.0, vco_hz = 0.0, vcf_cents = 0.0, vcf_hz = 0.0;
+    for(int i = 0; i <= CHECK_STEPS; i++)
+    {
+        float  x   = (float)i / CHECK_STEPS;
+        double ref = VCO_MIN_FREQ * pow((double)VCO_MAX_FREQ / VCO_MIN_FREQ, x);
+        double got = VcoExpToFreq(x);
+        vco_cents  = fmax(vco_cents, fabs(1200.0 * log2(got / ref)));
+        vco_hz     = fmax(vco_hz, fabs(got - ref));
+
+        ref       = VCF_MIN_FREQ * pow((double)VCF_MAX_FREQ / VCF_MIN_FREQ, x);
+        got       = VcfExpToFreq(x);
+        vcf_cents = fmax(vcf_cents, fabs(1200.0 * log2(got / ref)));
+        vcf_hz    = fmax(vcf_hz, fabs(got - ref));
+    }
+    Report("VcoExpToFreq, tune 0-1", vco_cents, 0.01, "cents");
+    Report("VcoExpToFreq, tune 0-1", vco_hz, 0.01, "Hz");
+    Report("VcfExpToFreq, cutoff 0-1", vcf_cents, 0.01, "cents");
+    Report("VcfExpToFreq, cutoff 0-1", vcf_hz, 0.1, "Hz");
+
+    double exp2_err = 0.0, sin_err = 0.0;
+    for(int i = 0; i <= CHECK_STEPS; i++)
+    {
+        double t = (double)i / CHECK_STEPS;
+
+        float x  = (float)(-20.0 + 40.0 * t);
+        exp2_err = fmax(exp2_err, fabs(FastExp2(x) / exp2((double)x) - 1.0));
+
+        x       = (float)(-20.0 * M_PI + 40.0 * M_PI * t);
+        sin_err = fmax(sin_err, fabs(FastSin(x) - sin((double)x)));
+    }
+    Report("FastExp2, x in [-20, 20]", exp2_err, 2e-7, "rel");
+    Report("FastSin, x in [-20pi, 20pi]", sin_err, 4e-6, "abs");
+
+    // The intensity curves must be correctly rounded
+    int square_diffs = 0, sqrt_diffs = 0;
+    for(int i = 0; i <= CHECK_STEPS; i++)
+    {
+        float x = (float)i / CHECK_STEPS;
+        square_diffs += FastSquare(x) != (float)((double)x * x);
+        sqrt_diffs += FastSqrt(x) != (float)sqrt((double)x);
+    }
+    Report("FastSquare, x in [0, 1]", square_diffs, 0, "ulp>0");
+    Report("FastSqrt, x in [0, 1]", sqrt_diffs, 0, "ulp>0");
+}
+
+template <typename F>
+static double TimePerCall(const std::vector<float>& in, F fn)
+{
+    // Independent calls, so this measures throughput rather than latency
+    std::vector<float> out(in.size());
+    volatile float     sink  = 0.0f;
+    auto               start = std::chrono::steady_clock::now();
+    for(int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for(size_t i = 0; i < in.size(); i++)
+        {
+            out[i] = fn(in[i]);
+        }
+        sink = sink + out[r % in.size()];
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / ((double)BENCH_ROUNDS * in.size());
+}
+
+template <typename Fast, typename Libm>
+static void
+Bench(const char* name, const std::vector<float>& in, Fast fast, Libm libm)
+{
+    double fast_ns = TimePerCall(in, fast);
+    double libm_ns = TimePerCall(in, libm);
+    printf("%-34s %8.2f ns %8.2f ns %7.2fx\n",
+           name,
+           fast_ns,
+           libm_ns,
+           libm_ns / fast_ns);
+}
+
+int main()
+{
+    CheckAccuracy();
+
+    std::vector<float> unit(BENCH_SIZE), wide(BENCH_SIZE);
+    for(int i = 0; i < BENCH_SIZE; i++)
+    {
+        float t = (float)i / BENCH_SIZE;
+        unit[i] = t;
+        wide[i] = -10.0f + 20.0f * t;
+    }
+
+    printf("\n%-34s %11s %11s %8s\n", "helper", "fast", "libm", "speedup");
+    // Lambdas let both sides inline into the timing loop
+    Bench(
+        "VcoExpToFreq vs powf map",
+        unit,
+        [](float x) { return VcoExpToFreq(x); },
+        [](float x) {
+            return VCO_MIN_FREQ * powf(VCO_MAX_FREQ / VCO_MIN_FREQ, x);
+        });
+    Bench(
+        "FastExp2 vs exp2f",
+        wide,
+        [](float x) { return FastExp2(x); },
+        [](float x) { return exp2f(x); });
+    Bench(
+        "FastSquare vs powf(x, 2)",
+        unit,
+        [](float x) { return FastSquare(x); },
+        [](float x) { return powf(x, 2.0f); });
+    Bench(
+        "FastSqrt vs powf(x, 0.5)",
+        unit,
+        [](float x) { return FastSqrt(x); },
+        [](float x) { return powf(x, 0.5f); });
+    Bench(
+        "FastSin vs sinf",
+        wide,
+        [](float x) { return FastSin(x); },
+        [](float x) { return sinf(x); });
+
+    if(failures)
+    {
+        printf("\n%d check(s) outside their bound\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Compares the float, Q31 and Q15 instantiations of the VCA to output
+// section (DUB_SAMPLE_FORMAT, fixed.h): cost per sample of each stage and
+// the accuracy of the fixed point formats against float.
+//
+// The input is a decaying, slightly overshooting saw with a swept cutoff
+// and a moving volume knob, run in blocks of BENCH_BLOCK samples.
+// Accuracy is the SNR against the float chain, the noise floor in dBFS and
+// the largest difference of the 24-bit codec words.
+//
+// usage: fixed_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "sim_handlers.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_SAMPLES (BENCH_SAMPLE_RATE * 2)
+#define BENCH_BLOCK 48
+#define BENCH_PASSES 10
+
+enum BenchStage
+{
+    BENCH_VCA = 0,
+    BENCH_VCF,
+    BENCH_OUT_AMP,
+    BENCH_TO_FLOAT,
+    BENCH_TO_CODEC,
+    NUM_BENCH_STAGES
+};
+
+static const char* stage_names[NUM_BENCH_STAGES]
+    = {"vca", "vcf", "out amp", "to float", "to codec"};
+
+struct Input
+{
+    std::vector<float> vco, env, cutoff;
+};
+
+struct Result
+{
+    double               ns[NUM_BENCH_STAGES]; // Per sample, best pass
+    std::vector<float>   out;
+    std::vector<int32_t> codec;
+};
+
+static volatile int32_t sink;
+
+static Input MakeInput()
+{
+    Input in;
+    in.vco.resize(BENCH_SAMPLES);
+    in.env.resize(BENCH_SAMPLES);
+    in.cutoff.resize(BENCH_SAMPLES);
+    float phase = 0.0f;
+    for(int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        // Saw from a few harmonics, peaks a little above full scale like
+        // the PolyBLEP overshoot
+        float saw = 0.0f;
+        for(int h = 1; h <= 8; h++)
+        {
+            saw += sinf(2.0f * (float)M_PI * h * phase) / h;
+        }
+        in.vco[i] = 0.7f * saw;
+        phase += 220.0f / BENCH_SAMPLE_RATE;
+        phase -= phase >= 1.0f ? 1.0f : 0.0f;
+
+        // Cutoff exponent of 200 Hz rising to 5 kHz
+        float t      = (float)i / BENCH_SAMPLES;
+        float freq   = 200.0f * powf(25.0f, t);
+        in.env[i]    = expf(-4.0f * t);
+        in.cutoff[i] = log2f(freq / VCF_MIN_FREQ) / VCF_OCTAVES;
+    }
+    return in;
+}
+
+static double Elapsed(std::chrono::steady_clock::time_point start)
+{
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / BENCH_SAMPLES;
+}
+
+template <typename T>
+static Result Run(const Input& in)
+{
+    Result r;
+    std::fill(r.ns, r.ns + NUM_BENCH_STAGES, 1e30);
+    std::vector<T> buf(BENCH_SAMPLES);
+    r.out.resize(BENCH_SAMPLES);
+    r.codec.resize(BENCH_SAMPLES);
+
+    for(int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        Vcf    vcf(BENCH_SAMPLE_RATE, 1);
+        OutAmp out_amp;
+
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < BENCH_SAMPLES; i += BENCH_BLOCK)
+        {
+            VcaBlock(&buf[i], &in.vco[i], &in.env[i], BENCH_BLOCK);
+        }
+        r.ns[BENCH_VCA] = std::min(r.ns[BENCH_VCA], Elapsed(start));
+
+        start = std::chrono::steady_clock::now();
+        for(int i = 0; i < BENCH_SAMPLES; i += BENCH_BLOCK)
+        {
+            vcf.ProcessBlock(&buf[i], &in.cutoff[i], BENCH_BLOCK);
+        }
+        r.ns[BENCH_VCF] = std::min(r.ns[BENCH_VCF], Elapsed(start));
+
+        start = std::chrono::steady_clock::now();
+        for(int i = 0, k = 0; i < BENCH_SAMPLES; i += BENCH_BLOCK, k++)
+        {
+            out_amp.VolumeValue = 0.6f + 0.3f * sinf(0.01f * k);
+            out_amp.ProcessBlock(&buf[i], BENCH_BLOCK);
+        }
+        r.ns[BENCH_OUT_AMP] = std::min(r.ns[BENCH_OUT_AMP], Elapsed(start));
+
+        start = std::chrono::steady_clock::now();
+        for(int i = 0; i < BENCH_SAMPLES; i++)
+        {
+            r.out[i] = Sample<T>::ToFloat(buf[i]);
+        }
+        r.ns[BENCH_TO_FLOAT] = std::min(r.ns[BENCH_TO_FLOAT], Elapsed(start));
+
+        start = std::chrono::steady_clock::now();
+        for(int i = 0; i < BENCH_SAMPLES; i++)
+        {
+            r.codec[i] = Sample<T>::ToCodec24(buf[i]);
+        }
+        r.ns[BENCH_TO_CODEC] = std::min(r.ns[BENCH_TO_CODEC], Elapsed(start));
+        sink = r.codec[BENCH_SAMPLES - 1];
+    }
+    return r;
+}
+
+static void Accuracy(const char* name, const Result& ref, const Result& r)
+{
+    double  signal = 0.0, noise = 0.0;
+    int32_t max_lsb = 0;
+    for(int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        double d = (double)r.out[i] - ref.out[i];
+        signal += (double)ref.out[i] * ref.out[i];
+        noise += d * d;
+        max_lsb = std::max(max_lsb, std::abs(r.codec[i] - ref.codec[i]));
+    }
+    printf("%-6s snr %6.1f dB, noise floor %7.1f dBFS, codec words within "
+           "%d LSB\n",
+           name,
+           10.0 * log10(signal / noise),
+           10.0 * log10(noise / BENCH_SAMPLES + 1e-30),
+           max_lsb);
+}
+
+int main()
+{
+    Input  in  = MakeInput();
+    Result f   = Run<float>(in);
+    Result q31 = Run<q31_t>(in);
+    Result q15 = Run<q15_t>(in);
+
+    printf("ns/sample, block %d\n", BENCH_BLOCK);
+    printf("%-10s %10s %10s %10s\n", "stage", "float", "q31", "q15");
+    double total[3] = {0.0, 0.0, 0.0};
+    for(int s = 0; s < NUM_BENCH_STAGES; s++)
+    {
+        printf("%-10s %10.2f %10.2f %10.2f\n",
+               stage_names[s],
+               f.ns[s],
+               q31.ns[s],
+               q15.ns[s]);
+        total[0] += f.ns[s];
+        total[1] += q31.ns[s];
+        total[2] += q15.ns[s];
+    }
+    printf("%-10s %10.2f %10.2f %10.2f\n\n",
+           "total",
+           total[0],
+           total[1],
+           total[2]);
+
+    Accuracy("q31", f, q31);
+    Accuracy("q15", f, q15);
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Knob acquisition report (KnobFilter, dub.h): ADC readings of a knob with
+// Gaussian noise go through KnobHandler::Acquire at the scan rate of the
+// Seed. For each noise level it counts the value changes, each of which
+// is a control frame and a coefficient update downstream, with the knob at
+// rest and while it turns, and measures the tracking error and the time to
+// settle at the end of the travel. Exits with an error when a resting knob
+// still produces changes or an end is not reached.
+//
+// usage: knob_check
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "dub.h"
+
+#define SCAN_RATE (1000000 / KNOB_SCAN_PERIOD_US)
+#define ADC_STEPS 65535.0f // 16-bit conversions
+#define GATED_NOISE 0.002f // Noise up to which a resting knob must be silent
+
+static const float noise_levels[] = {0.0005f, 0.001f, 0.002f, 0.004f};
+
+class NoisyKnob
+{
+  public:
+    NoisyKnob(float sigma) : rng(1234), noise(0.0f, sigma) {}
+
+    // One conversion of the knob at pos, clipped and quantized like the ADC
+    float Read(float pos)
+    {
+        float raw = fclamp(pos + this->noise(this->rng), 0.0f, 1.0f);
+        return roundf(raw * ADC_STEPS) / ADC_STEPS;
+    }
+
+  private:
+    std::mt19937                    rng;
+    std::normal_distribution<float> noise;
+};
+
+struct Result
+{
+    int   raw_changes;  // Readings that differ from the previous one
+    int   changes;      // Filtered value changes
+    float max_error;    // Largest distance from the knob position
+    float final_value;
+};
+
+// Knob path pos(t) over seconds, the handler primed at pos(0)
+template <typename Path>
+static Result Run(float sigma, float seconds, Path pos, float error_from = 0)
+{
+    NoisyKnob   knob(sigma);
+    KnobHandler handler;
+    Result      r    = {0, 0, 0.0f, 0.0f};
+    float       prev = knob.Read(pos(0.0f));
+    handler.Acquire(0, prev);
+
+    int scans = (int)(seconds * SCAN_RATE);
+    for(int i = 1; i <= scans; i++)
+    {
+        float t   = (float)i / SCAN_RATE;
+        float raw = knob.Read(pos(t));
+        r.raw_changes += raw != prev;
+        r.changes += handler.Acquire(0, raw);
+        prev = raw;
+        if(t >= error_from)
+        {
+            r.max_error
+                = fmaxf(r.max_error, fabsf(handler.Values[0] - pos(t)));
+        }
+    }
+    r.final_value = handler.Values[0];
+    return r;
+}
+
+// Milliseconds from the start of a 10 ms turn from 0 to 1 until the value
+// reaches 1
+static float SettleMs(float sigma)
+{
+    NoisyKnob   knob(sigma);
+    KnobHandler handler;
+    handler.Acquire(0, knob.Read(0.0f));
+    for(int i = 1; i < SCAN_RATE; i++)
+    {
+        float t = (float)i / SCAN_RATE;
+        handler.Acquire(0, knob.Read(fminf(t / 0.01f, 1.0f)));
+        if(handler.Values[0] == 1.0f)
+        {
+            return 1000.0f * t;
+        }
+    }
+    return -1.0f;
+}
+
+int main(int argc, char** argv)
+{
+    int failures = 0;
+
+    printf("knob scans at %d Hz, smoothing %.3f per scan, dead band %.4f\n",
+           SCAN_RATE,
+           KNOB_SMOOTHING,
+           KNOB_HYSTERESIS);
+    printf("%-7s %17s %10s %15s %17s %9s %9s\n",
+           "noise",
+           "rest raw/changes",
+           "rest err",
+           "ends",
+           "turn 2 s changes",
+           "turn err",
+           "settle");
+
+    for(float sigma : noise_levels)
+    {
+        // 10 s at rest mid travel, 1 s at each end, a slow turn over 2 s
+        Result rest = Run(sigma, 10.0f, [](float t) { return 0.5f; });
+        Result low  = Run(sigma, 1.0f, [](float t) { return 0.0f; });
+        Result high = Run(sigma, 1.0f, [](float t) { return 1.0f; });
+        Result turn = Run(
+            sigma,
+            2.5f,
+            [](float t) { return fminf(t / 2.0f, 1.0f); },
+            0.05f);
+        float settle = SettleMs(sigma);
+
+        bool ok = low.final_value == 0.0f && high.final_value == 1.0f
+                  && turn.final_value == 1.0f && settle >= 0.0f;
+        if(sigma <= GATED_NOISE)
+        {
+            ok &= rest.changes == 0 && low.changes == 0 && high.changes == 0;
+        }
+
+        char rest_counts[32], ends[32];
+        snprintf(rest_counts,
+                 sizeof(rest_counts),
+                 "%d/%d",
+                 rest.raw_changes,
+                 rest.changes);
+        snprintf(ends,
+                 sizeof(ends),
+                 "%.3f %.3f",
+                 low.final_value,
+                 high.final_value);
+        printf("%-7.4f %17s %10.4f %15s %17d %9.4f %7.1fms %s\n",
+               sigma,
+               rest_counts,
+               rest.max_error,
+               ends,
+               turn.changes,
+               turn.max_error,
+               settle,
+               ok ? "" : "FAIL");
+        failures += !ok;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+// Benchmark of the audio modes (dub.h): callback cost per sample at each
+// block size and control interval, its overhead against the largest
+// block, and the latency from a trigger press to the output.
+//
+// Latency model of the Seed: the callback for the block starting at
+// sample b runs at time b and its output plays from b + block (double
+// buffered DMA). A press seen by the main loop at time p is published
+// with ControlTimestamp, p + block, so it lands in the next callback at
+// its exact sample. "no timer" publishes for the start of the next block
+// instead, the behaviour without a microsecond timer. Button debouncing,
+// the main loop period and the codec delay come on top.
+//
+// usage: latency_bench
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "sim_handlers.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_SECONDS 2.0
+#define BENCH_RUNS 5 // Best of, against scheduling noise
+#define WARMUP_BLOCKS 2
+#define LATENCY_BLOCKS 4 // Rendered after the press, enough for the onset
+
+struct Setting
+{
+    int block_size;
+    int control_interval;
+    int mode; // Index in audio_modes when it is that mode, else -1
+};
+
+static const Setting settings[] = {
+    {1, 1, -1},
+    {2, 2, -1},
+    {4, 4, DUB_MODE_LOW_LATENCY},
+    {16, 16, -1},
+    {32, 16, DUB_MODE_BALANCED},
+    {64, 32, -1},
+    {128, 32, DUB_MODE_HEAVY_FX},
+    {256, 32, -1},
+    {256, 256, -1}, // Reference for the overhead
+};
+
+static void SetKnobs()
+{
+    sim_knobs.Values[VolumeKnob] = 0.8f;
+    sim_knobs.Values[DecayKnob]  = 0.4f;
+    sim_knobs.Values[DepthKnob]  = 0.6f;
+    sim_knobs.Values[TuneKnob]   = 0.5f;
+    sim_knobs.Values[SweepKnob]  = 0.8f;
+    sim_knobs.Values[RateKnob]   = 0.45f;
+}
+
+// Host nanoseconds per output sample, trigger held, best of BENCH_RUNS
+static double Measure(const Setting& st)
+{
+    size_t             total = (size_t)(BENCH_SECONDS * BENCH_SAMPLE_RATE);
+    std::vector<float> left(st.block_size), right(st.block_size);
+    float*             out[2] = {left.data(), right.data()};
+    double             best   = 1e300;
+
+    for(int run = 0; run < BENCH_RUNS; run++)
+    {
+        ResetSim(BENCH_SAMPLE_RATE, st.block_size, 1, st.control_interval);
+        SetKnobs();
+        sim_buttons.TriggerHeld[0] = true;
+        SimControlTick(0);
+
+        auto start = std::chrono::steady_clock::now();
+        for(size_t pos = 0; pos < total; pos += st.block_size)
+        {
+            AudioCallback(nullptr, out, st.block_size);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(
+            best,
+            std::chrono::duration<double, std::nano>(stop - start).count());
+    }
+    return best / total;
+}
+
+// Samples from a press at offset samples into a callback period to the
+// first non-silent output sample, both in playback time
+static int Latency(const Setting& st, int offset, bool timer)
+{
+    int bs = st.block_size;
+    ResetSim(BENCH_SAMPLE_RATE, bs, 1, st.control_interval);
+    SetKnobs();
+
+    std::vector<float> left(bs), right(bs);
+    float*             out[2] = {left.data(), right.data()};
+    uint32_t           press  = WARMUP_BLOCKS * bs + offset;
+
+    for(int k = 0; k < WARMUP_BLOCKS + 1 + LATENCY_BLOCKS; k++)
+    {
+        uint32_t block_start = k * bs;
+        if(k == WARMUP_BLOCKS + 1)
+        {
+            // The press happened while the previous block was playing
+            sim_buttons.TriggerHeld[0] = true;
+            SimControlTick(timer ? press + bs : block_start);
+        }
+        else
+        {
+            SimControlTick(block_start);
+        }
+        AudioCallback(nullptr, out, bs);
+
+        for(int i = 0; i < bs; i++)
+        {
+            if(left[i] != 0.0f)
+            {
+                return (int)(block_start + i + bs - press);
+            }
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    SimFlushDenormals();
+
+    // All timings first, the reference last, so that each one runs on a
+    // warm cache
+    const int count = sizeof(settings) / sizeof(Setting);
+    double    ns[count];
+    for(int i = 0; i < count; i++)
+    {
+        ns[i] = Measure(settings[i]);
+    }
+    const Setting& reference = settings[count - 1];
+    double         ref_ns    = ns[count - 1];
+    double         budget    = 1e9 / BENCH_SAMPLE_RATE;
+
+    printf("%-12s %6s %5s %10s %10s %7s %10s %10s %9s\n",
+           "mode",
+           "block",
+           "ctrl",
+           "ns/sample",
+           "overhead",
+           "budget",
+           "timer",
+           "no timer",
+           "worst ms");
+
+    int failures = 0;
+    for(int i = 0; i < count; i++)
+    {
+        const Setting& st = settings[i];
+
+        int lo[2] = {1 << 30, 1 << 30};
+        int hi[2] = {0, 0};
+        for(int offset = 0; offset < st.block_size; offset++)
+        {
+            for(int t = 0; t < 2; t++)
+            {
+                int latency = Latency(st, offset, t == 0);
+                if(latency < 0)
+                {
+                    failures++;
+                    continue;
+                }
+                lo[t] = std::min(lo[t], latency);
+                hi[t] = std::max(hi[t], latency);
+            }
+        }
+
+        char timer[32], no_timer[32];
+        snprintf(timer, sizeof(timer), "%d-%d", lo[0], hi[0]);
+        snprintf(no_timer, sizeof(no_timer), "%d-%d", lo[1], hi[1]);
+        printf("%-12s %6d %5d %10.2f %10.2f %6.2f%% %10s %10s %9.3f\n",
+               st.mode >= 0 ? audio_modes[st.mode].name : "",
+               st.block_size,
+               st.control_interval,
+               ns[i],
+               ns[i] - ref_ns,
+               100.0 * ns[i] / budget,
+               timer,
+               no_timer,
+               1e3 * std::max(hi[0], hi[1]) / BENCH_SAMPLE_RATE);
+    }
+
+    printf("latency: samples from press to playback, min-max over the press "
+           "offsets; overhead against block %d\n",
+           reference.block_size);
+    if(failures)
+    {
+        printf("%d press(es) never reached the output\n", failures);
+        return 1;
+    }
+    return 0;
+}
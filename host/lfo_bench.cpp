@@ -0,0 +1,297 @@
+// Compares the vectorised Lfo (dub.h, simd.h) with the one it replaced,
+// eight DaisySP Oscillator objects with a waveform switch per sample, kept
+// here as ReferenceLfo.
+//
+// Accuracy: both run side by side at slow, medium and the fastest rate,
+// with a new trigger every 37 ms, each restarting the phases as the engine
+// does, a voice index past the panel buttons now and then, and the bank
+// flipping every half second, so every voice, both banks and the
+// crossfade are covered. The phases advance identically, so what is left
+// is the sine: FastSinTurns against sinf. It is also checked on its own
+// against the double precision sine over a dense grid of phases.
+//
+// Cost: ns per sample of the reference and of the vector bank through the
+// per-sample call and the block call at the block sizes of the audio
+// modes, steady in bank A and crossfading in bank B. make SIMD=scalar lfo
+// times the per-voice scalar path the Seed builds.
+//
+// Exits with an error when either difference is above BENCH_MAX_ERROR.
+//
+// usage: lfo_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#include "sim_handlers.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_SAMPLES (1 << 20)
+#define BENCH_MAX_ERROR 1e-6 // Output and sine, absolute
+#define ACCURACY_SECONDS 10
+
+static const float rates[]       = {0.5f, 7.0f, LFO_MAX_FREQ};
+static const int   block_sizes[] = {1, 4, 32, 128};
+
+// The Lfo before the vector bank, same interface
+class ReferenceLfo
+{
+  public:
+    ReferenceLfo(int sample_rate)
+    {
+        for(int i = 0; i < 4; i++)
+        {
+            this->osc[i].Init(sample_rate);
+            this->osc[i].SetWaveform(Oscillator::WAVE_SIN);
+            this->osc[i].SetAmp(1.0f);
+            this->osc_harm[i].Init(sample_rate);
+            this->osc_harm[i].SetWaveform(Oscillator::WAVE_SIN);
+        }
+        this->prevIndex    = -1;
+        this->currIndex    = -1;
+        this->fadeProgress = 1.0f;
+        this->fadeRate     = 1.0f / (sample_rate * LFO_FADE_TIME);
+    }
+
+    void SetFreqAll(float freq)
+    {
+        static const float harm_ratios[4] = {4.0f, 8.0f, 8.0f, 2.0f};
+        for(int i = 0; i < 4; i++)
+        {
+            this->osc[i].SetFreq(freq);
+            this->osc_harm[i].SetFreq(freq * harm_ratios[i]);
+        }
+    }
+
+    void ResetPhaseAll()
+    {
+        for(int i = 0; i < 4; i++)
+        {
+            this->osc[i].Reset(0.0f);
+            this->osc_harm[i].Reset(0.0f);
+        }
+    }
+
+    std::pair<float, float> ProcessAll(const Triggers& triggers)
+    {
+        int  index = triggers.LastIndex % NUM_TRIGGERS;
+        bool bankB = triggers.IsBankSelectActive;
+        if(index != this->currIndex)
+        {
+            this->prevIndex    = this->currIndex;
+            this->currIndex    = index;
+            this->fadeProgress = 0.0f;
+        }
+        this->fadeProgress = fminf(this->fadeProgress + this->fadeRate, 1.0f);
+
+        float out = 0.0f;
+        if(this->currIndex >= 0)
+        {
+            this->UpdateWaveforms(this->currIndex, bankB);
+            out += this->Mix(this->currIndex, bankB) * this->fadeProgress;
+        }
+        if(this->prevIndex >= 0 && this->fadeProgress < 1.0f)
+        {
+            this->UpdateWaveforms(this->prevIndex, bankB);
+            out += this->Mix(this->prevIndex, bankB)
+                   * (1.0f - this->fadeProgress);
+        }
+        return std::make_pair(out, 0.5f + out);
+    }
+
+    void ProcessBlock(float* buf, size_t n, const Triggers& triggers)
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            buf[i] = this->ProcessAll(triggers).second;
+        }
+    }
+
+  private:
+    void UpdateWaveforms(int index, bool bankB)
+    {
+        static const int bank_a[4] = {Oscillator::WAVE_SIN,
+                                      Oscillator::WAVE_SQUARE,
+                                      Oscillator::WAVE_SAW,
+                                      Oscillator::WAVE_RAMP};
+        static const int bank_b[4] = {Oscillator::WAVE_SIN,
+                                      Oscillator::WAVE_SQUARE,
+                                      Oscillator::WAVE_SQUARE,
+                                      Oscillator::WAVE_RAMP};
+        static const int harm_b[4] = {Oscillator::WAVE_SIN,
+                                      Oscillator::WAVE_SQUARE,
+                                      Oscillator::WAVE_SAW,
+                                      Oscillator::WAVE_RAMP};
+        if(bankB)
+        {
+            this->osc[index].SetWaveform(bank_b[index]);
+            this->osc_harm[index].SetWaveform(harm_b[index]);
+        }
+        else
+        {
+            this->osc[index].SetWaveform(bank_a[index]);
+        }
+    }
+
+    float Mix(int index, bool bankB)
+    {
+        float base = this->osc[index].Process();
+        if(!bankB)
+        {
+            return base;
+        }
+        float harm = this->osc_harm[index].Process();
+        return index == 3 ? 0.5f * (base + 0.5f * harm)
+                          : 0.5f * (base + harm);
+    }
+
+    Oscillator osc[4];
+    Oscillator osc_harm[4];
+    int        prevIndex;
+    int        currIndex;
+    float      fadeProgress;
+    float      fadeRate;
+};
+
+static volatile float sink;
+
+static double SineError()
+{
+    const int points = 1 << 20;
+    double    worst  = 0.0;
+    for(int i = 0; i <= points; i += 4)
+    {
+        float turns[4];
+        for(int k = 0; k < 4; k++)
+        {
+            turns[k] = (float)std::min(i + k, points) / points;
+        }
+        float sine[4];
+        FastSinTurns(Vec4::Load(turns)).Store(sine);
+        for(int k = 0; k < 4; k++)
+        {
+            double exact = sin(2.0 * M_PI * turns[k]);
+            worst        = std::max(worst, fabs(sine[k] - exact));
+        }
+    }
+    return worst;
+}
+
+// Both LFOs through the same triggers, largest output difference
+static double OutputError(float rate)
+{
+    Lfo          lfo(BENCH_SAMPLE_RATE);
+    ReferenceLfo reference(BENCH_SAMPLE_RATE);
+    Triggers     triggers;
+    lfo.RateValue = rate;
+    lfo.UpdateControls();
+    reference.SetFreqAll(rate);
+
+    const int trigger_period = BENCH_SAMPLE_RATE * 37 / 1000;
+    const int bank_period    = BENCH_SAMPLE_RATE / 2;
+    double    worst          = 0.0;
+    for(int i = 0; i < ACCURACY_SECONDS * BENCH_SAMPLE_RATE; i++)
+    {
+        if(i % trigger_period == 0)
+        {
+            int press                   = i / trigger_period;
+            triggers.LastIndex          = press % 7 == 6 ? 5 : press % 4;
+            triggers.IsBankSelectActive = (i / bank_period) & 1;
+            lfo.ResetPhaseAll();
+            reference.ResetPhaseAll();
+        }
+        std::pair<float, float> a = lfo.ProcessAll(triggers);
+        std::pair<float, float> b = reference.ProcessAll(triggers);
+        worst = std::max(worst, (double)fabsf(a.first - b.first));
+        worst = std::max(worst, (double)fabsf(a.second - b.second));
+    }
+    return worst;
+}
+
+// ns per sample, a new trigger every 50 ms when crossfading
+template <typename L>
+static double Time(L& lfo, bool crossfade, int block_size)
+{
+    Triggers triggers;
+    triggers.IsBankSelectActive = crossfade;
+    float buf[MAX_BLOCK_SIZE];
+
+    auto start = std::chrono::steady_clock::now();
+    for(int pos = 0; pos < BENCH_SAMPLES; pos += block_size)
+    {
+        if(crossfade)
+        {
+            triggers.LastIndex
+                = (pos / (BENCH_SAMPLE_RATE / 20)) % NUM_TRIGGERS;
+        }
+        if(block_size == 1)
+        {
+            buf[0] = lfo.ProcessAll(triggers).second;
+        }
+        else
+        {
+            lfo.ProcessBlock(buf, block_size, triggers);
+        }
+        sink = buf[0];
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / BENCH_SAMPLES;
+}
+
+int main()
+{
+    SimFlushDenormals();
+    int failures = 0;
+
+    double sine_error = SineError();
+    printf("FastSinTurns (%s): max error %.3g against sin\n",
+           SimdName(),
+           sine_error);
+    failures += sine_error > BENCH_MAX_ERROR ? 1 : 0;
+
+    printf("\n%-10s %12s\n", "rate Hz", "max error");
+    for(float rate : rates)
+    {
+        double error = OutputError(rate);
+        printf("%-10.1f %12.3g%s\n",
+               rate,
+               error,
+               error > BENCH_MAX_ERROR ? "  FAIL" : "");
+        failures += error > BENCH_MAX_ERROR ? 1 : 0;
+    }
+
+    printf("\n%-26s %6s %14s %14s %8s\n",
+           "case",
+           "block",
+           "reference ns",
+           "vector ns",
+           "speedup");
+    for(int crossfade = 0; crossfade < 2; crossfade++)
+    {
+        for(int bs : block_sizes)
+        {
+            Lfo          lfo(BENCH_SAMPLE_RATE);
+            ReferenceLfo reference(BENCH_SAMPLE_RATE);
+            lfo.RateValue = 7.0f;
+            lfo.UpdateControls();
+            reference.SetFreqAll(7.0f);
+
+            double ref_ns = Time(reference, crossfade, bs);
+            double vec_ns = Time(lfo, crossfade, bs);
+            printf("%-26s %6d %14.2f %14.2f %7.2fx\n",
+                   crossfade ? "bank B, crossfading" : "bank A, steady",
+                   bs,
+                   ref_ns,
+                   vec_ns,
+                   ref_ns / vec_ns);
+        }
+    }
+
+    if(failures > 0)
+    {
+        fprintf(stderr, "%d checks above %.0e\n", failures, BENCH_MAX_ERROR);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "midi_file.h"
+
+#define MIDI_DEFAULT_TEMPO 500000 // Microseconds per quarter note, 120 BPM
+
+// Big endian reads with bounds checks: past the end of the chunk every
+// read returns 0 and clears ok
+class ChunkReader
+{
+  public:
+    ChunkReader(const std::vector<uint8_t>& data, size_t pos, size_t end)
+    : data(data)
+    {
+        this->pos = pos;
+        this->end = std::min(end, data.size());
+        this->ok  = true;
+    }
+
+    bool     AtEnd() const { return this->pos >= this->end; }
+    bool     Ok() const { return this->ok; }
+    uint8_t  Byte()
+    {
+        if(this->pos >= this->end)
+        {
+            this->ok = false;
+            return 0;
+        }
+        return this->data[this->pos++];
+    }
+    uint32_t Word(int bytes)
+    {
+        uint32_t value = 0;
+        for(int i = 0; i < bytes; i++)
+        {
+            value = (value << 8) | this->Byte();
+        }
+        return value;
+    }
+    // Variable length quantity, 7 bits per byte, at most 4 bytes
+    uint32_t Var()
+    {
+        uint32_t value = 0;
+        for(int i = 0; i < 4; i++)
+        {
+            uint8_t b = this->Byte();
+            value     = (value << 7) | (b & 0x7F);
+            if(!(b & 0x80))
+            {
+                return value;
+            }
+        }
+        this->ok = false;
+        return value;
+    }
+    void Skip(uint32_t n)
+    {
+        if(n > this->end - this->pos)
+        {
+            this->ok  = false;
+            this->pos = this->end;
+            return;
+        }
+        this->pos += n;
+    }
+
+  private:
+    const std::vector<uint8_t>& data;
+    size_t                      pos, end;
+    bool                        ok;
+};
+
+struct TickEvent
+{
+    uint64_t      tick;
+    MidiFileEvent event;
+};
+
+struct TempoChange
+{
+    uint64_t tick;
+    uint32_t us_per_quarter;
+};
+
+// One MTrk chunk: channel messages into events, tempo changes into tempos
+static bool ReadTrack(ChunkReader&              track,
+                      std::vector<TickEvent>&   events,
+                      std::vector<TempoChange>& tempos)
+{
+    uint64_t tick    = 0;
+    uint8_t  running = 0;
+    while(!track.AtEnd() && track.Ok())
+    {
+        tick += track.Var();
+        uint8_t b = track.Byte();
+        if(b == 0xFF)
+        {
+            uint8_t  type   = track.Byte();
+            uint32_t length = track.Var();
+            if(type == 0x51 && length == 3)
+            {
+                TempoChange tempo = {tick, track.Word(3)};
+                tempos.push_back(tempo);
+            }
+            else
+            {
+                track.Skip(length);
+            }
+            running = 0; // Meta and system exclusive events cancel it
+            if(type == 0x2F)
+            {
+                break; // End of track
+            }
+            continue;
+        }
+        if(b == 0xF0 || b == 0xF7)
+        {
+            track.Skip(track.Var());
+            running = 0;
+            continue;
+        }
+
+        TickEvent ev;
+        ev.tick = tick;
+        uint8_t first;
+        if(b & 0x80)
+        {
+            running = b;
+            first   = track.Byte();
+        }
+        else if(running != 0)
+        {
+            first = b;
+        }
+        else
+        {
+            return false; // Data byte without a status
+        }
+        int type          = running & 0xF0;
+        ev.event.bytes[0] = running;
+        ev.event.bytes[1] = first;
+        ev.event.bytes[2] = 0;
+        ev.event.size     = 2;
+        if(type != 0xC0 && type != 0xD0)
+        {
+            ev.event.bytes[2] = track.Byte();
+            ev.event.size     = 3;
+        }
+        events.push_back(ev);
+    }
+    return track.Ok();
+}
+
+bool MidiFile::Load(const std::string& path, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    return this->Parse(data, error);
+}
+
+bool MidiFile::Parse(const std::vector<uint8_t>& data, std::string& error)
+{
+    this->events.clear();
+
+    ChunkReader header(data, 0, data.size());
+    uint32_t    id     = header.Word(4);
+    uint32_t    length = header.Word(4);
+    if(id != 0x4D546864 || length < 6) // "MThd"
+    {
+        error = "not a standard MIDI file";
+        return false;
+    }
+    uint32_t format   = header.Word(2);
+    uint32_t tracks   = header.Word(2);
+    uint32_t division = header.Word(2);
+    bool     smpte    = (division & 0x8000) != 0;
+    if(!header.Ok() || format > 1 || (smpte ? division & 0xFF : division) == 0)
+    {
+        error = "unsupported MIDI file format";
+        return false;
+    }
+
+    std::vector<TickEvent>   events;
+    std::vector<TempoChange> tempos;
+    size_t                   pos = 8 + (size_t)length;
+    for(uint32_t found = 0; found < tracks; pos += 8 + (size_t)length)
+    {
+        ChunkReader chunk(data, pos, data.size());
+        id     = chunk.Word(4);
+        length = chunk.Word(4);
+        if(!chunk.Ok())
+        {
+            error = "truncated MIDI file";
+            return false;
+        }
+        if(id != 0x4D54726B) // "MTrk", other chunks are skipped
+        {
+            continue;
+        }
+        ChunkReader track(data, pos + 8, pos + 8 + length);
+        if(!ReadTrack(track, events, tempos))
+        {
+            error = "bad track " + std::to_string(found + 1);
+            return false;
+        }
+        found++;
+    }
+
+    // Merged in time, track order for events sharing a tick
+    std::stable_sort(events.begin(),
+                     events.end(),
+                     [](const TickEvent& a, const TickEvent& b) {
+                         return a.tick < b.tick;
+                     });
+    std::stable_sort(tempos.begin(),
+                     tempos.end(),
+                     [](const TempoChange& a, const TempoChange& b) {
+                         return a.tick < b.tick;
+                     });
+
+    // Ticks to seconds through the tempo map, or at a fixed rate with
+    // SMPTE division: frames per second times ticks per frame
+    double   frame_rate   = 256 - (division >> 8);
+    double   smpte_tick   = 1.0 / (frame_rate * (division & 0xFF));
+    size_t   next_tempo   = 0;
+    uint64_t segment_tick = 0;
+    double   segment_time = 0.0;
+    double   tick_seconds = MIDI_DEFAULT_TEMPO * 1e-6 / division;
+    for(TickEvent& ev : events)
+    {
+        if(smpte)
+        {
+            ev.event.time = ev.tick * smpte_tick;
+        }
+        else
+        {
+            while(next_tempo < tempos.size()
+                  && tempos[next_tempo].tick <= ev.tick)
+            {
+                const TempoChange& tempo = tempos[next_tempo++];
+                segment_time += (tempo.tick - segment_tick) * tick_seconds;
+                segment_tick = tempo.tick;
+                tick_seconds = tempo.us_per_quarter * 1e-6 / division;
+            }
+            ev.event.time
+                = segment_time + (ev.tick - segment_tick) * tick_seconds;
+        }
+        this->events.push_back(ev.event);
+    }
+    return true;
+}
+
+double MidiFile::Duration() const
+{
+    return this->events.empty() ? 0.0 : this->events.back().time;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Standard MIDI file reader for the host renderer.
+//
+// Formats 0 and 1, metrical (ticks per quarter note, with the tempo
+// changes of any track) and SMPTE time division, running status. The
+// channel messages of every track come out merged in time order, each as
+// the bytes a MIDI port would deliver, status byte included. Meta events
+// and system exclusive messages are skipped.
+
+struct MidiFileEvent
+{
+    double  time; // Seconds from the start of the file
+    uint8_t bytes[3];
+    int     size;
+};
+
+class MidiFile
+{
+  public:
+    std::vector<MidiFileEvent> events;
+
+    // Returns false and fills error on a file it cannot read
+    bool   Load(const std::string& path, std::string& error);
+    bool   Parse(const std::vector<uint8_t>& data, std::string& error);
+    double Duration() const; // Time of the last event
+};
@@ -0,0 +1,146 @@
+// CPU budget report for the oversampled VCO to VCF section.
+//
+// Renders a heavy FM scenario (full LFO depth and rate, sweep release) at
+// every oversampling factor and block size and reports the callback time
+// per sample against the real-time budget of the sample rate. Host times
+// are scaled by --scale to estimate the Seed: measure the load at 1x on
+// the Seed (DEBUG prints it) and pass the ratio to the host figure.
+//
+// usage: oversampling_budget [--scale S] [--rate R]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "sim_handlers.h"
+
+#define BUDGET_SECONDS 4.0
+#define BUDGET_GATE_SECONDS 1.0
+
+static const int factors[]     = {1, 2, 4};
+static const int block_sizes[] = {4, 16, 48, 128, 256};
+
+// Host nanoseconds per output sample of the callback
+static double Measure(int sample_rate, int block_size, int oversampling)
+{
+    ResetSim(sample_rate, block_size, oversampling);
+    sim_knobs.Values[VolumeKnob] = 0.8f;
+    sim_knobs.Values[DecayKnob]  = 0.5f;
+    sim_knobs.Values[DepthKnob]  = 1.0f;
+    sim_knobs.Values[TuneKnob]   = 0.7f;
+    sim_knobs.Values[SweepKnob]  = 0.9f;
+    sim_knobs.Values[RateKnob]   = 0.8f;
+
+    size_t             total = (size_t)(BUDGET_SECONDS * sample_rate);
+    size_t             gate  = (size_t)(BUDGET_GATE_SECONDS * sample_rate);
+    std::vector<float> left(block_size), right(block_size);
+    float*             out[2] = {left.data(), right.data()};
+    double             ns     = 0.0;
+
+    for(size_t pos = 0; pos < total; pos += block_size)
+    {
+        sim_buttons.TriggerHeld[0] = pos < gate;
+        SimControlTick(pos);
+
+        auto start = std::chrono::steady_clock::now();
+        AudioCallback(nullptr, out, block_size);
+        auto stop = std::chrono::steady_clock::now();
+        ns += std::chrono::duration<double, std::nano>(stop - start).count();
+    }
+    return ns / total;
+}
+
+// Worst gain in dB of the decimation chain over the band that folds into
+// the audible range, measured with sines at the oversampled rate
+static double Rejection(int sample_rate, int oversampling)
+{
+    HalfbandDecimator stage_4x, stage_2x;
+    stage_4x.Init(DECIMATOR_4X_COEFS, DECIMATOR_4X_TRANSITION);
+    stage_2x.Init(DECIMATOR_COEFS, DECIMATOR_TRANSITION);
+
+    const int          n    = 8192;
+    double             rate = (double)sample_rate * oversampling;
+    double             worst = -1000.0;
+    std::vector<float> buf(n * oversampling);
+
+    // Every tone above the output Nyquist that folds back below 20 kHz
+    for(double f = sample_rate / 2.0; f < rate / 2; f += 250.0)
+    {
+        double folded = fabs(f - sample_rate * floor(f / sample_rate + 0.5));
+        if(folded >= 20000.0)
+        {
+            continue;
+        }
+        for(size_t i = 0; i < buf.size(); i++)
+        {
+            buf[i] = (float)sin(2.0 * M_PI * f * i / rate);
+        }
+        stage_4x.Reset();
+        stage_2x.Reset();
+        if(oversampling == 4)
+        {
+            stage_4x.Process(buf.data(), buf.data(), 2 * n);
+        }
+        stage_2x.Process(buf.data(), buf.data(), n);
+
+        float peak = 0.0f;
+        for(int i = n / 2; i < n; i++)
+        {
+            peak = fmaxf(peak, fabsf(buf[i]));
+        }
+        worst = fmax(worst, 20.0 * log10(peak + 1e-12));
+    }
+    return worst;
+}
+
+int main(int argc, char** argv)
+{
+    double scale       = 1.0;
+    int    sample_rate = 48000;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--scale") && i + 1 < argc)
+            scale = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--rate") && i + 1 < argc)
+            sample_rate = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: oversampling_budget [--scale S] "
+                            "[--rate R]\n");
+            return 2;
+        }
+    }
+
+    SimFlushDenormals();
+    double budget = 1e9 / sample_rate;
+    printf("budget at %d Hz: %.1f ns/sample, host times x %.2f\n\n",
+           sample_rate,
+           budget,
+           scale);
+    printf("%-8s %-8s %12s %10s %12s\n",
+           "factor",
+           "block",
+           "ns/sample",
+           "load",
+           "rejection");
+
+    for(int factor : factors)
+    {
+        double rejection = factor > 1 ? Rejection(sample_rate, factor) : 0.0;
+        for(int block_size : block_sizes)
+        {
+            double ns   = Measure(sample_rate, block_size, factor) * scale;
+            double load = 100.0 * ns / budget;
+            printf("%-8d %-8d %12.1f %9.1f%% ", factor, block_size, ns, load);
+            if(factor > 1)
+                printf("%9.1f dB", rejection);
+            else
+                printf("%12s", "-");
+            printf("%s\n", load > 100.0 ? "  over budget" : "");
+        }
+    }
+    return 0;
+}
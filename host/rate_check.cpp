@@ -0,0 +1,211 @@
+// Checks that the siren plays the same at 48 kHz and 96 kHz: envelope
+// attack and release, LFO rate, LFO crossfade and VCO pitch, measured on an
+// engine built at each rate and on one switched from 48 kHz to 96 kHz with
+// SetSampleRate after a first run. Exits 1 when a reading is off the 48 kHz
+// one by more than the tolerance.
+//
+// usage: rate_check
+
+#include <cmath>
+#include <cstdio>
+
+#include "sim_handlers.h"
+
+#define TIME_TOLERANCE 0.01 // Relative, two samples of the shortest times
+#define PITCH_TOLERANCE 2.0 // Cents
+
+struct Readings
+{
+    double attack;    // Seconds from the press to half level
+    double release;   // Seconds from the release to -20 dB
+    double lfo_rate;  // Hz
+    double crossfade; // Seconds from a new trigger to the end of the fade
+    double pitch;     // Hz of the output
+};
+
+// Rising crossings of a level, interpolated between samples, for a rate
+class CrossingCounter
+{
+  public:
+    CrossingCounter(float level)
+    {
+        this->level = level;
+        this->prev  = level;
+        this->count = 0;
+        this->first = 0.0;
+        this->last  = 0.0;
+    }
+
+    void Add(float x, double t, double dt)
+    {
+        if(this->prev < this->level && x >= this->level)
+        {
+            double at = t - dt * (x - this->level) / (x - this->prev);
+            if(this->count == 0)
+            {
+                this->first = at;
+            }
+            this->last = at;
+            this->count++;
+        }
+        this->prev = x;
+    }
+
+    double Rate() const
+    {
+        return this->count > 1 ? (this->count - 1) / (this->last - this->first)
+                               : 0.0;
+    }
+
+  private:
+    float  level, prev;
+    int    count;
+    double first, last;
+};
+
+// Scans the buttons and knobs into a frame for the next callback
+static void Tick(SirenEngine& engine)
+{
+    engine.ScanControls();
+    engine.PublishControls(engine.SampleCount());
+}
+
+// One sample through the callback, the debug outputs then hold its values
+static float Step(SirenEngine& engine)
+{
+    float  left, right;
+    float* out[2] = {&left, &right};
+    engine.AudioCallback(nullptr, out, 1);
+    return left;
+}
+
+static Readings Measure(SirenEngine& engine)
+{
+    double dt = 1.0 / engine.sample_rate;
+    int    n1 = engine.sample_rate; // Samples per second
+
+    // No LFO on the pitch and no sweep, dry output for the pitch reading
+    engine.knobs.Values[VolumeKnob] = 0.8f;
+    engine.knobs.Values[DecayKnob]  = 0.4f;
+    engine.knobs.Values[DepthKnob]  = 0.0f;
+    engine.knobs.Values[TuneKnob]   = 0.5f;
+    engine.knobs.Values[SweepKnob]  = 0.5f;
+    engine.knobs.Values[RateKnob]   = 0.45f;
+    engine.delay.MixValue           = 0.0f;
+    engine.reverb.MixValue          = 0.0f;
+    for(int i = 0; i < MAX_TRIGGERS; i++)
+    {
+        engine.buttons.TriggerHeld[i] = false;
+    }
+    Tick(engine);
+    for(int i = 0; i < n1 / 10; i++)
+    {
+        Step(engine);
+    }
+
+    // Held for 2 s: attack, then LFO and pitch once the attack is over
+    Readings        r;
+    CrossingCounter lfo(0.5f), pitch(0.0f);
+    r.attack                      = -1.0;
+    engine.buttons.TriggerHeld[0] = true;
+    Tick(engine);
+    for(int i = 0; i < 2 * n1; i++)
+    {
+        float  out = Step(engine);
+        double t   = i * dt;
+        if(r.attack < 0.0 && engine.adsr_output >= 0.5f)
+        {
+            r.attack = t;
+        }
+        if(t >= 0.5)
+        {
+            lfo.Add(engine.lfo_output.second, t, dt);
+            pitch.Add(out, t, dt);
+        }
+    }
+    r.lfo_rate = lfo.Rate();
+    r.pitch    = pitch.Rate();
+
+    // A second trigger takes over the LFO with a crossfade
+    r.crossfade                   = -1.0;
+    engine.buttons.TriggerHeld[1] = true;
+    Tick(engine);
+    for(int i = 0; i < n1 / 2; i++)
+    {
+        Step(engine);
+        if(r.crossfade < 0.0 && engine.lfo.fadeProgress >= 1.0f)
+        {
+            r.crossfade = (i + 1) * dt;
+        }
+    }
+
+    r.release                     = -1.0;
+    float held                    = engine.adsr_output;
+    engine.buttons.TriggerHeld[0] = false;
+    engine.buttons.TriggerHeld[1] = false;
+    Tick(engine);
+    for(int i = 0; i < 10 * n1 && r.release < 0.0; i++)
+    {
+        Step(engine);
+        if(engine.adsr_output < 0.1f * held)
+        {
+            r.release = (i + 1) * dt;
+        }
+    }
+    return r;
+}
+
+static bool CheckTime(const char* name, double ref, double x)
+{
+    bool ok = ref > 0.0 && fabs(x - ref) <= TIME_TOLERANCE * ref;
+    printf("  %-10s %10.5f %10.5f  %+7.3f%% %s\n",
+           name,
+           ref,
+           x,
+           100.0 * (x - ref) / ref,
+           ok ? "" : "FAIL");
+    return ok;
+}
+
+static bool Compare(const char* title, const Readings& ref, const Readings& r)
+{
+    printf("%s\n", title);
+    bool ok = CheckTime("attack s", ref.attack, r.attack);
+    ok &= CheckTime("release s", ref.release, r.release);
+    ok &= CheckTime("lfo Hz", ref.lfo_rate, r.lfo_rate);
+    ok &= CheckTime("fade s", ref.crossfade, r.crossfade);
+
+    double cents = 1200.0 * log2(r.pitch / ref.pitch);
+    bool   pitch = fabs(cents) <= PITCH_TOLERANCE;
+    printf("  %-10s %10.3f %10.3f  %+6.2f ct %s\n",
+           "pitch Hz",
+           ref.pitch,
+           r.pitch,
+           cents,
+           pitch ? "" : "FAIL");
+    return ok && pitch;
+}
+
+// Engines share no state: each rate gets its own
+static SirenEngine at_48k, at_96k, switched;
+
+int main(int argc, char** argv)
+{
+    SimFlushDenormals();
+
+    at_48k.Init(48000, 1, 1);
+    at_96k.Init(96000, 1, 1);
+    Readings ref   = Measure(at_48k);
+    Readings fresh = Measure(at_96k);
+
+    switched.Init(48000, 1, 1);
+    Measure(switched);
+    switched.SetSampleRate(96000);
+    Readings after = Measure(switched);
+
+    printf("%-12s %10s %10s %9s\n", "", "48 kHz", "96 kHz", "diff");
+    bool ok = Compare("96 kHz engine", ref, fresh);
+    ok &= Compare("48 kHz engine switched to 96 kHz", ref, after);
+    printf("%s\n", ok ? "same behaviour at both rates" : "rates differ");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,722 @@
+// Golden-output regression suite: renders every scenario script through the
+// real AudioCallback and compares it with the checked-in golden summaries,
+// or with reference renders stored locally.
+//
+// usage: regression [options] scenario.txt...
+//   --golden FILE        compare with the golden summaries in FILE
+//   --write-golden FILE  render and write the golden summaries to FILE
+//   --write-reference    render and store reference renders instead
+//   --ref-dir DIR        reference directory (default reference)
+//   --exact              require bit-exact output, for paths that must not
+//                        move
+//   --max-abs X          largest allowed sample difference (default 1e-3),
+//                        reference renders only
+//   --level-db X         largest allowed peak or RMS change in dB
+//                        (default 0.1), golden summaries only
+//   --spectral-db X      largest allowed mean log-spectral distance in dB
+//                        (default 0.5)
+//   --cents X            largest allowed pitch error in cents (default 2)
+//   -r RATE, -b SIZE, -p, -o FACTOR  render settings, as in dub_host
+//
+// The golden summaries (make regress) are the canonical check: a text file
+// in the repository with, per scenario, a hash of the samples, the peak
+// and RMS level, and per frame the pitch and the level of each octave
+// band. They only change through make golden, so a change of the sound
+// shows up in the diff of the file. Reference renders (make reference,
+// then make compare) are full WAVs kept out of the repository, for A/B
+// comparisons against a local tree, sample by sample.
+//
+// A scenario fails when any metric is over its tolerance, and the exit
+// status is 1 when any scenario fails.
+//
+// The spectral distance is the RMS difference of the Hann-windowed dB
+// spectra, floored at -100 dBFS, averaged over the frames where either
+// render is audible. The pitch error follows the strongest partial of the
+// reference into the same neighbourhood of the compared render, so small
+// tuning drifts show up even where the waveforms are far apart sample-wise.
+// The SNR column, reference power over difference power, is the noise
+// floor of a fixed point build (make SAMPLE_FORMAT=q31) against float
+// references. In the summaries the spectral distance is over the octave
+// bands rather than the bins, and the pitch the one of each frame.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "sim_handlers.h"
+#include "spectrum.h"
+#include "timeline.h"
+#include "wav_writer.h"
+
+#define FRAME_SIZE 2048
+#define FRAME_HOP 1024
+#define FLOOR_DB -100.0
+#define AUDIBLE_DB -80.0 // Frame level below which a frame is skipped
+#define PITCH_DB -60.0   // Partial level below which pitch isn't compared
+#define PITCH_SEARCH_BINS 3
+#define BANDS 9 // Octave bands of the summaries, up to 125 Hz and on
+
+static const double band_edges[BANDS - 1]
+    = {125.0, 250.0, 500.0, 1000.0, 2000.0, 4000.0, 8000.0, 16000.0};
+
+typedef void (*Callback)(AudioHandle::InputBuffer  in,
+                         AudioHandle::OutputBuffer out,
+                         size_t                    size);
+
+struct Settings
+{
+    int  sample_rate;
+    int  block_size;
+    int  oversampling;
+    bool per_sample;
+};
+
+struct Tolerances
+{
+    bool   exact;
+    double max_abs;
+    double level_db;
+    double spectral_db;
+    double cents;
+};
+
+struct Metrics
+{
+    bool   identical;
+    double snr_db; // Reference power over difference power
+    double max_abs;
+    double level_db; // Largest peak or RMS change, summaries only
+    double spectral_db;
+    double cents;
+};
+
+// One frame of a golden summary
+struct FrameSummary
+{
+    double pitch_hz; // Strongest partial, 0 below PITCH_DB
+    double band_db[BANDS];
+};
+
+// What the golden file keeps of a render
+struct Summary
+{
+    int                       sample_rate;
+    size_t                    samples;
+    uint32_t                  hash; // FNV-1a of the samples
+    double                    peak_db;
+    double                    rms_db;
+    std::vector<FrameSummary> frames;
+};
+
+// Same main loop and interrupt interleaving as dub_host
+static void Render(Timeline&           timeline,
+                   const Settings&     settings,
+                   std::vector<float>& left,
+                   std::vector<float>& right)
+{
+    SimFlushDenormals();
+    ResetSim(settings.sample_rate, settings.block_size, settings.oversampling);
+    sim_knobs.InitAll();
+    sim_buttons.InitAll();
+    timeline.Rewind();
+
+    Callback callback
+        = settings.per_sample ? AudioCallbackPerSample : AudioCallback;
+    size_t total = (size_t)ceil(timeline.Duration() * settings.sample_rate);
+    left.assign(total, 0.0f);
+    right.assign(total, 0.0f);
+
+    for(size_t pos = 0; pos < total; pos += settings.block_size)
+    {
+        size_t n = std::min((size_t)settings.block_size, total - pos);
+        SimControlTick(pos);
+        while(llround(timeline.NextTime() * settings.sample_rate)
+              < (long long)(pos + n))
+        {
+            double time = timeline.NextTime();
+            timeline.ApplyUntil(time);
+            SimControlTick((uint32_t)llround(time * settings.sample_rate));
+        }
+        float* out[2] = {&left[pos], &right[pos]};
+        callback(nullptr, out, n);
+    }
+}
+
+// dB magnitude spectrum of one frame, 0 dB for a full scale sine
+static void Spectrum(const float* x, std::vector<double>& db)
+{
+    std::vector<std::complex<double>> bins(FRAME_SIZE);
+    for(int i = 0; i < FRAME_SIZE; i++)
+    {
+        bins[i] = x[i] * Hann(i, FRAME_SIZE);
+    }
+    Fft(bins);
+    db.resize(FRAME_SIZE / 2);
+    for(int k = 0; k < FRAME_SIZE / 2; k++)
+    {
+        double mag = std::abs(bins[k]) * 4.0 / FRAME_SIZE;
+        db[k]      = std::max(20.0 * log10(mag + 1e-30), FLOOR_DB);
+    }
+}
+
+// Peak bin position refined by a parabola through its neighbours
+static double PeakBin(const std::vector<double>& db, int lo, int hi)
+{
+    int peak = lo;
+    for(int k = lo; k <= hi; k++)
+    {
+        peak = db[k] > db[peak] ? k : peak;
+    }
+    if(peak <= 0 || peak >= (int)db.size() - 1)
+    {
+        return peak;
+    }
+    double a = db[peak - 1], b = db[peak], c = db[peak + 1];
+    double d = a - 2.0 * b + c;
+    return d < 0.0 ? peak + 0.5 * (a - c) / d : peak;
+}
+
+static Metrics Compare(const std::vector<float>& ref_left,
+                       const std::vector<float>& ref_right,
+                       const std::vector<float>& left,
+                       const std::vector<float>& right)
+{
+    Metrics m;
+    m.identical = memcmp(ref_left.data(), left.data(), left.size() * 4) == 0
+                  && memcmp(ref_right.data(), right.data(), right.size() * 4)
+                         == 0;
+    m.max_abs     = 0.0;
+    m.spectral_db = 0.0;
+    m.cents       = 0.0;
+    double signal = 0.0, noise = 0.0;
+    for(size_t i = 0; i < left.size(); i++)
+    {
+        double dl = (double)ref_left[i] - left[i];
+        double dr = (double)ref_right[i] - right[i];
+        m.max_abs = std::max(m.max_abs, std::max(fabs(dl), fabs(dr)));
+        signal += (double)ref_left[i] * ref_left[i]
+                  + (double)ref_right[i] * ref_right[i];
+        noise += dl * dl + dr * dr;
+    }
+    m.snr_db = noise > 0.0 ? 10.0 * log10(signal / noise) : INFINITY;
+
+    std::vector<double> ref_db, db;
+    double              lsd_sum = 0.0;
+    int                 frames  = 0;
+    for(size_t pos = 0; pos + FRAME_SIZE <= left.size(); pos += FRAME_HOP)
+    {
+        Spectrum(&ref_left[pos], ref_db);
+        Spectrum(&left[pos], db);
+        double ref_peak = *std::max_element(ref_db.begin() + 1, ref_db.end());
+        double peak     = *std::max_element(db.begin() + 1, db.end());
+        if(std::max(ref_peak, peak) < AUDIBLE_DB)
+        {
+            continue;
+        }
+
+        double sq = 0.0;
+        for(size_t k = 1; k < db.size(); k++)
+        {
+            double d = ref_db[k] - db[k];
+            sq += d * d;
+        }
+        lsd_sum += sqrt(sq / (db.size() - 1));
+        frames++;
+
+        // Pitch of the strongest reference partial, followed into the
+        // compared frame. DC and the lowest bins are left out.
+        int    last    = (int)db.size() - 2;
+        double ref_bin = PeakBin(ref_db, 2, last);
+        int    k       = (int)(ref_bin + 0.5);
+        if(k < 2 + PITCH_SEARCH_BINS || ref_db[k] < PITCH_DB)
+        {
+            continue;
+        }
+        double bin = PeakBin(db,
+                             k - PITCH_SEARCH_BINS,
+                             std::min(k + PITCH_SEARCH_BINS, last));
+        if(db[(int)(bin + 0.5)] < PITCH_DB)
+        {
+            continue;
+        }
+        m.cents = std::max(m.cents, fabs(1200.0 * log2(bin / ref_bin)));
+    }
+    m.spectral_db = frames > 0 ? lsd_sum / frames : 0.0;
+    return m;
+}
+
+static double Db(double x)
+{
+    return std::max(20.0 * log10(x + 1e-30), FLOOR_DB);
+}
+
+static Summary Summarize(const std::vector<float>& left,
+                         const std::vector<float>& right,
+                         int                       sample_rate)
+{
+    Summary sum;
+    sum.sample_rate = sample_rate;
+    sum.samples     = left.size();
+    sum.hash        = 2166136261u;
+    double peak = 0.0, energy = 0.0;
+    for(size_t i = 0; i < left.size(); i++)
+    {
+        float sample[2] = {left[i], right[i]};
+        for(float x : sample)
+        {
+            peak = std::max(peak, (double)fabsf(x));
+            energy += (double)x * x;
+            uint32_t bits;
+            memcpy(&bits, &x, sizeof(bits));
+            sum.hash = (sum.hash ^ bits) * 16777619u;
+        }
+    }
+    sum.peak_db = Db(peak);
+    sum.rms_db  = Db(left.empty() ? 0.0 : sqrt(energy / (2 * left.size())));
+
+    // Frames side by side, the same analysis as Compare
+    std::vector<double> db;
+    double              bin_hz = (double)sample_rate / FRAME_SIZE;
+    for(size_t pos = 0; pos + FRAME_SIZE <= left.size(); pos += FRAME_SIZE)
+    {
+        Spectrum(&left[pos], db);
+        FrameSummary frame;
+        double       power[BANDS] = {};
+        for(size_t k = 1; k < db.size(); k++)
+        {
+            int band = 0;
+            while(band < BANDS - 1 && k * bin_hz >= band_edges[band])
+            {
+                band++;
+            }
+            power[band] += pow(10.0, db[k] / 10.0);
+        }
+        for(int b = 0; b < BANDS; b++)
+        {
+            frame.band_db[b] = std::max(10.0 * log10(power[b]), FLOOR_DB);
+        }
+
+        // Left out as in Compare: partials in the lowest bins or too quiet
+        int    last = (int)db.size() - 2;
+        double bin  = PeakBin(db, 2, last);
+        int    k    = (int)(bin + 0.5);
+        frame.pitch_hz
+            = k >= 2 + PITCH_SEARCH_BINS && db[k] >= PITCH_DB ? bin * bin_hz
+                                                               : 0.0;
+        sum.frames.push_back(frame);
+    }
+    return sum;
+}
+
+static Metrics CompareSummary(const Summary& ref, const Summary& got)
+{
+    Metrics m;
+    m.identical   = got.hash == ref.hash;
+    m.snr_db      = 0.0;
+    m.max_abs     = 0.0;
+    m.level_db    = std::max(fabs(got.peak_db - ref.peak_db),
+                             fabs(got.rms_db - ref.rms_db));
+    m.spectral_db = 0.0;
+    m.cents       = 0.0;
+
+    double lsd_sum = 0.0;
+    int    frames  = 0;
+    for(size_t i = 0; i < ref.frames.size(); i++)
+    {
+        const FrameSummary& r = ref.frames[i];
+        const FrameSummary& g = got.frames[i];
+        double ref_peak = *std::max_element(r.band_db, r.band_db + BANDS);
+        double peak     = *std::max_element(g.band_db, g.band_db + BANDS);
+        if(std::max(ref_peak, peak) < AUDIBLE_DB)
+        {
+            continue;
+        }
+
+        double sq = 0.0;
+        for(int b = 0; b < BANDS; b++)
+        {
+            double d = r.band_db[b] - g.band_db[b];
+            sq += d * d;
+        }
+        lsd_sum += sqrt(sq / BANDS);
+        frames++;
+
+        if(r.pitch_hz > 0.0 && g.pitch_hz > 0.0)
+        {
+            double cents = fabs(1200.0 * log2(g.pitch_hz / r.pitch_hz));
+            m.cents      = std::max(m.cents, cents);
+        }
+    }
+    m.spectral_db = frames > 0 ? lsd_sum / frames : 0.0;
+    return m;
+}
+
+// One "scenario" line per render, then one "frame" line per frame:
+//   scenario NAME RATE SAMPLES HASH PEAK_DB RMS_DB
+//   frame PITCH_HZ BAND_DB...
+static bool WriteGolden(const std::string&                    path,
+                        const std::map<std::string, Summary>& summaries)
+{
+    FILE* f = fopen(path.c_str(), "w");
+    if(!f)
+    {
+        return false;
+    }
+    fprintf(f,
+            "# Golden summaries of the regression scenarios, written by\n"
+            "# make -C host golden. Review changes to this file as changes\n"
+            "# of the sound.\n"
+            "# scenario NAME RATE SAMPLES HASH PEAK_DB RMS_DB\n"
+            "# frame PITCH_HZ BAND_DB... (octave bands up to 125 Hz, 250 "
+            "Hz... 16 kHz, above)\n");
+    for(const auto& entry : summaries)
+    {
+        const Summary& sum = entry.second;
+        fprintf(f,
+                "scenario %s %d %zu %08x %.3f %.3f\n",
+                entry.first.c_str(),
+                sum.sample_rate,
+                sum.samples,
+                sum.hash,
+                sum.peak_db,
+                sum.rms_db);
+        for(const FrameSummary& frame : sum.frames)
+        {
+            fprintf(f, "frame %.4f", frame.pitch_hz);
+            for(int b = 0; b < BANDS; b++)
+            {
+                fprintf(f, " %.2f", frame.band_db[b]);
+            }
+            fprintf(f, "\n");
+        }
+    }
+    return fclose(f) == 0;
+}
+
+static bool ReadGolden(const std::string&              path,
+                       std::map<std::string, Summary>& summaries,
+                       std::string&                    error)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string line;
+    Summary*    current     = nullptr;
+    int         line_number = 0;
+    while(std::getline(file, line))
+    {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string        kind;
+        if(!(fields >> kind))
+        {
+            continue; // Blank or comment line
+        }
+        if(kind == "scenario")
+        {
+            std::string name, hash;
+            Summary     sum;
+            fields >> name >> sum.sample_rate >> sum.samples >> hash
+                >> sum.peak_db >> sum.rms_db;
+            sum.hash        = (uint32_t)strtoul(hash.c_str(), nullptr, 16);
+            summaries[name] = sum;
+            current         = &summaries[name];
+        }
+        else if(kind == "frame" && current)
+        {
+            FrameSummary frame;
+            fields >> frame.pitch_hz;
+            for(int b = 0; b < BANDS; b++)
+            {
+                fields >> frame.band_db[b];
+            }
+            current->frames.push_back(frame);
+        }
+        else
+        {
+            fields.setstate(std::ios::failbit);
+        }
+        if(fields.fail())
+        {
+            error = path + ": line " + std::to_string(line_number)
+                    + ": malformed";
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string ScenarioName(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    size_t start = slash == std::string::npos ? 0 : slash + 1;
+    size_t dot   = path.find_last_of('.');
+    if(dot == std::string::npos || dot < start)
+    {
+        dot = path.size();
+    }
+    return path.substr(start, dot - start);
+}
+
+static void Usage()
+{
+    fprintf(stderr,
+            "usage: regression [--golden file] [--write-golden file] "
+            "[--write-reference] [--ref-dir dir] [--exact] [--max-abs x] "
+            "[--level-db x] [--spectral-db x] [--cents x] [-r rate] "
+            "[-b block] [-p] [-o factor] scenario.txt...\n");
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    settings.sample_rate  = 48000;
+    settings.block_size   = 4;
+    settings.oversampling = 1;
+    settings.per_sample   = false;
+
+    Tolerances tol;
+    tol.exact       = false;
+    tol.max_abs     = 1e-3;
+    tol.level_db    = 0.1;
+    tol.spectral_db = 0.5;
+    tol.cents       = 2.0;
+
+    bool                     write_reference = false;
+    std::string              ref_dir         = "reference";
+    std::string              golden_path, write_golden_path;
+    std::vector<std::string> scripts;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--write-reference")
+            write_reference = true;
+        else if(arg == "--golden" && i + 1 < argc)
+            golden_path = argv[++i];
+        else if(arg == "--write-golden" && i + 1 < argc)
+            write_golden_path = argv[++i];
+        else if(arg == "--ref-dir" && i + 1 < argc)
+            ref_dir = argv[++i];
+        else if(arg == "--exact")
+            tol.exact = true;
+        else if(arg == "--max-abs" && i + 1 < argc)
+            tol.max_abs = atof(argv[++i]);
+        else if(arg == "--level-db" && i + 1 < argc)
+            tol.level_db = atof(argv[++i]);
+        else if(arg == "--spectral-db" && i + 1 < argc)
+            tol.spectral_db = atof(argv[++i]);
+        else if(arg == "--cents" && i + 1 < argc)
+            tol.cents = atof(argv[++i]);
+        else if(arg == "-r" && i + 1 < argc)
+            settings.sample_rate = atoi(argv[++i]);
+        else if(arg == "-b" && i + 1 < argc)
+            settings.block_size = atoi(argv[++i]);
+        else if(arg == "-p")
+            settings.per_sample = true;
+        else if(arg == "-o" && i + 1 < argc)
+            settings.oversampling = atoi(argv[++i]);
+        else if(arg[0] == '-')
+            Usage();
+        else
+            scripts.push_back(arg);
+    }
+    if(scripts.empty() || settings.block_size <= 0
+       || settings.block_size > MAX_BLOCK_SIZE)
+    {
+        Usage();
+    }
+
+    bool                           writing = write_reference
+                                   || !write_golden_path.empty();
+    std::map<std::string, Summary> golden;
+    std::string                    error;
+    if(!golden_path.empty() && !ReadGolden(golden_path, golden, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    if(!writing && !golden_path.empty())
+    {
+        printf("%-16s %6s %10s %12s %10s  %s\n",
+               "scenario",
+               "exact",
+               "level dB",
+               "spectral dB",
+               "cents",
+               "result");
+    }
+    else if(!writing)
+    {
+        printf("%-16s %6s %8s %12s %12s %10s  %s\n",
+               "scenario",
+               "exact",
+               "snr dB",
+               "max abs",
+               "spectral dB",
+               "cents",
+               "result");
+    }
+
+    int                            failed = 0;
+    std::map<std::string, Summary> summaries;
+    for(const std::string& script : scripts)
+    {
+        std::string name = ScenarioName(script);
+        std::string path = ref_dir + "/" + name + ".wav";
+        Timeline    timeline;
+        if(!timeline.Load(script, error))
+        {
+            fprintf(stderr, "%s: %s\n", script.c_str(), error.c_str());
+            return 2;
+        }
+
+        std::vector<float> left, right;
+        Render(timeline, settings, left, right);
+
+        if(!write_golden_path.empty())
+        {
+            summaries[name] = Summarize(left, right, settings.sample_rate);
+            continue;
+        }
+        if(write_reference)
+        {
+            WavWriter wav;
+            if(!wav.Open(path, settings.sample_rate, true))
+            {
+                fprintf(stderr, "cannot write %s\n", path.c_str());
+                return 2;
+            }
+            wav.Write(left.data(), right.data(), left.size());
+            wav.Close();
+            printf("wrote %s (%.2f s)\n",
+                   path.c_str(),
+                   (double)left.size() / settings.sample_rate);
+            continue;
+        }
+
+        Metrics m;
+        if(!golden_path.empty())
+        {
+            auto ref = golden.find(name);
+            if(ref == golden.end())
+            {
+                printf("%-16s not in %s\n", name.c_str(), golden_path.c_str());
+                failed++;
+                continue;
+            }
+            Summary sum = Summarize(left, right, settings.sample_rate);
+            if(ref->second.sample_rate != sum.sample_rate
+               || ref->second.samples != sum.samples
+               || ref->second.frames.size() != sum.frames.size())
+            {
+                printf("%-16s golden is %zu samples at %d Hz, render is %zu "
+                       "at %d Hz\n",
+                       name.c_str(),
+                       ref->second.samples,
+                       ref->second.sample_rate,
+                       sum.samples,
+                       sum.sample_rate);
+                failed++;
+                continue;
+            }
+            m = CompareSummary(ref->second, sum);
+        }
+        else
+        {
+            std::vector<float> ref_left, ref_right;
+            int                ref_rate = 0;
+            if(!ReadWav(path, ref_left, ref_right, ref_rate, error))
+            {
+                printf("%-16s %s\n", name.c_str(), error.c_str());
+                failed++;
+                continue;
+            }
+            if(ref_rate != settings.sample_rate
+               || ref_left.size() != left.size())
+            {
+                printf("%-16s reference is %zu samples at %d Hz, render is "
+                       "%zu at %d Hz\n",
+                       name.c_str(),
+                       ref_left.size(),
+                       ref_rate,
+                       left.size(),
+                       settings.sample_rate);
+                failed++;
+                continue;
+            }
+            m = Compare(ref_left, ref_right, left, right);
+        }
+
+        bool ok;
+        if(tol.exact)
+        {
+            ok = m.identical;
+        }
+        else if(!golden_path.empty())
+        {
+            ok = m.level_db <= tol.level_db && m.spectral_db <= tol.spectral_db
+                 && m.cents <= tol.cents;
+        }
+        else
+        {
+            ok = m.max_abs <= tol.max_abs && m.spectral_db <= tol.spectral_db
+                 && m.cents <= tol.cents;
+        }
+
+        if(!golden_path.empty())
+        {
+            printf("%-16s %6s %10.3f %12.3f %10.3f  %s\n",
+                   name.c_str(),
+                   m.identical ? "yes" : "no",
+                   m.level_db,
+                   m.spectral_db,
+                   m.cents,
+                   ok ? "ok" : "FAIL");
+        }
+        else
+        {
+            printf("%-16s %6s %8.1f %12.3g %12.3f %10.3f  %s\n",
+                   name.c_str(),
+                   m.identical ? "yes" : "no",
+                   m.snr_db,
+                   m.max_abs,
+                   m.spectral_db,
+                   m.cents,
+                   ok ? "ok" : "FAIL");
+        }
+        failed += ok ? 0 : 1;
+    }
+
+    if(!write_golden_path.empty())
+    {
+        if(!WriteGolden(write_golden_path, summaries))
+        {
+            fprintf(stderr, "cannot write %s\n", write_golden_path.c_str());
+            return 2;
+        }
+        printf("wrote %s (%zu scenarios)\n",
+               write_golden_path.c_str(),
+               summaries.size());
+    }
+    if(!writing)
+    {
+        printf("%d of %zu scenarios failed\n", failed, scripts.size());
+    }
+    return failed > 0 ? 1 : 0;
+}
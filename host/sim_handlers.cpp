@@ -0,0 +1,99 @@
+#include "sim_handlers.h"
+
+#if defined(__SSE__)
+#include <pmmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+SirenEngine       engine;
+KnobHandlerSim&   sim_knobs   = engine.knobs;
+ButtonHandlerSim& sim_buttons = engine.buttons;
+
+thread_local uint32_t SimHardware::now_us = 0;
+
+// KnobHandlerSim functions
+void KnobHandlerSim::InitAll() {}
+
+void KnobHandlerSim::UpdateAll() {}
+// KnobHandlerSim functions
+
+
+// ButtonHandlerSim functions
+void ButtonHandlerSim::InitAll() {}
+
+void ButtonHandlerSim::DebounceAll() {}
+
+void ButtonHandlerSim::UpdateAll()
+{
+    // The inputs from MIDI_TRIGGER_INPUT on belong to the MIDI notes
+    for(int i = 0; i < MIDI_TRIGGER_INPUT; i++)
+    {
+        bool held = this->TriggerHeld[i];
+        this->UpdateTrigger(i,
+                            held && !this->prevTriggerHeld[i],
+                            !held && this->prevTriggerHeld[i],
+                            held);
+        this->prevTriggerHeld[i] = held;
+    }
+
+    this->UpdateToggles(this->BankSelectHeld && !this->prevBankSelectHeld,
+                        this->SweepToTuneHeld && !this->prevSweepToTuneHeld);
+    this->prevBankSelectHeld  = this->BankSelectHeld;
+    this->prevSweepToTuneHeld = this->SweepToTuneHeld;
+}
+// ButtonHandlerSim functions
+
+
+void SimFlushDenormals()
+{
+#if defined(__SSE__)
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+#endif
+}
+
+void ResetSim(SirenEngine& target,
+              int          sample_rate,
+              int          block_size,
+              int          oversampling,
+              int          control_interval)
+{
+    target.Init(sample_rate, block_size, oversampling, control_interval);
+    target.knobs   = KnobHandlerSim();
+    target.buttons = ButtonHandlerSim();
+}
+
+void ResetSim(int sample_rate,
+              int block_size,
+              int oversampling,
+              int control_interval)
+{
+    ResetSim(engine, sample_rate, block_size, oversampling, control_interval);
+}
+
+void SimControlTick(uint32_t timestamp)
+{
+    engine.ScanControls();
+    engine.PublishControls(timestamp);
+}
+
+void AudioCallback(AudioHandle::InputBuffer  in,
+                   AudioHandle::OutputBuffer out,
+                   size_t                    size)
+{
+    engine.AudioCallback(in, out, size);
+}
+
+void AudioCallbackPerSample(AudioHandle::InputBuffer  in,
+                            AudioHandle::OutputBuffer out,
+                            size_t                    size)
+{
+    engine.AudioCallbackPerSample(in, out, size);
+}
+
+void AudioCallbackBlock(AudioHandle::InputBuffer  in,
+                        AudioHandle::OutputBuffer out,
+                        size_t                    size)
+{
+    engine.AudioCallbackBlock(in, out, size);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+
+#include "engine.h"
+
+// Simulated knobs: Values are written directly instead of read from ADC
+class KnobHandlerSim : public KnobHandler
+{
+  public:
+    void InitAll();
+    void UpdateAll();
+};
+
+// Simulated buttons: held states are written directly, edges are derived
+// the same way Switch reports them after debouncing
+class ButtonHandlerSim : public ButtonHandler
+{
+  public:
+    ButtonHandlerSim()
+    {
+        for(int i = 0; i < MAX_TRIGGERS; i++)
+        {
+            this->TriggerHeld[i]     = false;
+            this->prevTriggerHeld[i] = false;
+        }
+        this->BankSelectHeld      = false;
+        this->SweepToTuneHeld     = false;
+        this->prevBankSelectHeld  = false;
+        this->prevSweepToTuneHeld = false;
+    }
+
+    bool TriggerHeld[MAX_TRIGGERS];
+    bool BankSelectHeld;
+    bool SweepToTuneHeld;
+
+    void InitAll();
+    void DebounceAll();
+    void UpdateAll();
+
+  private:
+    bool prevTriggerHeld[MAX_TRIGGERS];
+    bool prevBankSelectHeld;
+    bool prevSweepToTuneHeld;
+};
+
+// Hardware policy of the engine on the host: simulated controls, the LFO
+// LED brightness kept for inspection, a simulated microsecond timer and
+// the delay and reverb lines on the heap
+class SimHardware
+{
+  public:
+    typedef KnobHandlerSim   Knobs;
+    typedef ButtonHandlerSim Buttons;
+
+    SimHardware()
+    : delay_buffer(2 * DELAY_BUFFER_SIZE), reverb_buffer(REVERB_BUFFER_SIZE)
+    {
+    }
+
+    void Init(int sample_rate) { this->led_lfo.Init(0, false, sample_rate); }
+    void SetLfoLed(float value) { this->led_lfo.Set(value); }
+    void SetToggleLeds(bool sweepToTune, bool bankSelect) {}
+
+    // Stays at 0, as without a timer, unless a tool advances it. One
+    // timer per thread, for the engines of the batch renderer.
+    static uint32_t              NowUs() { return now_us; }
+    static thread_local uint32_t now_us;
+
+    float* DelayBuffer() { return this->delay_buffer.data(); }
+    float* ReverbBuffer() { return this->reverb_buffer.data(); }
+
+    Led                led_lfo;
+    std::vector<float> delay_buffer;
+    std::vector<float> reverb_buffer;
+};
+
+typedef DubSirenEngine<SimHardware> SirenEngine;
+
+// The siren driven by the host tools, and its simulated controls
+extern SirenEngine       engine;
+extern KnobHandlerSim&   sim_knobs;
+extern ButtonHandlerSim& sim_buttons;
+
+// Flushes denormals to zero on x86 hosts. The Cortex-M7 FPU handles them
+// without a penalty, so host timings would otherwise be pessimistic.
+void SimFlushDenormals();
+
+// Recreates every component and clears the simulated controls. The
+// control interval is the one of the audio modes (dub.h), 0 = the block.
+// Without a target it resets the global engine.
+void ResetSim(SirenEngine& target,
+              int          sample_rate,
+              int          block_size,
+              int          oversampling     = 1,
+              int          control_interval = 0);
+void ResetSim(int sample_rate,
+              int block_size,
+              int oversampling     = 1,
+              int control_interval = 0);
+
+// Host equivalent of the hardware main loop: one pass of knob and button
+// scanning, publishing a control frame that applies at the given sample
+void SimControlTick(uint32_t timestamp);
+
+// Per-sample and block callbacks of the engine, for the tools that compare
+// the two paths whatever DUB_BLOCK_PROCESSING selects
+void AudioCallbackPerSample(AudioHandle::InputBuffer  in,
+                            AudioHandle::OutputBuffer out,
+                            size_t                    size);
+void AudioCallbackBlock(AudioHandle::InputBuffer  in,
+                        AudioHandle::OutputBuffer out,
+                        size_t                    size);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <utility>
+#include <vector>
+
+// Spectral analysis shared by the host tools (vco_bench, regression,
+// batch_render), so that all of them measure spectra the same way.
+
+// Hann window of an n point frame at sample i
+inline double Hann(size_t i, size_t n)
+{
+    return 0.5 - 0.5 * cos(2.0 * M_PI * i / n);
+}
+
+// In-place radix-2 FFT, x.size() a power of two
+inline void Fft(std::vector<std::complex<double>>& x)
+{
+    size_t n = x.size();
+    for(size_t i = 1, j = 0; i < n; i++)
+    {
+        size_t bit = n >> 1;
+        for(; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+        if(i < j)
+        {
+            std::swap(x[i], x[j]);
+        }
+    }
+    for(size_t len = 2; len <= n; len <<= 1)
+    {
+        std::complex<double> w(cos(-2.0 * M_PI / len), sin(-2.0 * M_PI / len));
+        for(size_t i = 0; i < n; i += len)
+        {
+            std::complex<double> wk(1.0, 0.0);
+            for(size_t k = 0; k < len / 2; k++)
+            {
+                std::complex<double> u = x[i + k];
+                std::complex<double> v = x[i + k + len / 2] * wk;
+                x[i + k]               = u + v;
+                x[i + k + len / 2]     = u - v;
+                wk *= w;
+            }
+        }
+    }
+}
@@ -0,0 +1,180 @@
+// Accuracy and speed report for the sweep trajectories (ExpRamp, dub.h).
+//
+// The decay envelope goes through a press and a release at several decay
+// and sweep knob settings, and Sweep turns it into cutoff exponents and
+// carrier trajectories block by block, as the callback does. The cutoff
+// exponents go through an ExpRamp as in the Vcf with the Svf engine (the
+// ZdfSvf reads them directly). Each sample is compared with the exact
+// curve, VcfExpToFreq or VcoExpToFreq of the exponent built from
+// CalculateFilterIntensity or CalculateVcoIntensity. Exits with an error
+// when a trajectory is off by more than SWEEP_RAMP_TOLERANCE.
+//
+// usage: sweep_check
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "dub.h"
+
+#define CHECK_SAMPLE_RATE 48000
+#define CHECK_PRESS_SECONDS 0.5f
+#define CHECK_SECONDS 4.0f
+#define BENCH_ROUNDS 20
+
+static const float  decay_knobs[] = {0.0f, 0.3f, 1.0f};
+static const float  sweep_knobs[] = {0.0f, 0.15f, 0.3f, 0.7f, 0.85f, 1.0f};
+static const size_t block_sizes[] = {4, 128};
+
+struct Error
+{
+    double cutoff_cents;
+    double pitch_cents;
+};
+
+// Envelope of one press and release, sampled at the callback rate
+static std::vector<float> Envelope(float decay)
+{
+    DecayEnvelope envelope(CHECK_SAMPLE_RATE);
+    envelope.ReleaseValue = decay;
+    envelope.UpdateControls();
+
+    size_t total = (size_t)(CHECK_SECONDS * CHECK_SAMPLE_RATE);
+    size_t press = (size_t)(CHECK_PRESS_SECONDS * CHECK_SAMPLE_RATE);
+
+    std::vector<float> adsr(total);
+    envelope.ProcessBlock(adsr.data(), press, true);
+    envelope.ProcessBlock(adsr.data() + press, total - press, false);
+    return adsr;
+}
+
+static double Cents(float got, float exact)
+{
+    return fabs(1200.0 * log2((double)got / exact));
+}
+
+static Error Check(const std::vector<float>& adsr, float sweep_knob, size_t bs)
+{
+    Sweep   sweep(CHECK_SAMPLE_RATE);
+    Vcf     vcf(CHECK_SAMPLE_RATE, 1);
+    ExpRamp cutoff_ramp(VcfExpToFreq, VCF_OCTAVES);
+    vcf.UpdateCutoffPressed(sweep_knob);
+    float tune = 0.4f;
+
+    // The exact curves, from the intensities of the sweep knob
+    float direction  = 2.0f * (sweep_knob - 0.5f);
+    float end_exp    = 0.5f - 0.5f * direction;
+    float filter_int = sweep.CalculateFilterIntensity(sweep_knob);
+    float vco_int    = sweep.CalculateVcoIntensity(sweep_knob);
+    float base_exp   = vcf.CutoffExponent;
+
+    Error              e = {0.0, 0.0};
+    std::vector<float> cutoff(bs), pitch(bs);
+    for(size_t pos = 0; pos + bs <= adsr.size(); pos += bs)
+    {
+        const float* a = adsr.data() + pos;
+        sweep.UpdateCutoffExpBlock(cutoff.data(), a, bs, sweep_knob, &vcf);
+        sweep.UpdateVcoFreqBlock(pitch.data(), a, bs, sweep_knob, tune);
+        for(size_t i = 0; i < bs; i++)
+        {
+            cutoff[i] = cutoff_ramp.Process(cutoff[i]);
+            float cutoff_exp
+                = base_exp + (end_exp - base_exp) * (1.0f - a[i]) * filter_int;
+            float pitch_exp
+                = tune + (end_exp - tune) * (1.0f - a[i]) * vco_int;
+            e.cutoff_cents = fmax(e.cutoff_cents,
+                                  Cents(cutoff[i], VcfExpToFreq(cutoff_exp)));
+            e.pitch_cents  = fmax(e.pitch_cents,
+                                 Cents(pitch[i], VcoExpToFreq(pitch_exp)));
+        }
+    }
+    return e;
+}
+
+// Host nanoseconds per sample of the cutoff trajectory, ramp against the
+// exponential mapping of every sample
+static void Bench(const std::vector<float>& adsr)
+{
+    const size_t       bs = 32;
+    Sweep              sweep(CHECK_SAMPLE_RATE);
+    Vcf                vcf(CHECK_SAMPLE_RATE, 1);
+    ExpRamp            ramp(VcfExpToFreq, VCF_OCTAVES);
+    std::vector<float> exps(adsr.size()), out(bs);
+    volatile float     sink = 0.0f; // Keeps the loops
+    vcf.UpdateCutoffPressed(0.9f);
+    sweep.UpdateCutoffExpBlock(
+        exps.data(), adsr.data(), adsr.size(), 0.9f, &vcf);
+
+    auto start = std::chrono::steady_clock::now();
+    for(int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for(size_t pos = 0; pos + bs <= exps.size(); pos += bs)
+        {
+            for(size_t i = 0; i < bs; i++)
+            {
+                out[i] = ramp.Process(exps[pos + i]);
+            }
+            sink += out[0];
+        }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for(int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for(size_t pos = 0; pos + bs <= exps.size(); pos += bs)
+        {
+            for(size_t i = 0; i < bs; i++)
+            {
+                out[i] = VcfExpToFreq(exps[pos + i]);
+            }
+            sink += out[0];
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double samples = (double)BENCH_ROUNDS * adsr.size();
+    printf("cutoff trajectory, block %zu: ramp %.2f ns/sample, "
+           "mapping %.2f ns/sample\n",
+           bs,
+           std::chrono::duration<double, std::nano>(mid - start).count()
+               / samples,
+           std::chrono::duration<double, std::nano>(stop - mid).count()
+               / samples);
+}
+
+int main(int argc, char** argv)
+{
+    int failures = 0;
+
+    printf("%-6s %-6s %6s %14s %14s\n",
+           "decay",
+           "sweep",
+           "block",
+           "cutoff cents",
+           "pitch cents");
+    for(float decay : decay_knobs)
+    {
+        std::vector<float> adsr = Envelope(decay);
+        for(float sweep_knob : sweep_knobs)
+        {
+            for(size_t bs : block_sizes)
+            {
+                Error e  = Check(adsr, sweep_knob, bs);
+                bool  ok = e.cutoff_cents <= SWEEP_RAMP_TOLERANCE
+                          && e.pitch_cents <= SWEEP_RAMP_TOLERANCE;
+                printf("%-6.2f %-6.2f %6zu %14.4f %14.4f %s\n",
+                       decay,
+                       sweep_knob,
+                       bs,
+                       e.cutoff_cents,
+                       e.pitch_cents,
+                       ok ? "" : "FAIL");
+                failures += !ok;
+            }
+        }
+    }
+    printf("tolerance %.2f cents\n", SWEEP_RAMP_TOLERANCE);
+
+    Bench(Envelope(0.3f));
+    return failures ? 1 : 0;
+}
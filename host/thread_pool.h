@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for the host batch tools.
+//
+// Run hands out the job indices of a batch in contiguous runs, one run per
+// worker queue. A worker takes its own jobs from the back of its queue and,
+// once that is empty, steals from the front of the others, so the jobs
+// that finish early do not leave cores idle while a long run is still
+// queued elsewhere. Each job also gets the index of the worker running it,
+// for state kept per worker such as an engine.
+class ThreadPool
+{
+  public:
+    // 0 threads = one per hardware thread
+    explicit ThreadPool(int threads = 0)
+    : queues(threads > 0 ? threads : DefaultThreads())
+    {
+        this->generation = 0;
+        this->pending    = 0;
+        this->stop       = false;
+        for(size_t i = 0; i < this->queues.size(); i++)
+        {
+            this->workers.emplace_back(&ThreadPool::Work, this, (int)i);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stop = true;
+        }
+        this->wake.notify_all();
+        for(std::thread& worker : this->workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int Size() const { return (int)this->queues.size(); }
+
+    // Runs job(index, worker) for every index below count and returns
+    // once all of them are done
+    void Run(size_t count, const std::function<void(size_t, int)>& job)
+    {
+        if(count == 0)
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(this->mutex);
+        size_t                       n = this->queues.size();
+        this->pending                  = count; // Before any job can finish
+        for(size_t w = 0; w < n; w++)
+        {
+            std::lock_guard<std::mutex> queue_lock(this->queues[w].mutex);
+            for(size_t i = count * w / n; i < count * (w + 1) / n; i++)
+            {
+                Task task = {i, &job};
+                this->queues[w].tasks.push_back(task);
+            }
+        }
+        this->generation++;
+        this->wake.notify_all();
+        this->done.wait(lock, [this] { return this->pending == 0; });
+    }
+
+  private:
+    typedef std::function<void(size_t, int)> Job;
+
+    // The job goes with each index: a worker still draining the queues
+    // when the next batch starts runs its jobs with the right function
+    struct Task
+    {
+        size_t     index;
+        const Job* job;
+    };
+
+    struct Queue
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    static int DefaultThreads()
+    {
+        int threads = (int)std::thread::hardware_concurrency();
+        return threads > 0 ? threads : 1;
+    }
+
+    // Own queue first, newest job first, then the oldest job of the others
+    bool Take(int worker, Task& task)
+    {
+        size_t n = this->queues.size();
+        for(size_t k = 0; k < n; k++)
+        {
+            size_t                      q = (worker + k) % n;
+            std::lock_guard<std::mutex> lock(this->queues[q].mutex);
+            std::deque<Task>&           tasks = this->queues[q].tasks;
+            if(tasks.empty())
+            {
+                continue;
+            }
+            if(k == 0)
+            {
+                task = tasks.back();
+                tasks.pop_back();
+            }
+            else
+            {
+                task = tasks.front();
+                tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void Work(int worker)
+    {
+        unsigned seen = 0;
+        for(;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->wake.wait(lock, [this, seen] {
+                    return this->stop || this->generation != seen;
+                });
+                if(this->stop)
+                {
+                    return;
+                }
+                seen = this->generation;
+            }
+
+            Task task;
+            while(this->Take(worker, task))
+            {
+                (*task.job)(task.index, worker);
+                if(this->pending.fetch_sub(1) == 1)
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->done.notify_all();
+                }
+            }
+        }
+    }
+
+    std::vector<Queue>       queues;
+    std::vector<std::thread> workers;
+    std::mutex               mutex; // Batch start, stop and completion
+    std::condition_variable  wake, done;
+    unsigned                 generation;
+    std::atomic<size_t>      pending;
+    bool                     stop;
+};
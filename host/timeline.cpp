@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "timeline.h"
+
+const char* const knob_names[NUM_ADC_CHANNELS]
+    = {"volume", "decay", "depth", "tune", "sweep", "rate"};
+
+static int FindName(const char* const* names, int count, const std::string& s)
+{
+    for(int i = 0; i < count; i++)
+    {
+        if(s == names[i])
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// "trigger1" to "triggerN", then the two toggles
+static int FindButton(const std::string& s)
+{
+    if(s == "bank")
+    {
+        return ButtonBankSelect;
+    }
+    if(s == "sweep_to_tune")
+    {
+        return ButtonSweepToTune;
+    }
+    int number = 0;
+    int length = 0;
+    if(sscanf(s.c_str(), "trigger%d%n", &number, &length) == 1
+       && length == (int)s.size() && number >= 1
+       && number <= MIDI_TRIGGER_INPUT)
+    {
+        return ButtonTrigger1 + number - 1;
+    }
+    return -1;
+}
+
+bool Timeline::Load(const std::string& path, std::string& error)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return this->Parse(text.str(), error);
+}
+
+bool Timeline::Parse(const std::string& text, std::string& error)
+{
+    std::istringstream lines(text);
+    std::string        line;
+    int                line_number = 0;
+
+    this->events.clear();
+    this->next = 0;
+
+    while(std::getline(lines, line))
+    {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string        kind, target;
+        TimelineEvent      event;
+        if(!(fields >> event.time))
+        {
+            if(line.find_first_not_of(" \t\r") == std::string::npos)
+            {
+                continue; // Blank or comment line
+            }
+            error = "line " + std::to_string(line_number) + ": bad time";
+            return false;
+        }
+        fields >> kind;
+        event.value  = 0.0f;
+        event.target = 0;
+
+        if(kind == "end")
+        {
+            event.type = EventEnd;
+        }
+        else if(kind == "knob")
+        {
+            fields >> target >> event.value;
+            event.type   = EventKnob;
+            event.target = FindName(knob_names, NUM_ADC_CHANNELS, target);
+            if(event.target < 0 || fields.fail())
+            {
+                error = "line " + std::to_string(line_number) + ": bad knob";
+                return false;
+            }
+        }
+        else if(kind == "press" || kind == "release")
+        {
+            fields >> target;
+            event.type   = kind == "press" ? EventPress : EventRelease;
+            event.target = FindButton(target);
+            if(event.target < 0)
+            {
+                error
+                    = "line " + std::to_string(line_number) + ": bad button";
+                return false;
+            }
+        }
+        else
+        {
+            error = "line " + std::to_string(line_number) + ": unknown event "
+                    + kind;
+            return false;
+        }
+        this->events.push_back(event);
+    }
+
+    // Keep script order for events sharing a timestamp
+    std::stable_sort(this->events.begin(),
+                     this->events.end(),
+                     [](const TimelineEvent& a, const TimelineEvent& b) {
+                         return a.time < b.time;
+                     });
+    return true;
+}
+
+double Timeline::Duration() const
+{
+    double duration = 0.0;
+    for(const TimelineEvent& event : this->events)
+    {
+        if(event.type == EventEnd)
+        {
+            return event.time;
+        }
+        duration = std::max(duration, event.time);
+    }
+    return duration;
+}
+
+double Timeline::NextTime() const
+{
+    if(this->next >= this->events.size())
+    {
+        return INFINITY;
+    }
+    return this->events[this->next].time;
+}
+
+void Timeline::ApplyUntil(double time)
+{
+    while(this->next < this->events.size()
+          && this->events[this->next].time <= time)
+    {
+        const TimelineEvent& event = this->events[this->next++];
+        bool                 held  = event.type == EventPress;
+
+        switch(event.type)
+        {
+            case EventKnob:
+                sim_knobs.Values[event.target] = event.value;
+                break;
+            case EventPress:
+            case EventRelease:
+                if(event.target < MAX_TRIGGERS)
+                {
+                    sim_buttons.TriggerHeld[event.target] = held;
+                }
+                else if(event.target == ButtonBankSelect)
+                {
+                    sim_buttons.BankSelectHeld = held;
+                }
+                else
+                {
+                    sim_buttons.SweepToTuneHeld = held;
+                }
+                break;
+            case EventEnd: break;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "sim_handlers.h"
+
+// Control timeline for the host renderer.
+//
+// A script is a text file with one event per line, sorted by time:
+//
+//   # time(s)  event    target    value
+//   0.0        knob     tune      0.5
+//   0.0        press    trigger1
+//   1.5        release  trigger1
+//   2.0        press    bank
+//   2.1        release  bank
+//   6.0        end
+//
+// Knobs: volume, decay, depth, tune, sweep, rate (raw position 0-1).
+// Buttons: trigger1-trigger4, bank, sweep_to_tune. trigger5 and up, to
+// MIDI_TRIGGER_INPUT, are the extra trigger inputs beyond the panel; the
+// inputs after them belong to the MIDI notes (dub_host -m).
+// "end" sets the render length. Blank lines and # comments are ignored.
+
+// Script names of the knobs, indexed by AdcChannel
+extern const char* const knob_names[NUM_ADC_CHANNELS];
+
+enum TimelineEventType
+{
+    EventKnob = 0,
+    EventPress,
+    EventRelease,
+    EventEnd,
+};
+
+enum TimelineButton
+{
+    ButtonTrigger1 = 0,
+    ButtonTrigger2,
+    ButtonTrigger3,
+    ButtonTrigger4,
+    ButtonBankSelect = MAX_TRIGGERS,
+    ButtonSweepToTune,
+};
+
+struct TimelineEvent
+{
+    double            time; // Seconds
+    TimelineEventType type;
+    int               target; // AdcChannel or TimelineButton
+    float             value;
+};
+
+class Timeline
+{
+  public:
+    Timeline() { this->next = 0; }
+
+    std::vector<TimelineEvent> events;
+
+    // Returns false and fills error on a malformed script
+    bool   Load(const std::string& path, std::string& error);
+    bool   Parse(const std::string& text, std::string& error);
+    double Duration() const;
+    double NextTime() const; // Time of the next pending event, or infinity
+    void   Rewind() { this->next = 0; }
+
+    // Applies every event up to and including time to the simulated
+    // knobs and buttons
+    void ApplyUntil(double time);
+
+  private:
+    size_t next;
+};
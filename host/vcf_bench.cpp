@@ -0,0 +1,300 @@
+// Compares the two VCF engines at the siren's resonance and drive
+// (VCF_RESONANCE, VCF_DRIVE): the DaisySP Svf and the ZdfSvf
+// (zdf_filter.h).
+//
+// Cost is measured with a fixed cutoff and with the cutoff moved every
+// sample along a sweep from VCF_MIN_FREQ to the top and back every 10 ms,
+// as Vcf::ProcessBlock does during a release. The cutoff of each sample is
+// precomputed in the form each engine takes, a frequency for the Svf and
+// an exponent for the ZdfSvf, so only the coefficient update and the
+// filter are timed.
+//
+// Stability: a square wave at the nominal level and four times over it
+// runs through each engine at 48 kHz and oversampled 2x and 4x, with the
+// cutoff held at points across the whole VCF_MIN_FREQ-VCF_MAX_FREQ range,
+// swept, and jumping to a random exponent every sample. A run is
+// unstable when its output is not finite or peaks above BENCH_MAX_PEAK.
+//
+// Accuracy of the ZdfSvf table: a quiet sine at the cutoff of exponents
+// midway between table entries, where the interpolation error peaks, must
+// come out 90 degrees late. The phase error over the slope of the
+// resonance gives the cutoff error in cents.
+//
+// Exits with an error when the ZdfSvf is unstable or its cutoff is off by
+// more than BENCH_MAX_CENTS.
+//
+// usage: vcf_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#else
+#define BENCH_HAS_TSC 0
+#endif
+
+#include "sim_handlers.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_SAMPLES (1 << 20)
+#define BENCH_MAX_PEAK 16.0f // Output level taken as a blow up
+#define BENCH_MAX_CENTS 1.0  // Cutoff error of the ZdfSvf table
+#define STABILITY_SECONDS 2.0f
+
+static const int   rates[]      = {48000, 96000, 192000};
+static const float input_amps[] = {0.7f, 2.8f};
+
+// Each engine behind the same calls; Map is the untimed part, the cutoff
+// of an exponent in the form Set takes
+struct SvfEngine
+{
+    const char* name;
+    Svf         filter;
+    float       max_freq;
+
+    SvfEngine(int sample_rate) : name("DaisySP Svf")
+    {
+        this->filter.Init(sample_rate);
+        this->filter.SetDrive(VCF_DRIVE);
+        this->filter.SetRes(VCF_RESONANCE);
+        this->max_freq = BENCH_SAMPLE_RATE / 4;
+    }
+    float Map(float exponent)
+    {
+        return fclamp(VcfExpToFreq(exponent), VCF_MIN_FREQ, this->max_freq);
+    }
+    void  Set(float freq) { this->filter.SetFreq(freq); }
+    float Process(float in)
+    {
+        this->filter.Process(in);
+        return this->filter.Low();
+    }
+};
+
+struct ZdfEngine
+{
+    const char* name;
+    ZdfSvf      filter;
+
+    ZdfEngine(int sample_rate) : name("ZdfSvf")
+    {
+        // Same settings as Vcf::SetSampleRate
+        float damping = 2.0f * (1.0f - powf(VCF_RESONANCE, 0.25f));
+        float drive   = 2.0f * fminf(VCF_DRIVE * 0.1f, 1.0f) * VCF_RESONANCE;
+        this->filter.Init(
+            sample_rate, VcfExpToFreq, BENCH_SAMPLE_RATE / 4, damping, drive);
+    }
+    float Map(float exponent) { return exponent; }
+    void  Set(float exponent) { this->filter.SetExponent(exponent); }
+    float Process(float in) { return this->filter.Tick(in); }
+};
+
+static volatile float sink;
+
+static float Square(int i, float amp)
+{
+    return (i % 128) < 64 ? amp : -amp; // 375 Hz at 48 kHz
+}
+
+template <typename Engine>
+static void Time(Engine& engine, bool sweep, double& ns, double& cycles)
+{
+    // Exponent from 0 to 1 and back every 10 ms
+    std::vector<float> cutoff(BENCH_SAMPLES);
+    int                half = (int)(0.005f * BENCH_SAMPLE_RATE);
+    for(int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        int   p   = i % (2 * half);
+        float t   = (float)(p < half ? p : 2 * half - p) / half;
+        cutoff[i] = engine.Map(sweep ? t : 0.7f);
+    }
+    engine.Set(cutoff[0]);
+
+    float acc   = 0.0f;
+    auto  start = std::chrono::steady_clock::now();
+#if BENCH_HAS_TSC
+    uint64_t tsc = __rdtsc();
+#endif
+    if(sweep)
+    {
+        for(int i = 0; i < BENCH_SAMPLES; i++)
+        {
+            engine.Set(cutoff[i]);
+            acc += engine.Process(Square(i, 0.7f));
+        }
+    }
+    else
+    {
+        for(int i = 0; i < BENCH_SAMPLES; i++)
+        {
+            acc += engine.Process(Square(i, 0.7f));
+        }
+    }
+#if BENCH_HAS_TSC
+    cycles = (double)(__rdtsc() - tsc) / BENCH_SAMPLES;
+#else
+    cycles = 0.0;
+#endif
+    auto stop = std::chrono::steady_clock::now();
+    sink      = acc;
+    ns = std::chrono::duration<double, std::nano>(stop - start).count()
+         / BENCH_SAMPLES;
+}
+
+// Peak output of one run, infinity when it is not finite
+template <typename Engine, typename Cutoff>
+static float Peak(int sample_rate, float amp, Cutoff cutoff)
+{
+    Engine engine(sample_rate);
+    float  peak = 0.0f;
+    int    n    = (int)(STABILITY_SECONDS * sample_rate);
+    int    os   = sample_rate / BENCH_SAMPLE_RATE; // Same tone at every rate
+    for(int i = 0; i < n; i++)
+    {
+        engine.Set(engine.Map(cutoff(i)));
+        float out = engine.Process(Square(i / os, amp));
+        if(!std::isfinite(out))
+        {
+            return INFINITY;
+        }
+        peak = fmaxf(peak, fabsf(out));
+    }
+    return peak;
+}
+
+// Highest peak over every setting at one rate and input level, and how
+// many runs blew up
+template <typename Engine>
+static float Stability(int sample_rate, float amp, int& unstable)
+{
+    std::vector<float> peaks;
+    for(int k = 0; k <= 20; k++)
+    {
+        float e = k / 20.0f;
+        peaks.push_back(
+            Peak<Engine>(sample_rate, amp, [e](int i) { return e; }));
+    }
+    int half = sample_rate / 200;
+    peaks.push_back(Peak<Engine>(sample_rate, amp, [half](int i) {
+        int p = i % (2 * half);
+        return (float)(p < half ? p : 2 * half - p) / half;
+    }));
+    std::mt19937                          rng(1234);
+    std::uniform_real_distribution<float> jump(0.0f, 1.0f);
+    peaks.push_back(Peak<Engine>(
+        sample_rate, amp, [&](int i) { return jump(rng); }));
+
+    float worst = 0.0f;
+    for(float p : peaks)
+    {
+        unstable += !(p <= BENCH_MAX_PEAK);
+        worst = fmaxf(worst, p);
+    }
+    return worst;
+}
+
+// Cutoff error in cents of the ZdfSvf at an exponent, from the phase of a
+// quiet sine at the exact cutoff: 90 degrees late at the cutoff, with
+// d(phase) / d(ln f) = -2 Q around it
+static double CutoffCents(int sample_rate, float exponent)
+{
+    ZdfEngine engine(sample_rate);
+    engine.Set(exponent);
+    double freq = VcfExpToFreq(exponent);
+    double w    = 2.0 * M_PI * freq / sample_rate;
+    double q    = 1.0 / (2.0 * (1.0 - pow(VCF_RESONANCE, 0.25)));
+
+    // Settles for 20 time constants of the resonance, then correlates
+    // over whole cycles
+    int    settle = (int)(20.0 * q / (M_PI * freq) * sample_rate);
+    int    cycles = (int)ceil(0.5 * freq);
+    int    n      = (int)(cycles * sample_rate / freq);
+    double re = 0.0, im = 0.0;
+    for(int i = 0; i < settle + n; i++)
+    {
+        float out = engine.Process(1e-4f * (float)sin(w * i));
+        if(i >= settle)
+        {
+            re += out * sin(w * i);
+            im += out * cos(w * i);
+        }
+    }
+    double late = -atan2(im, re); // Radians behind the input
+    return 1200.0 * (late - 0.5 * M_PI) / (2.0 * q) / M_LN2;
+}
+
+template <typename Engine>
+static void Report(int& failures, bool gated)
+{
+    Engine engine(BENCH_SAMPLE_RATE);
+    double ns, cycles, sweep_ns, sweep_cycles;
+    Time(engine, false, ns, cycles);
+    Time(engine, true, sweep_ns, sweep_cycles);
+    printf("%-12s %8.2f %8.1f %8.2f %8.1f ",
+           engine.name,
+           ns,
+           cycles,
+           sweep_ns,
+           sweep_cycles);
+
+    int unstable = 0;
+    for(int rate : rates)
+    {
+        for(float amp : input_amps)
+        {
+            printf(" %8.2f", Stability<Engine>(rate, amp, unstable));
+        }
+    }
+    printf("  %d unstable %s\n", unstable, gated && unstable ? "FAIL" : "");
+    failures += gated ? unstable : 0;
+}
+
+int main()
+{
+    SimFlushDenormals();
+
+    int failures = 0;
+    printf("%-12s %17s %17s  peak output at %.1f / %.1f input, rate (kHz)\n",
+           "",
+           "fixed cutoff",
+           "cutoff per sample",
+           input_amps[0],
+           input_amps[1]);
+    printf("%-12s %8s %8s %8s %8s ", "engine", "ns", "cycles", "ns", "cycles");
+    for(int rate : rates)
+    {
+        printf(" %8d %8d", rate / 1000, rate / 1000);
+    }
+    printf("\n");
+
+    Report<SvfEngine>(failures, false);
+    Report<ZdfEngine>(failures, true);
+
+    // Midway between table entries, below the quarter rate limit
+    double worst = 0.0;
+    for(int rate : rates)
+    {
+        for(int k = 0; k < ZDF_TABLE_SIZE; k += 17)
+        {
+            float exponent = (k + 0.5f) / ZDF_TABLE_SIZE;
+            if(VcfExpToFreq(exponent) < BENCH_SAMPLE_RATE / 4)
+            {
+                worst = fmax(worst, fabs(CutoffCents(rate, exponent)));
+            }
+        }
+    }
+    bool accurate = worst <= BENCH_MAX_CENTS;
+    printf("\nZdfSvf cutoff error between table entries: %.3f cents %s\n",
+           worst,
+           accurate ? "" : "FAIL");
+    failures += !accurate;
+
+    printf("cycles are host TSC ticks; engine used by the siren: %s\n",
+           DUB_VCF_ZDF ? "ZdfSvf" : "Svf");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+// Compares the two VCO engines: DaisySP PolyBLEP square and the
+// mip-mapped wavetables (wavetable.h).
+//
+// Cost is measured with a steady tone and with an FM sweep from 30 Hz to
+// 20 kHz and back every 10 ms, retuning every sample as Vco::ProcessBlock
+// does. Aliasing is measured on steady tones: the tone completes an odd
+// number of cycles in the FFT length, so every harmonic lands on a bin
+// that is a multiple of the cycle count and every alias lands elsewhere.
+//
+// usage: vco_bench
+
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#else
+#define BENCH_HAS_TSC 0
+#endif
+
+#include "sim_handlers.h"
+#include "spectrum.h"
+
+#define BENCH_SAMPLE_RATE 48000.0f
+#define BENCH_SAMPLES (1 << 20)
+#define FFT_SIZE (1 << 16)
+
+// Each engine behind the same two calls
+struct PolyBlepEngine
+{
+    const char* name;
+    Oscillator  osc;
+
+    PolyBlepEngine() : name("PolyBLEP square")
+    {
+        this->osc.Init(BENCH_SAMPLE_RATE);
+        this->osc.SetWaveform(Oscillator::WAVE_POLYBLEP_SQUARE);
+        this->osc.SetAmp(1.0f);
+    }
+    void  SetFreq(float f) { this->osc.SetFreq(f); }
+    float Process() { return this->osc.Process(); }
+};
+
+struct WavetableEngine
+{
+    const char*         name;
+    WavetableOscillator osc;
+
+    WavetableEngine(const char* name, WavetableShape shape) : name(name)
+    {
+        this->osc.Init(BENCH_SAMPLE_RATE, shape);
+        this->osc.SetAmp(VCO_WAVETABLE_AMP);
+    }
+    void  SetFreq(float f) { this->osc.SetFreq(f); }
+    float Process() { return this->osc.Process(); }
+};
+
+static volatile float sink;
+
+template <typename Engine>
+static void Time(Engine& engine, bool sweep, double& ns, double& cycles)
+{
+    // Exponential sweep, the frequency of each sample is precomputed
+    std::vector<float> freq(BENCH_SAMPLES);
+    int                half = (int)(0.005f * BENCH_SAMPLE_RATE);
+    for(int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        int   p = i % (2 * half);
+        float t = (float)(p < half ? p : 2 * half - p) / half;
+        freq[i] = sweep ? 30.0f * powf(20000.0f / 30.0f, t) : 440.0f;
+    }
+
+    float acc = 0.0f;
+    auto  start = std::chrono::steady_clock::now();
+#if BENCH_HAS_TSC
+    uint64_t tsc = __rdtsc();
+#endif
+    for(int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        engine.SetFreq(freq[i]);
+        acc += engine.Process();
+    }
+#if BENCH_HAS_TSC
+    cycles = (double)(__rdtsc() - tsc) / BENCH_SAMPLES;
+#else
+    cycles = 0.0;
+#endif
+    auto stop = std::chrono::steady_clock::now();
+    sink      = acc;
+    ns = std::chrono::duration<double, std::nano>(stop - start).count()
+         / BENCH_SAMPLES;
+}
+
+// Harmonic to alias power ratio in dB of a steady tone near freq
+template <typename Engine>
+static double SignalToAlias(Engine& engine, float freq)
+{
+    int cycles = (int)(freq * FFT_SIZE / BENCH_SAMPLE_RATE) | 1;
+    engine.SetFreq((float)cycles * BENCH_SAMPLE_RATE / FFT_SIZE);
+    for(int i = 0; i < FFT_SIZE; i++)
+    {
+        engine.Process(); // Settle one full FFT length first
+    }
+
+    std::vector<std::complex<double>> x(FFT_SIZE);
+    for(int i = 0; i < FFT_SIZE; i++)
+    {
+        x[i] = engine.Process() * Hann(i, FFT_SIZE);
+    }
+    Fft(x);
+
+    // The Hann window spreads each line over three bins
+    double harmonic = 0.0, alias = 0.0;
+    for(int bin = 3; bin < FFT_SIZE / 2; bin++)
+    {
+        int    offset = bin % cycles;
+        double power  = std::norm(x[bin]);
+        if(offset <= 1 || offset >= cycles - 1)
+        {
+            harmonic += power;
+        }
+        else
+        {
+            alias += power;
+        }
+    }
+    return 10.0 * log10(harmonic / fmax(alias, 1e-30));
+}
+
+static const float tones[] = {440.0f, 1000.0f, 3000.0f, 6000.0f, 10000.0f};
+
+template <typename Engine>
+static void Report(Engine& engine)
+{
+    double ns, cycles, sweep_ns, sweep_cycles;
+    Time(engine, false, ns, cycles);
+    Time(engine, true, sweep_ns, sweep_cycles);
+    printf("%-22s %8.2f %8.1f %8.2f %8.1f ",
+           engine.name,
+           ns,
+           cycles,
+           sweep_ns,
+           sweep_cycles);
+    for(float tone : tones)
+    {
+        printf(" %7.1f", SignalToAlias(engine, tone));
+    }
+    printf("\n");
+}
+
+int main()
+{
+    SimFlushDenormals();
+
+    printf("%-22s %17s %17s  signal to alias (dB) at\n",
+           "",
+           "steady 440 Hz",
+           "FM sweep");
+    printf("%-22s %8s %8s %8s %8s ", "engine", "ns", "cycles", "ns", "cycles");
+    for(float tone : tones)
+    {
+        printf(" %5.0fHz", tone);
+    }
+    printf("\n");
+
+    PolyBlepEngine polyblep;
+    Report(polyblep);
+
+    // Shapes share one table bank, so each is built and measured in turn
+    WavetableEngine square("wavetable square", WAVETABLE_SQUARE);
+    Report(square);
+    WavetableEngine saw("wavetable saw", WAVETABLE_SAW);
+    Report(saw);
+    WavetableEngine triangle("wavetable triangle", WAVETABLE_TRIANGLE);
+    Report(triangle);
+    WavetableEngine pulse("wavetable pulse 25%", WAVETABLE_PULSE);
+    Report(pulse);
+
+    printf("\ncycles are host TSC ticks; engine used by the siren: %s\n",
+           DUB_VCO_WAVETABLE ? "wavetable" : "PolyBLEP");
+    return 0;
+}
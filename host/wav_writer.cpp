@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstring>
+
+#include "wav_writer.h"
+
+static void Put16(FILE* f, uint16_t v)
+{
+    uint8_t b[2] = {(uint8_t)(v & 0xff), (uint8_t)(v >> 8)};
+    fwrite(b, 1, 2, f);
+}
+
+static uint32_t Get32(const uint8_t* b)
+{
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static void Put32(FILE* f, uint32_t v)
+{
+    uint8_t b[4] = {(uint8_t)(v & 0xff),
+                    (uint8_t)((v >> 8) & 0xff),
+                    (uint8_t)((v >> 16) & 0xff),
+                    (uint8_t)(v >> 24)};
+    fwrite(b, 1, 4, f);
+}
+
+bool WavWriter::Open(const std::string& path,
+                     int                sample_rate,
+                     bool               float_format)
+{
+    this->Close();
+    this->file         = fopen(path.c_str(), "wb");
+    this->frames       = 0;
+    this->sample_rate  = sample_rate;
+    this->float_format = float_format;
+    if(this->file == nullptr)
+    {
+        return false;
+    }
+    this->WriteHeader(); // Placeholder sizes, rewritten by Close()
+    return true;
+}
+
+void WavWriter::WriteHeader()
+{
+    uint16_t bits        = this->float_format ? 32 : 16;
+    uint16_t block_align = 2 * bits / 8;
+    uint32_t data_size   = this->frames * block_align;
+
+    fwrite("RIFF", 1, 4, this->file);
+    Put32(this->file, 36 + data_size);
+    fwrite("WAVEfmt ", 1, 8, this->file);
+    Put32(this->file, 16);
+    Put16(this->file, this->float_format ? 3 : 1); // IEEE float or PCM
+    Put16(this->file, 2);
+    Put32(this->file, this->sample_rate);
+    Put32(this->file, this->sample_rate * block_align);
+    Put16(this->file, block_align);
+    Put16(this->file, bits);
+    fwrite("data", 1, 4, this->file);
+    Put32(this->file, data_size);
+}
+
+void WavWriter::Write(const float* left, const float* right, size_t n)
+{
+    if(this->file == nullptr)
+    {
+        return;
+    }
+    for(size_t i = 0; i < n; i++)
+    {
+        if(this->float_format)
+        {
+            uint32_t l, r;
+            memcpy(&l, &left[i], 4);
+            memcpy(&r, &right[i], 4);
+            Put32(this->file, l);
+            Put32(this->file, r);
+        }
+        else
+        {
+            float l = fminf(fmaxf(left[i], -1.0f), 1.0f);
+            float r = fminf(fmaxf(right[i], -1.0f), 1.0f);
+            Put16(this->file, (uint16_t)(int16_t)lrintf(l * 32767.0f));
+            Put16(this->file, (uint16_t)(int16_t)lrintf(r * 32767.0f));
+        }
+    }
+    this->frames += n;
+}
+
+void WavWriter::Close()
+{
+    if(this->file == nullptr)
+    {
+        return;
+    }
+    fseek(this->file, 0, SEEK_SET);
+    this->WriteHeader();
+    fclose(this->file);
+    this->file = nullptr;
+}
+
+bool ReadWav(const std::string& path,
+             std::vector<float>& left,
+             std::vector<float>& right,
+             int&                sample_rate,
+             std::string&        error)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if(f == nullptr)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    uint8_t header[44];
+    bool    ok = fread(header, 1, 44, f) == 44
+              && memcmp(header, "RIFF", 4) == 0
+              && memcmp(header + 8, "WAVEfmt ", 8) == 0
+              && memcmp(header + 36, "data", 4) == 0;
+    if(!ok || (header[20] | (header[21] << 8)) != 3
+       || (header[22] | (header[23] << 8)) != 2
+       || (header[34] | (header[35] << 8)) != 32)
+    {
+        fclose(f);
+        error = path + " is not a 32-bit float stereo WAV file";
+        return false;
+    }
+    sample_rate     = (int)Get32(header + 24);
+    uint32_t frames = Get32(header + 40) / 8;
+
+    std::vector<uint8_t> data((size_t)frames * 8);
+    size_t               got = fread(data.data(), 1, data.size(), f);
+    fclose(f);
+    if(got != data.size())
+    {
+        error = path + " is truncated";
+        return false;
+    }
+
+    left.resize(frames);
+    right.resize(frames);
+    for(uint32_t i = 0; i < frames; i++)
+    {
+        uint32_t l = Get32(&data[i * 8]);
+        uint32_t r = Get32(&data[i * 8 + 4]);
+        memcpy(&left[i], &l, 4);
+        memcpy(&right[i], &r, 4);
+    }
+    return true;
+}
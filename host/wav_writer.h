@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Streams interleaved stereo audio to a WAV file, either as 32-bit float
+// (bit-exact, for regression renders) or 16-bit PCM.
+class WavWriter
+{
+  public:
+    WavWriter() : file(nullptr), frames(0), sample_rate(0), float_format(true)
+    {
+    }
+    ~WavWriter() { this->Close(); }
+
+    bool Open(const std::string& path, int sample_rate, bool float_format);
+    void Write(const float* left, const float* right, size_t n);
+    void Close();
+
+  private:
+    void WriteHeader();
+
+    FILE*    file;
+    uint32_t frames;
+    int      sample_rate;
+    bool     float_format;
+};
+
+// Reads back a 32-bit float stereo WAV file as written by WavWriter.
+// Returns false and fills error on any other format.
+bool ReadWav(const std::string& path,
+             std::vector<float>& left,
+             std::vector<float>& right,
+             int&                sample_rate,
+             std::string&        error);
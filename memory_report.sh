@@ -0,0 +1,159 @@
+#!/bin/sh
+# Memory map report of the Seed firmware:
+#   - usage of each memory region of the STM32H750, from the ELF sections
+#   - flash and RAM footprint of each component, from the symbol sizes
+#   - placement of the hot symbols of the audio path (placement.h)
+#
+# Run by `make` after linking, or by hand:
+#   usage: memory_report.sh OBJDUMP NM firmware.elf
+
+if [ $# -ne 3 ]; then
+    echo "usage: $0 OBJDUMP NM firmware.elf" >&2
+    exit 1
+fi
+
+OBJDUMP=$1
+NM=$2
+ELF=$3
+
+# Shared by both passes: memory regions of the libDaisy linker script
+REGIONS='
+function hex(s,    i, n)
+{
+    n = 0
+    s = tolower(s)
+    for(i = 1; i <= length(s); i++)
+        n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+    return n
+}
+
+function region(a)
+{
+    if(a < hex("10000"))                             return "ITCM"
+    if(a >= hex("08000000") && a < hex("08020000"))  return "FLASH"
+    if(a >= hex("20000000") && a < hex("20020000"))  return "DTCM"
+    if(a >= hex("24000000") && a < hex("24080000"))  return "SRAM"
+    if(a >= hex("30000000") && a < hex("30048000"))  return "RAM_D2"
+    if(a >= hex("38000000") && a < hex("38010000"))  return "RAM_D3"
+    if(a >= hex("90000000") && a < hex("90800000"))  return "QSPI"
+    if(a >= hex("c0000000") && a < hex("c4000000"))  return "SDRAM"
+    return "other"
+}
+'
+
+echo "Memory regions (bytes)"
+"$OBJDUMP" -h "$ELF" | awk "$REGIONS"'
+BEGIN {
+    split("ITCM FLASH DTCM SRAM RAM_D2 RAM_D3 QSPI SDRAM", order, " ")
+    capacity["ITCM"]   = 65536
+    capacity["FLASH"]  = 131072
+    capacity["DTCM"]   = 131072
+    capacity["SRAM"]   = 524288
+    capacity["RAM_D2"] = 294912
+    capacity["RAM_D3"] = 65536
+    capacity["QSPI"]   = 8388608
+    capacity["SDRAM"]  = 67108864
+}
+# Section line, followed by its flags line
+$1 ~ /^[0-9]+$/ && NF == 7 {
+    name = $2; size = hex($3); vma = hex($4); lma = hex($5)
+    getline flags
+    if(flags !~ /ALLOC/)
+        next
+    used[region(vma)] += size
+    # Initial values of .data, .itcmram and the like are copied from flash
+    if(flags ~ /LOAD/ && lma != vma && region(lma) == "FLASH")
+        used["FLASH"] += size
+}
+END {
+    printf "  %-8s %10s %10s %6s\n", "region", "used", "size", "use"
+    for(i = 1; i <= 8; i++)
+    {
+        r = order[i]
+        printf "  %-8s %10d %10d %5.1f%%\n", r, used[r], capacity[r],
+               100.0 * used[r] / capacity[r]
+    }
+}'
+
+echo
+echo "Footprint per component (bytes)"
+"$NM" -C -S --defined-only "$ELF" | awk "$REGIONS"'
+# Component of a demangled symbol name
+function component(name)
+{
+    if(name ~ /^DubSirenEngine</ || name == "engine"                        \
+       || name ~ /^AudioCallback/)
+        return "engine"
+    if(name == "bank")
+        return "WavetableOscillator"
+    if(name == "delay_buffer")
+        return "TapeDelay"
+    if(name == "reverb_buffer")
+        return "FdnReverb"
+    if(match(name, /^(DecayEnvelope|Triggers|Sweep|ExpRamp|Lfo|Vco|Vcf|ZdfSvf|OutAmp|TapeDelay|FdnReverb|HalfbandDecimator|WavetableOscillator|Profiler|DaisyHardware|ControlTask|MidiParser|MidiInput|KnobFilter|KnobHandler[A-Za-z]*|ButtonHandler[A-Za-z]*)::/))
+        return substr(name, 1, RLENGTH - 2)
+    if(name ~ /^daisysp::/)
+        return "DaisySP"
+    if(name ~ /^daisy::/)
+        return "libDaisy"
+    return "other"
+}
+
+# addr size type name, the demangled name may contain spaces
+NF >= 4 {
+    size = hex($2)
+    type = $3
+    name = $4
+    for(i = 5; i <= NF; i++)
+        name = name " " $i
+    r = region(hex($1))
+    c = component(name)
+    if(type ~ /^[tTwW]$/)
+        col = r == "ITCM" ? "itcm" : "code"
+    else if(r == "FLASH")
+        col = "rodata"
+    else if(r == "DTCM")
+        col = "dtcm"
+    else
+        col = "ram"
+    bytes[c, col] += size
+    seen[c] = 1
+}
+END {
+    printf "  %-20s %8s %8s %8s %8s %8s\n",
+           "component", "code", "itcm", "rodata", "dtcm", "ram"
+    n = split("engine DecayEnvelope Triggers Sweep ExpRamp Lfo Vco Vcf " \
+              "ZdfSvf OutAmp TapeDelay FdnReverb HalfbandDecimator "    \
+              "WavetableOscillator Profiler "                           \
+              "DaisyHardware ControlTask MidiParser MidiInput "         \
+              "KnobFilter KnobHandler KnobHandlerDaisy "                \
+              "ButtonHandler ButtonHandlerDaisy DaisySP libDaisy other", \
+              order, " ")
+    for(i = 1; i <= n; i++)
+    {
+        c = order[i]
+        if(!(c in seen))
+            continue
+        printf "  %-20s %8d %8d %8d %8d %8d\n", c, bytes[c, "code"],
+               bytes[c, "itcm"], bytes[c, "rodata"], bytes[c, "dtcm"],
+               bytes[c, "ram"]
+    }
+}'
+
+echo
+echo "Hot symbols (! = outside the tightly coupled memories)"
+"$NM" -C -S --defined-only "$ELF" | awk "$REGIONS"'
+NF >= 4 {
+    name = $4
+    for(i = 5; i <= NF; i++)
+        name = name " " $i
+    if(name !~ /^AudioCallback|::(AudioCallback|AudioCallbackBlock|AudioCallbackPerSample|ProcessChunk|ProcessVoiceOversampled|ApplyDueFrames|ApplyControlFrame|ApplyKnobValues|BeginCallback)\(|^(DecayEnvelope|Triggers|Sweep|ExpRamp|Lfo|Vco|Vcf|OutAmp)::|^(TapeDelay|FdnReverb)::(Process|UpdateControls)|^HalfbandDecimator::Process|^ZdfSvf::(Process|SetExponent)|^daisysp::(Svf|Oscillator|Adsr)::Process|^(engine|bank)$/)
+        next
+    # Constructors run once at startup, SetSampleRate with the audio stopped
+    if(name ~ /^(DecayEnvelope::DecayEnvelope|Triggers::Triggers|Sweep::Sweep|Lfo::Lfo|Vco::Vco|Vcf::Vcf|OutAmp::OutAmp|TapeDelay::TapeDelay|FdnReverb::FdnReverb)\(|::SetSampleRate\(/)
+        next
+    r    = region(hex($1))
+    code = $3 ~ /^[tTwW]$/
+    tcm  = code ? r == "ITCM" : r == "DTCM"
+    printf "  %s %-6s %s %6d  %s\n", tcm ? " " : "!", r, $1, hex($2), name
+}'
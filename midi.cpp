@@ -0,0 +1,44 @@
+#include "midi.h"
+
+void MidiParser::Reset()
+{
+    this->running = 0;
+    this->data[0] = 0;
+    this->data[1] = 0;
+    this->count   = 0;
+}
+
+bool MidiParser::Parse(uint8_t byte, MidiMessage& msg)
+{
+    if(byte >= 0xF8)
+    {
+        return false; // Real time, allowed between any two bytes
+    }
+    if(byte & 0x80)
+    {
+        // A channel status starts a message, anything from 0xF0 ends the
+        // running status until the next one
+        this->running = byte < 0xF0 ? byte : 0;
+        this->count   = 0;
+        return false;
+    }
+    if(this->running == 0)
+    {
+        return false; // System exclusive data, or data without a status
+    }
+
+    this->data[this->count++] = byte;
+    int type   = this->running & 0xF0;
+    int length = type == MIDI_PROGRAM_CHANGE || type == MIDI_CHANNEL_PRESSURE
+                     ? 1
+                     : 2;
+    if(this->count < length)
+    {
+        return false;
+    }
+    msg.status  = this->running;
+    msg.data[0] = this->data[0];
+    msg.data[1] = length == 2 ? this->data[1] : 0;
+    this->count = 0; // Running status: the next data byte starts another
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+// MIDI byte stream parser for the channel voice messages.
+//
+// Running status is kept, so a drum machine may send the status byte once
+// for a run of notes. System real time bytes (clock, start, stop) may come
+// between the bytes of a message and are skipped without breaking it.
+// System exclusive and the other system common messages are dropped, and
+// cancel the running status as the MIDI specification asks.
+
+enum MidiStatus
+{
+    MIDI_NOTE_OFF         = 0x80,
+    MIDI_NOTE_ON          = 0x90,
+    MIDI_POLY_PRESSURE    = 0xA0,
+    MIDI_CONTROL_CHANGE   = 0xB0,
+    MIDI_PROGRAM_CHANGE   = 0xC0,
+    MIDI_CHANNEL_PRESSURE = 0xD0,
+    MIDI_PITCH_BEND       = 0xE0,
+};
+
+struct MidiMessage
+{
+    uint32_t time_us; // Arrival of the last byte, microsecond timer
+    uint8_t  status;  // MidiStatus | channel 0-15
+    uint8_t  data[2]; // Second byte 0 for one byte messages
+
+    int Type() const { return this->status & 0xF0; }
+    int Channel() const { return (this->status & 0x0F) + 1; } // 1-16
+};
+
+class MidiParser
+{
+  public:
+    MidiParser() { this->Reset(); }
+
+    void Reset();
+
+    // Feeds one byte, true when it completes a message. Fills the status
+    // and data of msg, the arrival time is left to the caller.
+    bool Parse(uint8_t byte, MidiMessage& msg);
+
+  private:
+    uint8_t running; // Status of the message in progress, 0 = none
+    uint8_t data[2];
+    int     count; // Data bytes received for it
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+// Memory placement of the audio path on the Seed (STM32H750).
+//
+// DUB_ITCM puts a function in ITCM and DUB_DTCM an object in DTCM. Both
+// are zero wait state for the core, while flash is only fast on a cache
+// hit and AXI SRAM goes through the D-cache and the bus matrix.
+//
+// ITCM code is copied from flash at startup by libDaisy (.itcmram in its
+// linker script). DTCM objects go in .dtcmram_bss, which is not zeroed:
+// only objects whose constructor initializes the state they read belong
+// there. DMA cannot reach DTCM, so audio buffers stay where libDaisy puts
+// them.
+//
+// Budget: 64 KB of ITCM and 128 KB of DTCM. `make` on the Seed prints the
+// usage and the placement of the hot symbols (memory_report.sh).
+//
+// Build with DUB_TCM_PLACEMENT=0 (make TCM=0) to leave everything in the
+// default sections and measure the difference. The host build ignores
+// both macros.
+
+#ifndef DUB_TCM_PLACEMENT
+#define DUB_TCM_PLACEMENT 1
+#endif
+
+#if DUB_TCM_PLACEMENT && !defined(DUB_HOST)
+#define DUB_ITCM __attribute__((section(".itcmram")))
+#define DUB_DTCM __attribute__((section(".dtcmram_bss")))
+#else
+#define DUB_ITCM
+#define DUB_DTCM
+#endif
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Per-stage CPU profiler of the audio callback.
+//
+// The callback marks the end of each pipeline stage with a lap; the time
+// since the previous lap is charged to that stage. At the end of every
+// callback the per-stage totals go into min/avg/max statistics, and a
+// callback longer than its real-time budget counts as an overrun.
+//
+// The main loop asks for a snapshot with Poll(). The callback copies its
+// statistics out at the end of the next callback and starts a new
+// interval, so neither side ever waits for the other.
+//
+// Ticks are DWT cycles on the Seed and nanoseconds on the host. With
+// DUB_PROFILER set to 0 the PROFILE_* macros expand to nothing.
+
+#ifndef DUB_PROFILER
+#define DUB_PROFILER 0
+#endif
+
+enum ProfileStage
+{
+    STAGE_CONTROLS = 0, // Control frames and control-rate coefficients
+    STAGE_ENVELOPE,
+    STAGE_CUTOFF,
+    STAGE_LFO,
+    STAGE_PITCH, // Carrier or sweep to tune, then FM
+    STAGE_VCO,   // Including the envelope VCA
+    STAGE_VCF,
+    STAGE_DECIMATOR, // Oversampled builds only
+    STAGE_LED,
+    STAGE_OUT_AMP,
+    STAGE_DELAY,
+    STAGE_REVERB,
+    STAGE_OTHER, // Callback time outside any stage
+    NUM_PROFILE_STAGES
+};
+
+inline const char* ProfileStageName(int stage)
+{
+    static const char* names[NUM_PROFILE_STAGES]
+        = {"controls",
+           "envelope",
+           "cutoff",
+           "lfo",
+           "pitch",
+           "vco",
+           "vcf",
+           "decimator",
+           "led",
+           "out amp",
+           "delay",
+           "reverb",
+           "other"};
+    return names[stage];
+}
+
+struct ProfileStats
+{
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+
+    void Reset()
+    {
+        this->min = UINT32_MAX;
+        this->max = 0;
+        this->sum = 0;
+    }
+
+    void Add(uint32_t ticks)
+    {
+        this->min = ticks < this->min ? ticks : this->min;
+        this->max = ticks > this->max ? ticks : this->max;
+        this->sum += ticks;
+    }
+};
+
+struct ProfileSnapshot
+{
+    ProfileStats stages[NUM_PROFILE_STAGES]; // Ticks per callback
+    ProfileStats callback;                   // Ticks per callback
+    uint32_t     callbacks;      // Callbacks in the interval
+    uint32_t     overruns;       // Overruns in the interval
+    uint32_t     total_overruns; // Overruns since Init
+    uint32_t     budget;         // Ticks per callback at the last size
+    uint32_t     ticks_per_us;
+};
+
+class Profiler
+{
+  public:
+    Profiler() { this->Init(1000000000u, 48000, nullptr); }
+
+    // now returns the tick counter, which may wrap
+    void Init(uint32_t ticks_per_second, int sample_rate, uint32_t (*now)())
+    {
+        this->now              = now;
+        this->ticks_per_sample = (float)ticks_per_second / sample_rate;
+        this->current.ticks_per_us = ticks_per_second / 1000000u;
+        this->current.total_overruns = 0;
+        this->ResetInterval();
+        this->request.store(false, std::memory_order_relaxed);
+        this->ready.store(false, std::memory_order_relaxed);
+    }
+
+    // Audio side
+    void BeginCallback(size_t size)
+    {
+        this->start = this->now();
+        this->mark  = this->start;
+        this->size  = size;
+        for(int i = 0; i < NUM_PROFILE_STAGES; i++)
+        {
+            this->laps[i] = 0;
+        }
+    }
+
+    void Lap(ProfileStage stage)
+    {
+        uint32_t t = this->now();
+        this->laps[stage] += t - this->mark;
+        this->mark = t;
+    }
+
+    void EndCallback()
+    {
+        uint32_t total   = this->now() - this->start;
+        uint32_t charged = 0;
+        for(int i = 0; i < STAGE_OTHER; i++)
+        {
+            charged += this->laps[i];
+        }
+        this->laps[STAGE_OTHER] = total - charged;
+        for(int i = 0; i < NUM_PROFILE_STAGES; i++)
+        {
+            this->current.stages[i].Add(this->laps[i]);
+        }
+        this->current.callback.Add(total);
+        this->current.callbacks++;
+        this->current.budget = (uint32_t)(this->size * this->ticks_per_sample);
+        if(total > this->current.budget)
+        {
+            this->current.overruns++;
+            this->current.total_overruns++;
+        }
+
+        // Hand the interval over if the main loop asked for it
+        if(this->request.load(std::memory_order_acquire)
+           && !this->ready.load(std::memory_order_relaxed))
+        {
+            this->published = this->current;
+            this->ResetInterval();
+            this->request.store(false, std::memory_order_relaxed);
+            this->ready.store(true, std::memory_order_release);
+        }
+    }
+
+    // Main loop side. Returns true with the statistics of the interval
+    // since the previous snapshot, otherwise asks for one and returns false.
+    bool Poll(ProfileSnapshot& snapshot)
+    {
+        if(this->ready.load(std::memory_order_acquire))
+        {
+            snapshot = this->published;
+            this->ready.store(false, std::memory_order_release);
+            return true;
+        }
+        this->request.store(true, std::memory_order_release);
+        return false;
+    }
+
+    // Statistics of the running interval, only while no callback can run
+    const ProfileSnapshot& Current() const { return this->current; }
+
+  private:
+    void ResetInterval()
+    {
+        for(int i = 0; i < NUM_PROFILE_STAGES; i++)
+        {
+            this->current.stages[i].Reset();
+        }
+        this->current.callback.Reset();
+        this->current.callbacks = 0;
+        this->current.overruns  = 0;
+    }
+
+    uint32_t (*now)();
+    float             ticks_per_sample;
+    uint32_t          start;
+    uint32_t          mark;
+    size_t            size;
+    uint32_t          laps[NUM_PROFILE_STAGES];
+    ProfileSnapshot   current;
+    ProfileSnapshot   published;
+    std::atomic<bool> request;
+    std::atomic<bool> ready;
+};
+
+#if DUB_PROFILER
+#define PROFILE_BEGIN(size) profiler.BeginCallback(size)
+#define PROFILE_LAP(stage) profiler.Lap(stage)
+#define PROFILE_END() profiler.EndCallback()
+#else
+#define PROFILE_BEGIN(size)
+#define PROFILE_LAP(stage)
+#define PROFILE_END()
+#endif
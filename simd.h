@@ -0,0 +1,350 @@
+#pragma once
+
+#include <cstdint>
+
+// Four-lane float vectors for the per-voice DSP, with one implementation
+// per instruction set, chosen with DUB_SIMD:
+//
+//   DUB_SIMD_SCALAR  four floats, lane by lane. The Cortex-M7 has no
+//                    float vector unit, so this is the Seed build. Four
+//                    lanes cost four times one there, so the callers
+//                    skip the lanes they do not need on this one.
+//   DUB_SIMD_SSE     SSE2 on x86 hosts, VEX encoded when built with -mavx
+//   DUB_SIMD_NEON    NEON on Arm A-profile cores (AArch64, Armv7 with NEON)
+//
+// By default the widest one the compiler targets. Every implementation
+// rounds each operation the same way, so all of them give bit-identical
+// results as long as the compiler does not contract products and sums into
+// fused multiply-adds (-ffp-contract=off on targets that have them).
+//
+// Masks are the result of the comparisons, all ones or all zeros per lane,
+// and only pick lanes with Select: the code stays free of branches on the
+// lane contents.
+
+#define DUB_SIMD_SCALAR 0
+#define DUB_SIMD_SSE 1
+#define DUB_SIMD_NEON 2
+
+#ifndef DUB_SIMD
+#if defined(__SSE2__) || defined(_M_X64)
+#define DUB_SIMD DUB_SIMD_SSE
+#elif defined(__ARM_NEON)
+#define DUB_SIMD DUB_SIMD_NEON
+#else
+#define DUB_SIMD DUB_SIMD_SCALAR
+#endif
+#endif
+
+#if DUB_SIMD == DUB_SIMD_SSE
+#include <emmintrin.h>
+#elif DUB_SIMD == DUB_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#if DUB_SIMD == DUB_SIMD_SSE
+
+struct Mask4
+{
+    __m128 v;
+};
+
+struct Vec4
+{
+    __m128 v;
+
+    static Vec4 Splat(float x) { return {_mm_set1_ps(x)}; }
+    static Vec4 Load(const float* p) { return {_mm_loadu_ps(p)}; }
+    void        Store(float* p) const { _mm_storeu_ps(p, this->v); }
+};
+
+inline Vec4 operator+(Vec4 a, Vec4 b)
+{
+    return {_mm_add_ps(a.v, b.v)};
+}
+inline Vec4 operator-(Vec4 a, Vec4 b)
+{
+    return {_mm_sub_ps(a.v, b.v)};
+}
+inline Vec4 operator*(Vec4 a, Vec4 b)
+{
+    return {_mm_mul_ps(a.v, b.v)};
+}
+inline Vec4 Min(Vec4 a, Vec4 b)
+{
+    return {_mm_min_ps(a.v, b.v)};
+}
+inline Vec4 Max(Vec4 a, Vec4 b)
+{
+    return {_mm_max_ps(a.v, b.v)};
+}
+
+inline Mask4 operator<(Vec4 a, Vec4 b)
+{
+    return {_mm_cmplt_ps(a.v, b.v)};
+}
+inline Mask4 operator>(Vec4 a, Vec4 b)
+{
+    return {_mm_cmpgt_ps(a.v, b.v)};
+}
+inline Mask4 operator==(Vec4 a, Vec4 b)
+{
+    return {_mm_cmpeq_ps(a.v, b.v)};
+}
+inline Mask4 operator&(Mask4 a, Mask4 b)
+{
+    return {_mm_and_ps(a.v, b.v)};
+}
+inline Mask4 operator|(Mask4 a, Mask4 b)
+{
+    return {_mm_or_ps(a.v, b.v)};
+}
+
+// a in the lanes of m, b in the others
+inline Vec4 Select(Mask4 m, Vec4 a, Vec4 b)
+{
+    return {_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))};
+}
+
+// ((x0 + x1) + x2) + x3, the order of the scalar implementation
+inline float Sum(Vec4 x)
+{
+    __m128 x1 = _mm_shuffle_ps(x.v, x.v, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 x2 = _mm_movehl_ps(x.v, x.v);
+    __m128 x3 = _mm_shuffle_ps(x.v, x.v, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 s  = _mm_add_ss(_mm_add_ss(_mm_add_ss(x.v, x1), x2), x3);
+    return _mm_cvtss_f32(s);
+}
+
+#elif DUB_SIMD == DUB_SIMD_NEON
+
+struct Mask4
+{
+    uint32x4_t v;
+};
+
+struct Vec4
+{
+    float32x4_t v;
+
+    static Vec4 Splat(float x) { return {vdupq_n_f32(x)}; }
+    static Vec4 Load(const float* p) { return {vld1q_f32(p)}; }
+    void        Store(float* p) const { vst1q_f32(p, this->v); }
+};
+
+inline Vec4 operator+(Vec4 a, Vec4 b)
+{
+    return {vaddq_f32(a.v, b.v)};
+}
+inline Vec4 operator-(Vec4 a, Vec4 b)
+{
+    return {vsubq_f32(a.v, b.v)};
+}
+inline Vec4 operator*(Vec4 a, Vec4 b)
+{
+    return {vmulq_f32(a.v, b.v)};
+}
+inline Vec4 Min(Vec4 a, Vec4 b)
+{
+    return {vminq_f32(a.v, b.v)};
+}
+inline Vec4 Max(Vec4 a, Vec4 b)
+{
+    return {vmaxq_f32(a.v, b.v)};
+}
+
+inline Mask4 operator<(Vec4 a, Vec4 b)
+{
+    return {vcltq_f32(a.v, b.v)};
+}
+inline Mask4 operator>(Vec4 a, Vec4 b)
+{
+    return {vcgtq_f32(a.v, b.v)};
+}
+inline Mask4 operator==(Vec4 a, Vec4 b)
+{
+    return {vceqq_f32(a.v, b.v)};
+}
+inline Mask4 operator&(Mask4 a, Mask4 b)
+{
+    return {vandq_u32(a.v, b.v)};
+}
+inline Mask4 operator|(Mask4 a, Mask4 b)
+{
+    return {vorrq_u32(a.v, b.v)};
+}
+
+// a in the lanes of m, b in the others
+inline Vec4 Select(Mask4 m, Vec4 a, Vec4 b)
+{
+    return {vbslq_f32(m.v, a.v, b.v)};
+}
+
+// ((x0 + x1) + x2) + x3, the order of the scalar implementation
+inline float Sum(Vec4 x)
+{
+    return ((vgetq_lane_f32(x.v, 0) + vgetq_lane_f32(x.v, 1))
+            + vgetq_lane_f32(x.v, 2))
+           + vgetq_lane_f32(x.v, 3);
+}
+
+#else // DUB_SIMD_SCALAR
+
+struct Mask4
+{
+    bool v[4];
+};
+
+struct Vec4
+{
+    float v[4];
+
+    static Vec4 Splat(float x) { return {{x, x, x, x}}; }
+    static Vec4 Load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+    void        Store(float* p) const
+    {
+        for(int i = 0; i < 4; i++)
+        {
+            p[i] = this->v[i];
+        }
+    }
+};
+
+inline Vec4 operator+(Vec4 a, Vec4 b)
+{
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2],
+             a.v[3] + b.v[3]}};
+}
+inline Vec4 operator-(Vec4 a, Vec4 b)
+{
+    return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2],
+             a.v[3] - b.v[3]}};
+}
+inline Vec4 operator*(Vec4 a, Vec4 b)
+{
+    return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2],
+             a.v[3] * b.v[3]}};
+}
+// Same operand order as minps and maxps, b when they compare equal
+inline Vec4 Min(Vec4 a, Vec4 b)
+{
+    Vec4 r;
+    for(int i = 0; i < 4; i++)
+    {
+        r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+    }
+    return r;
+}
+inline Vec4 Max(Vec4 a, Vec4 b)
+{
+    Vec4 r;
+    for(int i = 0; i < 4; i++)
+    {
+        r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+    }
+    return r;
+}
+
+inline Mask4 operator<(Vec4 a, Vec4 b)
+{
+    return {{a.v[0] < b.v[0], a.v[1] < b.v[1], a.v[2] < b.v[2],
+             a.v[3] < b.v[3]}};
+}
+inline Mask4 operator>(Vec4 a, Vec4 b)
+{
+    return b < a;
+}
+inline Mask4 operator==(Vec4 a, Vec4 b)
+{
+    return {{a.v[0] == b.v[0], a.v[1] == b.v[1], a.v[2] == b.v[2],
+             a.v[3] == b.v[3]}};
+}
+inline Mask4 operator&(Mask4 a, Mask4 b)
+{
+    return {{a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2],
+             a.v[3] && b.v[3]}};
+}
+inline Mask4 operator|(Mask4 a, Mask4 b)
+{
+    return {{a.v[0] || b.v[0], a.v[1] || b.v[1], a.v[2] || b.v[2],
+             a.v[3] || b.v[3]}};
+}
+
+// a in the lanes of m, b in the others. Conditional moves, not branches.
+inline Vec4 Select(Mask4 m, Vec4 a, Vec4 b)
+{
+    Vec4 r;
+    for(int i = 0; i < 4; i++)
+    {
+        r.v[i] = m.v[i] ? a.v[i] : b.v[i];
+    }
+    return r;
+}
+
+inline float Sum(Vec4 x)
+{
+    return ((x.v[0] + x.v[1]) + x.v[2]) + x.v[3];
+}
+
+#endif
+
+inline const char* SimdName()
+{
+#if DUB_SIMD == DUB_SIMD_SSE
+#if defined(__AVX__)
+    return "sse (avx encoded)";
+#else
+    return "sse";
+#endif
+#elif DUB_SIMD == DUB_SIMD_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+// sin(2 pi x) for x in [0, 1], the phase of an oscillator in turns, after
+// a fold to the first quarter turn that needs no branch. The odd Taylor
+// polynomial of FastSin (fastmath.h) with one more term, as close to sinf
+// as float rounding allows: the LFO drives the FM, where a 4e-6 error
+// already moves the pitch of the extreme settings audibly.
+inline Vec4 FastSinTurns(Vec4 x)
+{
+    // sin(2 pi x) = -sin(2 pi t) with t = x - 1/2 in [-1/2, 1/2], and
+    // sin(2 pi |t|) = sin(2 pi q) with q = min(|t|, 1/2 - |t|) in [0, 1/4]
+    const Vec4 half = Vec4::Splat(0.5f);
+    const Vec4 zero = Vec4::Splat(0.0f);
+    Vec4       t    = x - half;
+    Vec4       a    = Max(t, zero - t);
+    Vec4       z    = Min(a, half - a) * Vec4::Splat(6.28318531f);
+
+    Vec4 z2 = z * z;
+    Vec4 p  = Vec4::Splat(-2.50521084e-8f);
+    p       = p * z2 + Vec4::Splat(2.75573192e-6f);
+    p       = p * z2 + Vec4::Splat(-1.98412698e-4f);
+    p       = p * z2 + Vec4::Splat(8.33333333e-3f);
+    p       = p * z2 + Vec4::Splat(-1.66666667e-1f);
+    p       = p * z2 + Vec4::Splat(1.0f);
+    Vec4 s  = p * z;
+    return Select(t < zero, s, zero - s);
+}
+
+// The same operations on one float, for the per-voice scalar LFO: rounds
+// like every lane of the vector version
+inline float FastSinTurns(float x)
+{
+    float t = x - 0.5f;
+    float n = 0.0f - t;
+    float a = t > n ? t : n;
+    float b = 0.5f - a;
+    float z = (a < b ? a : b) * 6.28318531f;
+
+    float z2 = z * z;
+    float p  = -2.50521084e-8f;
+    p        = p * z2 + 2.75573192e-6f;
+    p        = p * z2 + -1.98412698e-4f;
+    p        = p * z2 + 8.33333333e-3f;
+    p        = p * z2 + -1.66666667e-1f;
+    p        = p * z2 + 1.0f;
+    float s  = p * z;
+    return t < 0.0f ? s : 0.0f - s;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Wait-free single producer / single consumer ring buffer.
+// The producer (main loop) only writes head, the consumer (audio callback)
+// only writes tail, so neither side ever blocks the other. Capacity must be
+// a power of two; one slot is kept free to tell full from empty.
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+  public:
+    SpscQueue() { this->Reset(); }
+
+    // Only safe while neither side is running
+    void Reset()
+    {
+        this->head.store(0, std::memory_order_relaxed);
+        this->tail.store(0, std::memory_order_relaxed);
+    }
+
+    // Producer side. Returns false when the queue is full.
+    bool Push(const T& item)
+    {
+        uint32_t h = this->head.load(std::memory_order_relaxed);
+        if(h - this->tail.load(std::memory_order_acquire) >= N - 1)
+        {
+            return false;
+        }
+        this->items[h & (N - 1)] = item;
+        this->head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Oldest item, or nullptr when empty.
+    const T* Front() const
+    {
+        uint32_t t = this->tail.load(std::memory_order_relaxed);
+        if(t == this->head.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &this->items[t & (N - 1)];
+    }
+
+    // Consumer side. Releases the item returned by Front().
+    void PopFront()
+    {
+        uint32_t t = this->tail.load(std::memory_order_relaxed);
+        this->tail.store(t + 1, std::memory_order_release);
+    }
+
+    size_t Size() const
+    {
+        return this->head.load(std::memory_order_acquire)
+               - this->tail.load(std::memory_order_acquire);
+    }
+
+  private:
+    T                     items[N];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+};
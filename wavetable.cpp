@@ -0,0 +1,106 @@
+#include <atomic>
+#include <cmath>
+
+#include "wavetable.h"
+
+// Shared table bank, a guard sample at the end of each level lets the
+// interpolation read one past the last index without wrapping. The lock
+// lets engines on several threads Init at once: the first one builds the
+// bank, the others wait for it and then only read.
+static float            bank[WAVETABLE_LEVELS][WAVETABLE_SIZE + 1];
+static std::atomic<int> bank_shape(-1);
+static std::atomic_flag bank_lock = ATOMIC_FLAG_INIT;
+
+// Fourier series of each shape, amplitude of the sine (b) and cosine (a)
+// terms of harmonic n, scaled for a nominal peak of 1
+static void Harmonic(WavetableShape shape, int n, float& a, float& b)
+{
+    const float pi = 3.14159265358979f;
+    a              = 0.0f;
+    b              = 0.0f;
+    switch(shape)
+    {
+        case WAVETABLE_SQUARE:
+            b = (n & 1) ? 4.0f / (pi * n) : 0.0f;
+            break;
+        case WAVETABLE_SAW:
+            // Falling ramp, same direction as Oscillator::WAVE_SAW
+            b = 2.0f / (pi * n);
+            break;
+        case WAVETABLE_TRIANGLE:
+            if(n & 1)
+            {
+                b = 8.0f / (pi * pi * n * n);
+                b = ((n >> 1) & 1) ? -b : b;
+            }
+            break;
+        case WAVETABLE_PULSE:
+        {
+            // High for the first quarter of the period, DC removed and
+            // scaled so that the high level is 1
+            const float duty = 0.25f;
+            const float gain = 1.0f / (2.0f * (1.0f - duty));
+            const float w    = 2.0f * pi * n * duty;
+            a                = gain * 2.0f * sinf(w) / (pi * n);
+            b                = gain * 2.0f * (1.0f - cosf(w)) / (pi * n);
+            break;
+        }
+        default: break;
+    }
+}
+
+static void BuildBank(WavetableShape shape)
+{
+    // One period of sine, harmonic n at sample i is sine[(n * i) % SIZE]
+    static float sine[WAVETABLE_SIZE];
+    for(int i = 0; i < WAVETABLE_SIZE; i++)
+    {
+        sine[i] = (float)sin(2.0 * M_PI * i / WAVETABLE_SIZE);
+    }
+
+    const int mask    = WAVETABLE_SIZE - 1;
+    const int quarter = WAVETABLE_SIZE / 4;
+    for(int level = 0; level < WAVETABLE_LEVELS; level++)
+    {
+        float* table     = bank[level];
+        int    harmonics = WAVETABLE_MAX_HARMONICS >> level;
+        for(int i = 0; i < WAVETABLE_SIZE; i++)
+        {
+            table[i] = 0.0f;
+        }
+        for(int n = 1; n <= harmonics; n++)
+        {
+            float a, b;
+            Harmonic(shape, n, a, b);
+            if(a == 0.0f && b == 0.0f)
+            {
+                continue;
+            }
+            for(int i = 0; i < WAVETABLE_SIZE; i++)
+            {
+                int k = (n * i) & mask;
+                table[i] += b * sine[k] + a * sine[(k + quarter) & mask];
+            }
+        }
+        table[WAVETABLE_SIZE] = table[0];
+    }
+    bank_shape.store(shape, std::memory_order_release);
+}
+
+void WavetableOscillator::Init(float sample_rate, WavetableShape shape)
+{
+    if(bank_shape.load(std::memory_order_acquire) != shape)
+    {
+        while(bank_lock.test_and_set(std::memory_order_acquire)) {}
+        if(bank_shape.load(std::memory_order_relaxed) != shape)
+        {
+            BuildBank(shape);
+        }
+        bank_lock.clear(std::memory_order_release);
+    }
+    this->tables   = &bank[0][0];
+    this->sr_recip = 1.0f / sample_rate;
+    this->inc      = 440.0f * this->sr_recip;
+    this->phase    = 0.0f;
+    this->amp      = 1.0f;
+}
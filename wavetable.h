@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Band-limited wavetable oscillator.
+//
+// Each shape is stored as WAVETABLE_LEVELS tables, one per octave of pitch.
+// Level k holds the harmonics up to WAVETABLE_MAX_HARMONICS >> k and plays
+// alone at a phase increment of 2^k / 1024. Between two such points the
+// output fades from level k to level k + 1, so the cost is two
+// interpolated lookups per sample whatever the frequency.
+//
+// WAVETABLE_MAX_HARMONICS is two thirds of the 512 harmonics that fit
+// below Nyquist at level 0: while a level is fading out its top harmonics
+// may pass Nyquist, but they fold back no lower than a third of the sample
+// rate, above the band the tables keep.
+
+#define WAVETABLE_SIZE 2048 // Samples per table, a power of two
+#define WAVETABLE_LEVELS 10
+#define WAVETABLE_MAX_HARMONICS 341 // Harmonics in level 0
+
+enum WavetableShape
+{
+    WAVETABLE_SQUARE = 0,
+    WAVETABLE_SAW,
+    WAVETABLE_TRIANGLE,
+    WAVETABLE_PULSE, // 25% duty pulse, the nasal tone of 555 based sirens
+    WAVETABLE_SHAPE_LAST,
+};
+
+class WavetableOscillator
+{
+  public:
+    WavetableOscillator() {}
+
+    // Builds the tables of the shape on first use, safe to call from
+    // several threads. Oscillators share one table bank, so a program uses
+    // a single shape at a time.
+    void Init(float sample_rate, WavetableShape shape);
+
+    inline void SetFreq(const float f) { this->inc = f * this->sr_recip; }
+    inline void SetAmp(const float a) { this->amp = a; }
+    inline void Reset(float phase = 0.0f) { this->phase = phase; }
+
+    inline float Process()
+    {
+        // The octave of the increment picks the two levels, its mantissa
+        // the fade between them
+        float   x = this->inc * 1024.0f;
+        int32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        bits &= 0x7fffffff;
+        int32_t octave = (bits >> 23) - 127;
+        int32_t mbits  = (bits & 0x007fffff) | 0x3f800000;
+        float   fade;
+        memcpy(&fade, &mbits, sizeof(fade));
+        fade -= 1.0f;
+
+        int lo = octave;
+        if(lo < 0)
+        {
+            lo   = 0;
+            fade = 0.0f;
+        }
+        else if(lo > WAVETABLE_LEVELS - 1)
+        {
+            lo = WAVETABLE_LEVELS - 1;
+        }
+        int hi = lo < WAVETABLE_LEVELS - 1 ? lo + 1 : lo;
+
+        float    pos  = this->phase * WAVETABLE_SIZE;
+        int32_t  i    = (int32_t)pos;
+        float    frac = pos - (float)i;
+        const float* a = this->tables + lo * (WAVETABLE_SIZE + 1) + i;
+        const float* b = this->tables + hi * (WAVETABLE_SIZE + 1) + i;
+        float        sa = a[0] + frac * (a[1] - a[0]);
+        float        sb = b[0] + frac * (b[1] - b[0]);
+
+        this->phase += this->inc;
+        if(this->phase >= 1.0f)
+        {
+            this->phase -= 1.0f;
+        }
+        else if(this->phase < 0.0f)
+        {
+            this->phase += 1.0f;
+        }
+
+        return (sa + fade * (sb - sa)) * this->amp;
+    }
+
+  private:
+    const float* tables;
+    float        sr_recip;
+    float        inc;
+    float        phase;
+    float        amp;
+};
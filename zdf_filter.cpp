@@ -0,0 +1,34 @@
+#include <cmath>
+
+#include "zdf_filter.h"
+
+static const double pi = 3.14159265358979323846;
+
+void ZdfSvf::Init(float  sample_rate,
+                  ExpMap map,
+                  float  max_freq,
+                  float  damping,
+                  float  drive)
+{
+    for(int i = 0; i <= ZDF_TABLE_SIZE; i++)
+    {
+        double freq       = fmin(map((float)i / ZDF_TABLE_SIZE), max_freq);
+        double g          = tan(pi * freq / sample_rate);
+        double a1         = 1.0 / (1.0 + g * (g + damping));
+        this->table[i].a1 = (float)a1;
+        this->table[i].a2 = (float)(g * a1);
+        this->table[i].a3 = (float)(g * g * a1);
+    }
+    this->drive  = drive;
+    this->qdrive = Sample<q31_t>::Gain(drive * 4.0f / (1 << ZDF_DRIVE_SHIFT));
+    this->SetExponent(0.0f);
+    this->Reset();
+}
+
+void ZdfSvf::Reset()
+{
+    this->ic1 = 0.0f;
+    this->ic2 = 0.0f;
+    this->qc1 = 0;
+    this->qc2 = 0;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "fixed.h"
+
+// Zero delay feedback state variable filter, lowpass output.
+//
+// The linear core is the trapezoidal (topology preserving transform) SVF
+// in Andrew Simper's form: three coefficients that depend only on the
+// cutoff, g = tan(pi * fc / fs), and on the damping k = 1 / Q. They are
+// tabulated at Init over the cutoff exponent 0-1 of an exponential map,
+// so moving the cutoff every sample costs a lookup and a linear
+// interpolation instead of trigonometry. Each table segment spans 1/256
+// of the range, well under a cent of cutoff error with VcfExpToFreq.
+//
+// The band state is scaled by 1 - drive * band^2 every sample, the cubic
+// soft limit of the DaisySP Svf, with the scale kept at ZDF_MIN_SQUASH or
+// above. The scale never adds energy to the state, so the filter stays
+// stable at any resonance, cutoff and rate of modulation.
+//
+// Tick runs in the sample format of its argument (fixed.h). In Q31 and
+// Q15 the coefficients are Q31 fractions and the state is Q31, every sum
+// and product saturating; the signals have the one bit of headroom of the
+// fixed point formats, so the state holds half the value of the float
+// one. Q15 samples are widened to Q31 for the integrators.
+
+#define ZDF_TABLE_SIZE 256    // Segments over the exponent range 0-1
+#define ZDF_MIN_SQUASH 0.5f   // Smallest scale of the band state
+#define ZDF_DRIVE_SHIFT 4     // Fixed point drive is drive * 4 / 2^4
+#define ZDF_ROUND (1LL << 30) // Half a Q31 step, truncation would drift
+
+class ZdfSvf
+{
+  public:
+    typedef float (*ExpMap)(float exponent);
+
+    ZdfSvf()
+    {
+        this->drive  = 0.0f;
+        this->qdrive = 0;
+        this->Reset();
+    }
+
+    // Fills the table for sample_rate: the cutoff at exponent e is map(e)
+    // up to max_freq. damping is 1 / Q, drive the band soft limit per
+    // sample. Clears the state and sets the cutoff to exponent 0.
+    void Init(float  sample_rate,
+              ExpMap map,
+              float  max_freq,
+              float  damping,
+              float  drive);
+    void Reset();
+
+    // Cutoff at map(exponent), exponent from 0.0f to 1.0f, in every
+    // format. The template sets it for Tick<T> alone, for a cutoff that
+    // moves every sample.
+    inline void SetExponent(float exponent);
+    template <typename T>
+    inline void SetExponent(float exponent);
+
+    // One sample of the lowpass output, in the format of in
+    template <typename T>
+    inline T Tick(T in);
+
+  private:
+    struct Coefs
+    {
+        float a1; // 1 / (1 + g * (g + k))
+        float a2; // g * a1
+        float a3; // g * a2
+    };
+
+    // Same coefficients as Q31 fractions, for both fixed point formats
+    struct FixedCoefs
+    {
+        q31_t a1, a2, a3;
+    };
+
+    inline void Interpolate(float exponent, Coefs& out) const
+    {
+        float pos = fminf(fmaxf(exponent, 0.0f), 1.0f) * ZDF_TABLE_SIZE;
+        int   i   = (int)pos;
+        if(i > ZDF_TABLE_SIZE - 1)
+        {
+            i = ZDF_TABLE_SIZE - 1;
+        }
+        float        frac = pos - (float)i;
+        const Coefs& lo   = this->table[i];
+        const Coefs& hi   = this->table[i + 1];
+        out.a1            = lo.a1 + frac * (hi.a1 - lo.a1);
+        out.a2            = lo.a2 + frac * (hi.a2 - lo.a2);
+        out.a3            = lo.a3 + frac * (hi.a3 - lo.a3);
+    }
+
+    // 1 - drive * v^2, at least ZDF_MIN_SQUASH, as a Q31 fraction; sq is
+    // (v / 2)^2 in Q31
+    inline q31_t Squash(q31_t sq) const
+    {
+        int64_t t = ((int64_t)sq * this->qdrive) >> (31 - ZDF_DRIVE_SHIFT);
+        int64_t s = (int64_t)INT32_MAX - t;
+        return s < (1 << 30) ? (q31_t)(1 << 30) : (q31_t)s;
+    }
+
+    Coefs      table[ZDF_TABLE_SIZE + 1];
+    Coefs      coefs;
+    FixedCoefs qcoefs;
+    float      drive;
+    q31_t      qdrive; // drive * 4 / 2^ZDF_DRIVE_SHIFT, Q31
+    float      ic1;    // Integrator states, band and low
+    float      ic2;
+    q31_t      qc1; // The same in Q31, x / 2, for Q31 and Q15
+    q31_t      qc2;
+};
+
+template <>
+inline void ZdfSvf::SetExponent<float>(float exponent)
+{
+    this->Interpolate(exponent, this->coefs);
+}
+
+template <>
+inline void ZdfSvf::SetExponent<q31_t>(float exponent)
+{
+    Coefs c;
+    this->Interpolate(exponent, c);
+    this->qcoefs.a1 = Sample<q31_t>::Gain(c.a1);
+    this->qcoefs.a2 = Sample<q31_t>::Gain(c.a2);
+    this->qcoefs.a3 = Sample<q31_t>::Gain(c.a3);
+}
+
+template <>
+inline void ZdfSvf::SetExponent<q15_t>(float exponent)
+{
+    this->SetExponent<q31_t>(exponent);
+}
+
+inline void ZdfSvf::SetExponent(float exponent)
+{
+    this->SetExponent<float>(exponent);
+    this->SetExponent<q31_t>(exponent);
+}
+
+template <>
+inline float ZdfSvf::Tick<float>(float in)
+{
+    float v3 = in - this->ic2;
+    float v1 = this->coefs.a1 * this->ic1 + this->coefs.a2 * v3; // Band
+    float v2 = this->ic2 + this->coefs.a2 * this->ic1
+               + this->coefs.a3 * v3; // Low
+    float squash = fmaxf(1.0f - this->drive * v1 * v1, ZDF_MIN_SQUASH);
+    this->ic1    = (2.0f * v1 - this->ic1) * squash;
+    this->ic2    = 2.0f * v2 - this->ic2;
+    return v2;
+}
+
+template <>
+inline q31_t ZdfSvf::Tick<q31_t>(q31_t in)
+{
+    const FixedCoefs& c  = this->qcoefs;
+    q31_t             v3 = SatQ31((int64_t)in - this->qc2);
+    q31_t             v1 = SatQ31(
+        ((int64_t)c.a1 * this->qc1 + (int64_t)c.a2 * v3 + ZDF_ROUND) >> 31);
+    q31_t v2 = SatQ31(
+        (int64_t)this->qc2
+        + (((int64_t)c.a2 * this->qc1 + (int64_t)c.a3 * v3 + ZDF_ROUND)
+           >> 31));
+    q31_t squash = this->Squash(MulQ31(v1, v1));
+    this->qc1    = SatQ31(
+        (SatQ31(2 * (int64_t)v1 - this->qc1) * (int64_t)squash + ZDF_ROUND)
+        >> 31);
+    this->qc2    = SatQ31(2 * (int64_t)v2 - this->qc2);
+    return v2;
+}
+
+template <>
+inline q15_t ZdfSvf::Tick<q15_t>(q15_t in)
+{
+    // The integrators need the Q31 resolution: at low cutoffs a Q15 state
+    // can not follow steps of g^2 of the input
+    q31_t out = this->Tick<q31_t>((q31_t)in << 16);
+    return SatQ15((int32_t)(((int64_t)out + (1 << 15)) >> 16));
+}